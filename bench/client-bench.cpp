@@ -0,0 +1,199 @@
+/**
+ * Mikrobenchmarki dekodowania wiadomości serwera
+ * i kodowania stanu gry dla GUI w kliencie.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <concepts>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <set>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <endian.h>
+#include <sys/socket.h>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/format.hpp>
+
+#ifdef ROBOTS_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include "scenario.h"
+
+/*
+ * Klient i serwer mają typy o tych samych nazwach (TcpConnection,
+ * Position, ...), a benchmarki obu stron trafiają do jednego programu.
+ * Nagłówki klienta są więc zamknięte w przestrzeni nazw; wszystkie
+ * nagłówki, których używają, zostały dołączone wyżej.
+ */
+namespace client {
+#include "../client/events.h"
+#include "../client/gui-publisher.h"
+#include "../client/message-reader.h"
+#include "../client/messages.h"
+#include "../client/types.h"
+#include "../client/udp-socket.h"
+}
+
+using namespace client;
+
+namespace {
+    void BM_ReadEventList(benchmark::State &state, ProtocolVersion version) {
+        auto bytes = encodeScenarioTurn(scenarioParams(state), (uint8_t) version);
+        // Lista zdarzeń zaczyna się po rodzaju wiadomości i numerze tury.
+        auto events = std::span<const uint8_t>(bytes).subspan(3);
+        for (auto _: state) {
+            MessageReader c{events, version};
+            auto list = readEventList(c);
+            benchmark::DoNotOptimize(list.data());
+        }
+        state.SetBytesProcessed(state.iterations() * (int64_t) events.size());
+    }
+
+    /**
+     * Ustawia w `s` planszę scenariusza: bloki, bomby tuż przed wybuchem i roboty.
+     */
+    void applyScenarioBoard(ClientState &s, const ScenarioParams &params) {
+        auto scenario = generateScenario(params);
+        s.is_lobby = false;
+        s.server_name = "bench";
+        s.size_x = params.size;
+        s.size_y = params.size;
+        s.explosion_radius = params.explosion_radius;
+        s.bomb_timer = 1;
+        s.resetBoard();
+        for (const auto &[x, y]: scenario.blocks) {
+            s.blocks.insert(Position{x, y});
+        }
+        for (uint32_t i = 0; i < scenario.bombs.size(); ++i) {
+            auto [x, y] = scenario.bombs[i];
+            s.bombs[BombId{i}] = ArmedBomb{Position{x, y}, 1};
+        }
+        for (size_t i = 0; i < scenario.players.size(); ++i) {
+            auto [x, y] = scenario.players[i];
+            s.players[PlayerId{(uint8_t) i}] = Player{"player", "[::1]:1"};
+            s.player_positions[PlayerId{(uint8_t) i}] = Position{x, y};
+            s.scores[PlayerId{(uint8_t) i}] = {0};
+        }
+    }
+
+    Turn readScenarioTurn(const ScenarioParams &params, ProtocolVersion version) {
+        auto bytes = encodeScenarioTurn(params, (uint8_t) version);
+        MessageReader c{std::span<const uint8_t>(bytes).subspan(1), version};
+        return Turn::read(c);
+    }
+
+    void applyEvents(ClientState &s, const Turn &turn) {
+        for (const auto &e: turn.events) {
+            std::visit([&](const auto &event) { event.apply(s); }, e);
+        }
+    }
+
+    /**
+     * Odtwarza w `s` stan klienta po turze scenariusza:
+     * plansza ze scenariusza, a na niej zdarzenia z zakodowanej tury.
+     */
+    void applyScenarioTurn(ClientState &s, const ScenarioParams &params) {
+        applyScenarioBoard(s, params);
+        auto turn = readScenarioTurn(params, ProtocolVersion::V1);
+        s.turn = turn.turn;
+        applyEvents(s, turn);
+        for (const auto &p: s.robots_destroyed_in_turn) {
+            s.scores[p] = {s.scores[p].value + 1};
+        }
+        for (const auto &p: s.blocks_destroyed_in_turn) {
+            s.blocks.erase(p);
+        }
+    }
+
+    /**
+     * Aplikowanie zdarzeń tury do stanu klienta. W V1 klient sam
+     * wylicza krzyże wybuchów, w V2 dostaje je od serwera.
+     */
+    void BM_ApplyTurn(benchmark::State &state, ProtocolVersion version) {
+        auto params = scenarioParams(state);
+        ClientState s{"bench"};
+        applyScenarioBoard(s, params);
+        auto turn = readScenarioTurn(params, version);
+        auto bombs = s.bombs;
+        for (auto _: state) {
+            s.explosions.clear();
+            s.blocks_destroyed_in_turn.clear();
+            s.robots_destroyed_in_turn.clear();
+            s.delta.clear();
+            applyEvents(s, turn);
+            benchmark::DoNotOptimize(s.explosions.size());
+
+            state.PauseTiming();
+            s.bombs = bombs;
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * (int64_t) turn.events.size());
+    }
+
+    void BM_ClientStateWrite(benchmark::State &state, GuiProtocol protocol) {
+        asio::io_context context;
+        UdpSocket gui{context, "::1", "9", 0};
+        ClientState s{"bench"};
+        applyScenarioTurn(s, scenarioParams(state));
+        StateMailbox<GuiFrame> mailbox;
+        GuiPublisher publisher{gui, mailbox, protocol, UINT16_MAX};
+        GuiFrame frame{.view = s, .is_lobby = false, .keyframe_needed = false, .seq = 1,
+                       .own_id = std::nullopt, .predicted = false};
+        // Pierwsza ramka gry jest zawsze pełna, kolejne w trybie DELTA są zmianami.
+        publisher.write(frame);
+
+        size_t bytes = 0;
+        for (auto _: state) {
+            gui.clearOutput();
+            ++frame.seq;
+            publisher.write(frame);
+            bytes = gui.outputSize();
+        }
+        state.SetBytesProcessed(state.iterations() * (int64_t) bytes);
+    }
+
+    /**
+     * Publikowanie stanu dla GUI po turze, w której poruszył się
+     * tylko jeden robot, a plansza się nie zmieniła.
+     */
+    void BM_PublishState(benchmark::State &state) {
+        ClientState s{"bench"};
+        applyScenarioTurn(s, scenarioParams(state));
+        StateMailbox<GuiFrame> mailbox;
+        auto &robot = s.player_positions.begin()->second;
+        for (auto _: state) {
+            robot.x ^= 1;
+            mailbox.back().view = s;
+            mailbox.publish();
+        }
+    }
+}
+
+BENCHMARK_CAPTURE(BM_ReadEventList, v1, ProtocolVersion::V1)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_ReadEventList, v2, ProtocolVersion::V2)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_ApplyTurn, v1, ProtocolVersion::V1)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_ApplyTurn, v2, ProtocolVersion::V2)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_ClientStateWrite, full, GuiProtocol::FULL)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_ClientStateWrite, delta, GuiProtocol::DELTA)->Apply(boardArgs);
+BENCHMARK(BM_PublishState)->Apply(boardArgs);
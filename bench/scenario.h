@@ -0,0 +1,98 @@
+#ifndef ROBOTS_BENCH_SCENARIO_H
+#define ROBOTS_BENCH_SCENARIO_H
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+/**
+ * Deterministyczne scenariusze rozgrywki do mikrobenchmarków.
+ *
+ * Scenariusz nie korzysta z typów serwera ani klienta (mają te same
+ * nazwy, więc nie mogą się spotkać w jednej jednostce kompilacji),
+ * tylko opisuje planszę liczbami. Każdy benchmark buduje z niego
+ * własne struktury.
+ */
+
+const uint32_t DEFAULT_SCENARIO_SEED = 2022;
+const uint8_t DEFAULT_SCENARIO_PLAYERS = 64;
+
+struct ScenarioParams {
+    uint16_t size;
+    // Odsetek pól planszy zajętych przez bloki.
+    uint16_t block_density;
+    uint16_t explosion_radius;
+    uint32_t bombs;
+    uint8_t players;
+    uint32_t seed = DEFAULT_SCENARIO_SEED;
+};
+
+struct Scenario {
+    using position_t = std::pair<uint16_t, uint16_t>;
+
+    ScenarioParams params;
+    std::vector<position_t> blocks;
+    std::vector<position_t> bombs;
+    std::vector<position_t> players;
+    // Kierunek ruchu każdego z graczy, z przedziału [0, 3].
+    std::vector<uint8_t> moves;
+};
+
+/**
+ * Losuje pozycje bloków, bomb i robotów tym samym generatorem
+ * co zarządca gry, więc to samo ziarno daje zawsze ten sam scenariusz.
+ */
+inline Scenario generateScenario(const ScenarioParams &params) {
+    std::minstd_rand random(params.seed);
+    auto randomPosition = [&] {
+        return Scenario::position_t{(uint16_t) (random() % params.size),
+                                    (uint16_t) (random() % params.size)};
+    };
+
+    Scenario s{.params = params, .blocks = {}, .bombs = {}, .players = {}, .moves = {}};
+    auto blocks = (uint64_t) params.size * params.size * params.block_density / 100;
+    for (uint64_t i = 0; i < blocks; ++i) {
+        s.blocks.push_back(randomPosition());
+    }
+    for (uint32_t i = 0; i < params.bombs; ++i) {
+        s.bombs.push_back(randomPosition());
+    }
+    for (uint8_t i = 0; i < params.players; ++i) {
+        s.players.push_back(randomPosition());
+        s.moves.push_back((uint8_t) (random() % 4));
+    }
+    return s;
+}
+
+/**
+ * Parametry scenariusza z argumentów benchmarku zarejestrowanego z `boardArgs`.
+ */
+inline ScenarioParams scenarioParams(const benchmark::State &state) {
+    return ScenarioParams{
+            .size = (uint16_t) state.range(0),
+            .block_density = (uint16_t) state.range(1),
+            .explosion_radius = (uint16_t) state.range(2),
+            .bombs = (uint32_t) state.range(3),
+            .players = DEFAULT_SCENARIO_PLAYERS,
+    };
+}
+
+/**
+ * Rozmiary planszy, gęstości bloków, zasięgi wybuchów i liczby bomb.
+ */
+inline void boardArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "density", "radius", "bombs"});
+    b->ArgsProduct({{32, 256, 1024}, {0, 20}, {3, 16}, {16, 512}});
+}
+
+/**
+ * Koduje koderem serwera, w wersji protokołu `version`, wiadomość TURN,
+ * w której wybuchają wszystkie bomby scenariusza, a wszyscy gracze wykonują swoje ruchy.
+ * Zdefiniowana w server-bench.cpp, używana przez benchmarki klienta.
+ */
+std::vector<uint8_t> encodeScenarioTurn(const ScenarioParams &params, uint8_t version = 1);
+
+#endif //ROBOTS_BENCH_SCENARIO_H
@@ -0,0 +1,252 @@
+/**
+ * Mikrobenchmarki logiki gry i kodera wiadomości serwera.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../server/game-manager.h"
+#include "scenario.h"
+
+/**
+ * Udostępnia benchmarkom prywatne kroki tury zarządcy gry
+ * na stanie zbudowanym ze scenariusza.
+ */
+class GameLogicBench {
+public:
+    using GameState = GameManager::GameState;
+
+    explicit GameLogicBench(const ScenarioParams &scenario_params, uint16_t tick_threads = 1)
+            : scenario(generateScenario(scenario_params)),
+              params(serverParams(scenario_params, tick_threads)),
+              manager(params, std::make_shared<Server>(params)),
+              state(std::make_unique<GameState>(params)) {
+        for (const auto &[x, y]: scenario.blocks) {
+            state->blocks.insert(Position{x, y});
+        }
+        for (size_t i = 0; i < scenario.players.size(); ++i) {
+            players[PlayerId{(uint8_t) i}] = Player{"player", "[::1]:1"};
+            state->scores[PlayerId{(uint8_t) i}] = {0};
+        }
+        resetBombsAndRobots();
+    }
+
+    /**
+     * Ustawia bomby (z licznikami bliskimi wybuchu) i roboty
+     * z powrotem na pozycje ze scenariusza.
+     */
+    void resetBombsAndRobots() {
+        state->bombs.clear();
+        for (const auto &[x, y]: scenario.bombs) {
+            state->bombs[state->next_bomb_id] = Bomb{.position = {x, y}, .timer = 1};
+            state->next_bomb_id = BombId{state->next_bomb_id.value + 1};
+        }
+        for (size_t i = 0; i < scenario.players.size(); ++i) {
+            auto [x, y] = scenario.players[i];
+            state->placeRobot(PlayerId{(uint8_t) i}, Position{x, y});
+        }
+    }
+
+    /**
+     * Przywraca bloki zniszczone przez wybuchy opisane w `events`.
+     */
+    void restoreBlocks(const event_list_t &events) {
+        for (const auto &e: events) {
+            if (auto *exploded = std::get_if<BombExploded>(&e)) {
+                for (const auto &pos: exploded->blocks_destroyed) {
+                    state->blocks.insert(pos);
+                }
+            }
+        }
+    }
+
+    std::pmr::map<PlayerId, client_mess_t> moves(std::pmr::memory_resource *resource) const {
+        std::pmr::map<PlayerId, client_mess_t> messages{resource};
+        for (size_t i = 0; i < scenario.moves.size(); ++i) {
+            messages[PlayerId{(uint8_t) i}] = Move{CLIENT_MOVE, (Direction) scenario.moves[i]};
+        }
+        return messages;
+    }
+
+    TurnArena &arena() {
+        return manager.arena;
+    }
+
+    /**
+     * Odzyskuje pamięć tury, tak jak zarządca gry na początku tury.
+     */
+    void resetArenas() {
+        manager.resetArenas();
+    }
+
+    void updateBombs(event_list_t &events) {
+        manager.updateBombs(*state, events);
+    }
+
+    void interpretAllClientMessages(std::pmr::map<PlayerId, client_mess_t> &messages,
+                                    event_list_t &events) {
+        manager.interpretAllClientMessages(messages, *state, events);
+    }
+
+    void placeMissingRobots(event_list_t &events) {
+        manager.placeMissingRobots(players, *state, events);
+    }
+
+    [[nodiscard]] Explosion calcExplosion(Position bomb_pos) const {
+        return manager.calcExplosion(bomb_pos, *state);
+    }
+
+    const Scenario scenario;
+
+private:
+    ServerParams params;
+    GameManager manager;
+    std::unique_ptr<GameState> state;
+    map<PlayerId, Player> players;
+
+    static ServerParams serverParams(const ScenarioParams &s, uint16_t tick_threads) {
+        ServerParams params{
+                .bomb_timer = 1,
+                .players_count = UINT8_MAX,
+                .turn_duration = 1,
+                .explosion_radius = s.explosion_radius,
+                .initial_blocks = 0,
+                .game_length = UINT16_MAX,
+                .server_name = "bench",
+                .port = 1,
+                .seed = s.seed,
+                .size_x = s.size,
+                .size_y = s.size,
+        };
+        params.tick_threads = tick_threads;
+        return params;
+    }
+};
+
+namespace {
+    void playerArgs(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"size", "density", "players"});
+        b->ArgsProduct({{32, 256, 1024}, {0, 20}, {8, 255}});
+    }
+
+    /* Wybuch wszystkich bomb scenariusza w jednej turze. */
+    void runUpdateBombs(benchmark::State &state, GameLogicBench &bench) {
+        for (auto _: state) {
+            bench.resetArenas();
+            event_list_t events{bench.arena().resource()};
+            bench.updateBombs(events);
+            benchmark::DoNotOptimize(events.data());
+
+            state.PauseTiming();
+            bench.restoreBlocks(events);
+            bench.resetBombsAndRobots();
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * (int64_t) bench.scenario.bombs.size());
+    }
+
+    void BM_UpdateBombs(benchmark::State &state) {
+        GameLogicBench bench{scenarioParams(state)};
+        runUpdateBombs(state, bench);
+    }
+
+    /* Wybuchy liczone przez `threads` wątków zarządcy gry. */
+    void BM_UpdateBombsParallel(benchmark::State &state) {
+        GameLogicBench bench{scenarioParams(state), (uint16_t) state.range(4)};
+        runUpdateBombs(state, bench);
+    }
+
+    /* Wielkie plansze z wieloma bombami. */
+    void parallelBoardArgs(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"size", "density", "radius", "bombs", "threads"});
+        b->ArgsProduct({{4096}, {20}, {16, 256}, {4096, 65536}, {1, 2, 4}});
+    }
+
+    void BM_CalcExplosion(benchmark::State &state) {
+        GameLogicBench bench{scenarioParams(state)};
+        for (auto _: state) {
+            for (const auto &[x, y]: bench.scenario.bombs) {
+                auto explosion = bench.calcExplosion(Position{x, y});
+                benchmark::DoNotOptimize(explosion);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * (int64_t) bench.scenario.bombs.size());
+    }
+
+    /* Ruch każdego z graczy; roboty błądzą po planszy kolejnymi iteracjami. */
+    void BM_InterpretAllClientMessages(benchmark::State &state) {
+        GameLogicBench bench{ScenarioParams{
+                .size = (uint16_t) state.range(0),
+                .block_density = (uint16_t) state.range(1),
+                .explosion_radius = 0,
+                .bombs = 0,
+                .players = (uint8_t) state.range(2),
+        }};
+        auto messages = bench.moves(std::pmr::new_delete_resource());
+        for (auto _: state) {
+            bench.resetArenas();
+            event_list_t events{bench.arena().resource()};
+            bench.interpretAllClientMessages(messages, events);
+            benchmark::DoNotOptimize(events.data());
+        }
+        state.SetItemsProcessed(state.iterations() * (int64_t) messages.size());
+    }
+
+    Turn scenarioTurn(GameLogicBench &bench) {
+        event_list_t events{bench.arena().resource()};
+        auto messages = bench.moves(bench.arena().resource());
+        bench.updateBombs(events);
+        bench.interpretAllClientMessages(messages, events);
+        bench.placeMissingRobots(events);
+        return Turn{1, std::move(events)};
+    }
+
+    void BM_TurnWrite(benchmark::State &state, ProtocolVersion version) {
+        GameLogicBench bench{scenarioParams(state)};
+        auto turn = scenarioTurn(bench);
+        size_t bytes = 0;
+        for (auto _: state) {
+            OutputBuffer buffer{version};
+            buffer.reserve(turn.maxSize(version));
+            turn.write(buffer);
+            bytes = buffer.size();
+            benchmark::DoNotOptimize(buffer.data());
+        }
+        state.SetBytesProcessed(state.iterations() * (int64_t) bytes);
+        state.counters["message_bytes"] = (double) bytes;
+    }
+
+#ifdef ROBOTS_WITH_ZLIB
+    /* Kodowanie tury w V2 razem z jej kompresją. */
+    void BM_TurnCompress(benchmark::State &state) {
+        GameLogicBench bench{scenarioParams(state)};
+        server_mess_t turn{scenarioTurn(bench)};
+        size_t bytes = 0;
+        for (auto _: state) {
+            auto message = encodeServerMessage(turn, Encoding::V2_DEFLATE);
+            bytes = message->size();
+            benchmark::DoNotOptimize(message->data());
+        }
+        state.counters["message_bytes"] = (double) bytes;
+    }
+#endif
+}
+
+std::vector<uint8_t> encodeScenarioTurn(const ScenarioParams &params, uint8_t version) {
+    GameLogicBench bench{params};
+    OutputBuffer buffer{(ProtocolVersion) version};
+    scenarioTurn(bench).write(buffer);
+    return {buffer.data(), buffer.data() + buffer.size()};
+}
+
+BENCHMARK(BM_UpdateBombs)->Apply(boardArgs);
+BENCHMARK(BM_UpdateBombsParallel)->Apply(parallelBoardArgs)->UseRealTime();
+BENCHMARK(BM_CalcExplosion)->Apply(boardArgs);
+BENCHMARK(BM_InterpretAllClientMessages)->Apply(playerArgs);
+BENCHMARK_CAPTURE(BM_TurnWrite, v1, ProtocolVersion::V1)->Apply(boardArgs);
+BENCHMARK_CAPTURE(BM_TurnWrite, v2, ProtocolVersion::V2)->Apply(boardArgs);
+#ifdef ROBOTS_WITH_ZLIB
+BENCHMARK(BM_TurnCompress)->Apply(boardArgs);
+#endif
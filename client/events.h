@@ -1,7 +1,11 @@
 #ifndef SIK_2_EVENTS_H
 #define SIK_2_EVENTS_H
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <optional>
+#include <tuple>
 #include <variant>
 #include "types.h"
 
@@ -13,39 +17,64 @@
  * do aktualnego stanu klienta, odpowiedno go modyfikując.
  */
 
-enum EventType {
-    BOMB_PLACED, BOMB_EXPLODED,
-    PLAYER_MOVED, BLOCK_PLACED
-};
-
 struct BombPlaced {
     BombId id;
     Position position;
 
-    static BombPlaced read(TcpConnection &c) {
-        return {BombId::read(c), Position::read(c)};
-    }
+    using wire_layout = layout::BombPlaced;
+    static constexpr auto wire_fields = std::tuple{&BombPlaced::id, &BombPlaced::position};
 
     void apply(ClientState &c) const {
-        c.bombs[id] = {position, c.bomb_timer};
+        c.bombs[id] = {position, (uint32_t) c.turn + c.bomb_timer};
+        c.delta.bombs_placed.push_back({position, c.bomb_timer});
     }
 };
 
 struct BombExploded {
+    static const size_t DIRECTIONS = 4;
+
+    /**
+     * Krzyż wybuchu przysyłany w protokole V2:
+     * środek i długości ramion w kierunkach (DX[i], DY[i]).
+     */
+    struct Cross {
+        static constexpr std::array<int, DIRECTIONS> DX = {1, -1, 0, 0};
+        static constexpr std::array<int, DIRECTIONS> DY = {0, 0, 1, -1};
+
+        Position center;
+        std::array<uint16_t, DIRECTIONS> arms;
+
+        [[nodiscard]] Position armEnd(size_t i) const {
+            return Position{(uint16_t) (center.x + DX[i] * arms[i]),
+                            (uint16_t) (center.y + DY[i] * arms[i])};
+        }
+    };
+
     BombId id;
     vector<PlayerId> robots_destroyed;
     vector<Position> blocks_destroyed;
+    std::optional<Cross> cross;
 
-    static BombExploded read(TcpConnection &c) {
-        return {
-                BombId::read(c),
-                c.readList<PlayerId>(),
-                c.readList<Position>()
-        };
+    template<typename Source>
+    static BombExploded read(Source &c) {
+        auto id = wire::read<BombId>(c);
+        if (c.protocol() == ProtocolVersion::V2) {
+            return readCross(id, c);
+        }
+        auto robots_destroyed = wire::read<vector<PlayerId>>(c);
+        return {id, std::move(robots_destroyed), wire::read<vector<Position>>(c), std::nullopt};
     }
 
     void apply(ClientState &c) const {
-        calcExplosion(c);
+        auto bomb = c.bombs.find(id);
+        if (bomb != c.bombs.end()) {
+            c.delta.bombs_exploded.push_back(bomb->second.position);
+        }
+        if (cross) {
+            markCross(c, *cross);
+        } else if (bomb != c.bombs.end()) {
+            markCross(c, calcCross(c, bomb->second.position));
+        }
 
         for (const auto &p: blocks_destroyed) {
             c.blocks_destroyed_in_turn.insert(p);
@@ -53,38 +82,79 @@ struct BombExploded {
         for (const auto &p: robots_destroyed) {
             c.robots_destroyed_in_turn.insert(p);
             c.player_positions.erase(p);
+            c.delta.players_moved.erase(p);
         }
         c.bombs.erase(id);
     }
 
 private:
-    static const size_t DIRECTIONS = 4;
+    /**
+     * Najmłodszy bit długości ramienia mówi, czy na końcu ramienia
+     * został zniszczony blok. Ramiona długości 0 kończą się na środku,
+     * więc ten sam blok może się powtórzyć.
+     */
+    template<typename Source>
+    static BombExploded readCross(BombId id, Source &c) {
+        Cross cross{wire::read<Position>(c), {}};
+        vector<Position> blocks_destroyed;
+        for (size_t i = 0; i < DIRECTIONS; ++i) {
+            uint64_t arm = c.readVarint();
+            if ((arm >> 1) > UINT16_MAX) {
+                throw std::invalid_argument("Server message - explosion arm too long");
+            }
+            cross.arms[i] = (uint16_t) (arm >> 1);
+            auto end = cross.armEnd(i);
+            if ((arm & 1) && std::ranges::none_of(blocks_destroyed, [&](const Position &p) {
+                return std::is_eq(p <=> end);
+            })) {
+                blocks_destroyed.push_back(end);
+            }
+        }
+        auto robots_destroyed = wire::read<vector<PlayerId>>(c);
+        return {id, std::move(robots_destroyed), std::move(blocks_destroyed), cross};
+    }
+
+    /**
+     * Zaznacza pola krzyża jako wiersz i kolumnę przycięte do planszy.
+     */
+    static void markCross(ClientState &c, const Cross &cross) {
+        auto [x, y] = cross.center;
+        if (x >= c.size_x || y >= c.size_y) {
+            return;
+        }
+        auto clip = [](int v, int size) { return (uint16_t) std::clamp(v, 0, size - 1); };
+        c.explosions.insertRowSpan(y, clip(x - cross.arms[1], c.size_x), clip(x + cross.arms[0], c.size_x));
+        c.explosions.insertColumnSpan(x, clip(y - cross.arms[3], c.size_y), clip(y + cross.arms[2], c.size_y));
+    }
 
     /**
      * Wybuch bomby ma kształt krzyża
      * o ramieniu długości `ClientState.explosion_radius`.
-     * Eksplozja zatrzymuje się na blokach, więc rzeczywiste
-     * ramię krzyża może być krótsze.
+     * Eksplozja zatrzymuje się na blokach i na brzegu planszy,
+     * więc rzeczywiste ramię krzyża może być krótsze.
      */
-    void calcExplosion(ClientState &c) const {
-        auto bomb_pos = c.bombs[id].position;
-        std::array<int, DIRECTIONS> dx = {1, -1, 0, 0};
-        std::array<int, DIRECTIONS> dy = {0, 0, 1, -1};
+    static Cross calcCross(const ClientState &c, Position center) {
+        Cross cross{center, {0, 0, 0, 0}};
+        if (c.blocks.contains(center)) {
+            // Blok na polu bomby zatrzymuje eksplozję we wszystkich kierunkach.
+            return cross;
+        }
         for (size_t i = 0; i < DIRECTIONS; ++i) {
-            for (uint16_t r = 0; r <= c.explosion_radius; ++r) {
-                int x = (int) bomb_pos.x + dx[i] * (int) r;
-                int y = (int) bomb_pos.y + dy[i] * (int) r;
-                if (0 <= x && x < (int) c.size_x
-                    && 0 <= y && y < (int) c.size_y) {
-                    // 0 <= x, y < UINT16_MAX, więc można bezpiecznie rzutować.
-                    auto pos = Position{(uint16_t) x, (uint16_t) y};
-                    c.explosions.insert(pos);
-                    if (c.blocks.contains(pos)) {
-                        break;
-                    }
+            for (uint16_t r = 1; r <= c.explosion_radius; ++r) {
+                int x = (int) center.x + Cross::DX[i] * (int) r;
+                int y = (int) center.y + Cross::DY[i] * (int) r;
+                if (!(0 <= x && x < (int) c.size_x
+                      && 0 <= y && y < (int) c.size_y)) {
+                    break;
+                }
+                cross.arms[i] = r;
+                // 0 <= x, y < UINT16_MAX, więc można bezpiecznie rzutować.
+                if (c.blocks.contains(Position{(uint16_t) x, (uint16_t) y})) {
+                    break;
                 }
             }
         }
+        return cross;
     }
 
 };
@@ -93,40 +163,42 @@ struct PlayerMoved {
     PlayerId id;
     Position position;
 
-    static PlayerMoved read(TcpConnection &c) {
-        return {PlayerId::read(c), Position::read(c)};
-    }
+    using wire_layout = layout::PlayerMoved;
+    static constexpr auto wire_fields = std::tuple{&PlayerMoved::id, &PlayerMoved::position};
 
     void apply(ClientState &c) const {
         c.player_positions[id] = position;
+        c.delta.players_moved.insert(id);
     }
 };
 
 struct BlockPlaced {
     Position position;
 
-    static BlockPlaced read(TcpConnection &c) {
-        return BlockPlaced{Position::read(c)};
-    }
+    using wire_layout = layout::BlockPlaced;
+    static constexpr auto wire_fields = std::tuple{&BlockPlaced::position};
 
     void apply(ClientState &c) const {
-        c.blocks.insert(position);
+        if (c.blocks.insert(position)) {
+            c.delta.blocks_placed.push_back(position);
+        }
     }
 };
 
 using event_t = std::variant<BombPlaced, BombExploded, PlayerMoved, BlockPlaced>;
 
-event_t readEvent(TcpConnection &c) {
+template<typename Source>
+event_t readEvent(Source &c) {
     uint8_t event_type = c.readU8();
     switch (event_type) {
         case BOMB_PLACED:
-            return BombPlaced::read(c);
+            return wire::read<BombPlaced>(c);
         case BOMB_EXPLODED:
             return BombExploded::read(c);
         case PLAYER_MOVED:
-            return PlayerMoved::read(c);
+            return wire::read<PlayerMoved>(c);
         case BLOCK_PLACED:
-            return BlockPlaced::read(c);
+            return wire::read<BlockPlaced>(c);
         default:
             // Klient zrywa połączenie przy napotkaniu niepoprawnej wiadomości.
             throw std::invalid_argument((boost::format(
@@ -135,8 +207,9 @@ event_t readEvent(TcpConnection &c) {
     }
 }
 
-vector<event_t> readEventList(TcpConnection &c) {
-    uint32_t len = c.readU32();
+template<typename Source>
+vector<event_t> readEventList(Source &c) {
+    uint32_t len = c.readLength();
     vector<event_t> res;
     for (uint32_t i = 0; i < len; ++i) {
         res.push_back(readEvent(c));
@@ -0,0 +1,229 @@
+#ifndef SIK_2_GUI_PUBLISHER_H
+#define SIK_2_GUI_PUBLISHER_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <ostream>
+
+#include "types.h"
+#include "state-mailbox.h"
+#include "udp-socket.h"
+
+/**
+ * Kopia stanu rozgrywki do wysłania do GUI.
+ */
+struct GuiFrame {
+    GameView view;
+    bool is_lobby = true;
+    bool keyframe_needed = true;
+    // Numer kolejny ramki. Luka w numeracji oznacza, że GUI
+    // nie dostało ramek pośrednich i nie ma podstawy dla zmian.
+    uint64_t seq = 0;
+    // Identyfikator gracza tego klienta, o ile serwer go przyjął.
+    std::optional<PlayerId> own_id;
+    // Ramka z przewidzianym, jeszcze niepotwierdzonym ruchem gracza.
+    bool predicted = false;
+};
+
+/**
+ * Przewidywanie ruchu gracza dla GUI.
+ *
+ * Wątek wejścia GUI zapamiętuje ostatni wysłany serwerowi ruch
+ * i budzi wątek wysyłający stan do GUI, a ten pokazuje robota gracza
+ * od razu na polu docelowym, nie czekając na turę od serwera.
+ * Przewidywany jest tylko ruch na wolne pole planszy.
+ *
+ * Każda tura od serwera rozstrzyga przewidywanie: robot na polu docelowym
+ * potwierdza je, robot zniszczony albo na innym polu (np. zablokowany
+ * postawionym w tej turze blokiem) je odrzuca, a robot na polu startowym
+ * oznacza, że ruch trafi do serwera dopiero w kolejnej turze, więc
+ * przewidywanie trwa jeszcze przez jedną turę.
+ */
+class MovePrediction {
+public:
+    explicit MovePrediction(StateMailbox<GuiFrame> &mailbox) : mailbox(mailbox) {}
+
+    /**
+     * Zapamiętuje ruch w kierunku `direction`. Woła ją wątek wejścia GUI.
+     */
+    void predictMove(uint8_t direction) {
+        {
+            std::scoped_lock lock(mutex);
+            pending = Pending{direction};
+        }
+        mailbox.wake();
+    }
+
+    /**
+     * Porzuca przewidywany ruch, bo serwer dostał po nim inne polecenie,
+     * które go zastąpi. Woła ją wątek wejścia GUI.
+     */
+    void cancel() {
+        {
+            std::scoped_lock lock(mutex);
+            bool shown = pending && pending->target;
+            pending.reset();
+            if (!shown) {
+                return;
+            }
+        }
+        mailbox.wake();
+    }
+
+    /**
+     * Zwraca ramkę do wysłania do GUI: `frame` albo jej kopię
+     * z przewidzianą pozycją robota gracza. Woła ją wątek wysyłający stan do GUI.
+     */
+    const GuiFrame &apply(const GuiFrame &frame) {
+        std::scoped_lock lock(mutex);
+        if (!pending) {
+            return frame;
+        }
+        auto robot = frame.own_id ? frame.view.player_positions.find(*frame.own_id)
+                                  : frame.view.player_positions.end();
+        if (frame.is_lobby || robot == frame.view.player_positions.end()) {
+            pending.reset();
+            return frame;
+        }
+        if (!pending->target) {
+            pending->target = moveTarget(frame.view, robot->second, pending->direction);
+            if (!pending->target) {
+                pending.reset();
+                return frame;
+            }
+            pending->from = robot->second;
+            pending->turn = frame.view.turn;
+            pending->deaths = deathsOf(frame.view, *frame.own_id);
+        } else if (frame.view.turn != pending->turn) {
+            // Zniszczony robot odradza się na losowym polu, być może docelowym.
+            bool destroyed = deathsOf(frame.view, *frame.own_id) != pending->deaths;
+            if (!destroyed && std::is_eq(robot->second <=> *pending->target)) {
+                ++confirmed;
+                pending.reset();
+                return frame;
+            }
+            if (destroyed || std::is_neq(robot->second <=> pending->from) || frame.view.turn > pending->turn + 1) {
+                ++corrected;
+                pending.reset();
+                return frame;
+            }
+        }
+
+        predicted = frame;
+        predicted.view.player_positions[*frame.own_id] = *pending->target;
+        predicted.predicted = true;
+        return predicted;
+    }
+
+    void print(std::ostream &os) const {
+        os << boost::format("predicted moves: %1% confirmed, %2% corrected\n")
+              % confirmed.load() % corrected.load();
+    }
+
+private:
+    struct Pending {
+        uint8_t direction;
+        // Pole docelowe, wyliczone przy pierwszym pokazaniu ruchu.
+        std::optional<Position> target{};
+        Position from{};
+        // Tura, na której stan nałożono ruch.
+        uint16_t turn = 0;
+        // Wynik gracza w tej turze, czyli liczba zniszczeń jego robota.
+        uint32_t deaths = 0;
+    };
+
+    StateMailbox<GuiFrame> &mailbox;
+    std::mutex mutex;
+    std::optional<Pending> pending;
+    // Ramka z przewidywaniem; używa jej tylko wątek wysyłający stan do GUI.
+    GuiFrame predicted;
+    std::atomic<uint64_t> confirmed{0};
+    std::atomic<uint64_t> corrected{0};
+
+    static uint32_t deathsOf(const GameView &view, PlayerId id) {
+        auto it = view.scores.find(id);
+        return it == view.scores.end() ? 0 : it->second.value;
+    }
+
+    static std::optional<Position> moveTarget(const GameView &view, Position from, uint8_t direction) {
+        int x = from.x + MOVE_DX[direction];
+        int y = from.y + MOVE_DY[direction];
+        if (x < 0 || x >= view.size_x || y < 0 || y >= view.size_y) {
+            return std::nullopt;
+        }
+        Position target{(uint16_t) x, (uint16_t) y};
+        if (view.blocks.contains(target)) {
+            return std::nullopt;
+        }
+        return target;
+    }
+};
+
+/**
+ * Wysyła do GUI najnowszy stan rozgrywki na oddzielnym wątku,
+ * żeby kodowanie i wysyłanie stanu nie wstrzymywało odbioru
+ * wiadomości od serwera.
+ *
+ * Gdy serwer przysyła tury szybciej, niż GUI nadąża je wysyłać,
+ * pośrednie stany są pomijane. W trybie DELTA po pominiętej ramce
+ * wysyłany jest pełny stan gry, bo zmiany dotyczą tylko ostatniej tury.
+ */
+class GuiPublisher {
+public:
+    GuiPublisher(UdpSocket &gui, StateMailbox<GuiFrame> &mailbox,
+                 GuiProtocol gui_protocol = GuiProtocol::FULL,
+                 uint16_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL,
+                 MovePrediction *prediction = nullptr)
+            : gui(gui), mailbox(mailbox), gui_protocol(gui_protocol),
+              keyframe_interval(keyframe_interval), prediction(prediction) {}
+
+    [[noreturn]] void run() {
+        for (;;) {
+            const auto &frame = mailbox.take();
+            gui.clearOutput();
+            write(prediction ? prediction->apply(frame) : frame);
+            gui.send();
+        }
+    }
+
+    /**
+     * Zapisuje ramkę w buforze wyjściowym GUI w postaci
+     * wynikającej z trybu przesyłania i poprzednio wysłanych ramek.
+     * Ramka z przewidywaniem i ramka po niej to zawsze pełny stan gry,
+     * bo zmiany z tury nie obejmują przewidzianej pozycji robota.
+     */
+    void write(const GuiFrame &frame) {
+        if (frame.is_lobby) {
+            frame.view.writeLobby(gui);
+        } else if (gui_protocol == GuiProtocol::DELTA && !frame.keyframe_needed
+                   && last_was_game && frame.seq == last_seq + 1
+                   && !frame.predicted && !last_was_predicted
+                   && turns_since_keyframe < keyframe_interval) {
+            frame.view.writeDelta(gui);
+            ++turns_since_keyframe;
+        } else {
+            frame.view.writeGame(gui);
+            turns_since_keyframe = 1;
+        }
+        last_seq = frame.seq;
+        last_was_game = !frame.is_lobby;
+        last_was_predicted = frame.predicted;
+    }
+
+private:
+    UdpSocket &gui;
+    StateMailbox<GuiFrame> &mailbox;
+
+    const GuiProtocol gui_protocol;
+    const uint16_t keyframe_interval;
+    // Liczba tur od ostatniego wysłania do GUI pełnego stanu gry.
+    uint16_t turns_since_keyframe = 0;
+    uint64_t last_seq = 0;
+    bool last_was_game = false;
+    bool last_was_predicted = false;
+    MovePrediction *const prediction;
+};
+
+#endif //SIK_2_GUI_PUBLISHER_H
@@ -1,14 +1,21 @@
 #ifndef SIK_2_GUI_H
 #define SIK_2_GUI_H
 
+#include <optional>
+
 #include "types.h"
+#include "messages.h"
 #include "udp-socket.h"
+#include "gui-publisher.h"
+#include "input-latency.h"
 
 #define netstruct struct __attribute((packed))
 
 /**
  * Reaguje na komunikaty od GUI i
  * w odpowiedzi przesyła odpowiednie wiadomości do serwera.
+ * Ze stanu klienta czyta tylko atomową flagę `is_lobby`,
+ * więc nie czeka na obsługę wiadomości od serwera.
  */
 class GuiHandler {
     const uint8_t DIRECTION_MAX = 3;
@@ -17,10 +24,6 @@ class GuiHandler {
         GUI_PLACE_BOMB, GUI_PLACE_BLOCK, GUI_MOVE
     };
 
-    enum ClientMessage {
-        CLIENT_JOIN, CLIENT_PLACE_BOMB, CLIENT_PLACE_BLOCK, CLIENT_MOVE
-    };
-
     netstruct GUIMessage {
         uint8_t type;
     };
@@ -39,8 +42,9 @@ class GuiHandler {
     };
 
 public:
-    GuiHandler(UdpSocket &gui, TcpConnection &server, ClientState &state)
-            : gui(gui), server(server), state(state) {}
+    GuiHandler(UdpSocket &gui, TcpConnection &server, ClientState &state,
+               InputLatency *latency = nullptr, MovePrediction *prediction = nullptr)
+            : gui(gui), server(server), state(state), latency(latency), prediction(prediction) {}
 
     [[noreturn]] void run() {
         for (;;) {
@@ -48,10 +52,33 @@ public:
         }
     }
 
+    /**
+     * Prosi serwer o protokół `version`, a o kompresję tur,
+     * jeśli klient potrafi je rozpakować. Do czasu potwierdzenia
+     * wiadomości serwera są nadal w V1.
+     * Wywoływana przed `run()`, bo tylko jeden wątek pisze do serwera.
+     */
+    void requestProtocol(ProtocolVersion version) {
+        server.clearOutput();
+        server.write((uint8_t) CLIENT_SELECT_PROTOCOL);
+        server.write((uint8_t) version);
+#ifdef ROBOTS_WITH_ZLIB
+        server.write(PROTOCOL_FEATURE_DEFLATE);
+#else
+        server.write((uint8_t) 0);
+#endif
+        server.send();
+    }
+
 private:
     UdpSocket &gui;
     TcpConnection &server;
     ClientState &state;
+    InputLatency *const latency;
+    MovePrediction *const prediction;
+    // Polecenie gry wysyłane serwerowi w obsługiwanej wiadomości GUI.
+    std::optional<ClientMessageType> input;
+    std::optional<uint8_t> move;
 
     void handleJoin() {
         server.write((uint8_t) CLIENT_JOIN);
@@ -64,6 +91,7 @@ private:
             return;
         }
         server.write((uint8_t) CLIENT_PLACE_BOMB);
+        input = CLIENT_PLACE_BOMB;
     }
 
     void handlePlaceBlock() {
@@ -72,6 +100,7 @@ private:
             return;
         }
         server.write((uint8_t) CLIENT_PLACE_BLOCK);
+        input = CLIENT_PLACE_BLOCK;
     }
 
     void handleMove(uint8_t direction) {
@@ -86,12 +115,15 @@ private:
 
         server.write((uint8_t) CLIENT_MOVE);
         server.write(direction);
+        input = CLIENT_MOVE;
+        move = direction;
     }
 
     void handleMessage() {
         size_t len = gui.receive();
-        std::scoped_lock lock(state.mutex);
         server.clearOutput();
+        input.reset();
+        move.reset();
         auto m = (GUIMessage *) gui.input_buffer.data();
         if (len == sizeof(PlaceBomb) && m->type == GUI_PLACE_BOMB) {
             handlePlaceBomb();
@@ -104,6 +136,15 @@ private:
             return;
         }
         server.send();
+
+        if (latency && input) {
+            latency->sent(*input, move);
+        }
+        if (prediction && move) {
+            prediction->predictMove(*move);
+        } else if (prediction && input) {
+            prediction->cancel();
+        }
     }
 
 };
@@ -0,0 +1,124 @@
+#ifndef ROBOTS_CLIENT_INPUT_LATENCY_H
+#define ROBOTS_CLIENT_INPUT_LATENCY_H
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <ostream>
+
+#include <boost/format.hpp>
+
+#include "../common/protocol.h"
+#include "../server/stats.h"
+#include "types.h"
+#include "events.h"
+#include "messages.h"
+
+/**
+ * Pomiar czasu od wysłania polecenia z GUI do odebrania tury z jego skutkiem.
+ *
+ * Wątek wejścia GUI zapisuje moment wysłania polecenia, a wątek obsługi
+ * serwera szuka jego skutku w kolejnych turach: przesunięcia robota gracza
+ * na sąsiednie pole w kierunku ruchu (a nie np. odrodzenia po zniszczeniu)
+ * albo bomby lub bloku na polu, na którym robot stał przed turą.
+ * Mierzone jest tylko ostatnie polecenie; nowe polecenie wysłane przed
+ * potwierdzeniem poprzedniego zastępuje je. Polecenie bez skutku
+ * (np. ruch w ścianę) przestaje być mierzone po kilku turach.
+ */
+class InputLatency {
+    using clock = std::chrono::steady_clock;
+public:
+    /**
+     * Zapisuje wysłanie polecenia `kind`, dla ruchu w kierunku `direction`.
+     * Woła ją wątek wejścia GUI.
+     */
+    void sent(ClientMessageType kind, std::optional<uint8_t> direction = std::nullopt) {
+        std::scoped_lock lock(mutex);
+        if (pending) {
+            ++superseded;
+        }
+        pending = Pending{kind, direction, clock::now()};
+        ++inputs_sent;
+    }
+
+    /**
+     * Szuka w turze `turn` skutku oczekującego polecenia. Woła ją wątek
+     * obsługi serwera przed uwzględnieniem tury w stanie klienta, kiedy
+     * `position` to jeszcze pozycja robota gracza `own_id` sprzed tury.
+     */
+    void turnReceived(const Turn &turn, std::optional<PlayerId> own_id, std::optional<Position> position) {
+        auto now = clock::now();
+        std::scoped_lock lock(mutex);
+        if (!pending) {
+            return;
+        }
+        if (own_id) {
+            for (const auto &e: turn.events) {
+                if (tookEffect(e, *own_id, position)) {
+                    latency_us.record((uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                            now - pending->sent_at).count());
+                    ++confirmed;
+                    pending.reset();
+                    return;
+                }
+            }
+        }
+        if (++pending->turns > MAX_TURNS) {
+            ++unconfirmed;
+            pending.reset();
+        }
+    }
+
+    void print(std::ostream &os) const {
+        std::scoped_lock lock(mutex);
+        os << boost::format("inputs: %1% sent, %2% confirmed, %3% superseded, %4% without effect\n")
+              % inputs_sent % confirmed % superseded % unconfirmed;
+        latency_us.print(os, "input latency us");
+    }
+
+private:
+    // Po tylu turach bez skutku polecenie przestaje być mierzone.
+    static const unsigned MAX_TURNS = 2;
+
+    struct Pending {
+        ClientMessageType kind;
+        std::optional<uint8_t> direction;
+        clock::time_point sent_at;
+        unsigned turns = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::optional<Pending> pending;
+    Histogram latency_us;
+    uint64_t inputs_sent = 0;
+    uint64_t confirmed = 0;
+    uint64_t superseded = 0;
+    uint64_t unconfirmed = 0;
+
+    [[nodiscard]] bool tookEffect(const event_t &e, PlayerId own_id, std::optional<Position> position) const {
+        auto at = [&](const Position &p) { return position && std::is_eq(p <=> *position); };
+        switch (pending->kind) {
+            case CLIENT_MOVE:
+                return std::holds_alternative<PlayerMoved>(e) && std::is_eq(std::get<PlayerMoved>(e).id <=> own_id)
+                       && movedFrom(std::get<PlayerMoved>(e).position, position);
+            case CLIENT_PLACE_BOMB:
+                return std::holds_alternative<BombPlaced>(e) && at(std::get<BombPlaced>(e).position);
+            case CLIENT_PLACE_BLOCK:
+                return std::holds_alternative<BlockPlaced>(e) && at(std::get<BlockPlaced>(e).position);
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Czy `to` to pole sąsiadujące z `from` w kierunku oczekującego ruchu.
+     */
+    [[nodiscard]] bool movedFrom(const Position &to, std::optional<Position> from) const {
+        if (!from || !pending->direction || *pending->direction >= MOVE_DX.size()) {
+            return false;
+        }
+        return to.x == from->x + MOVE_DX[*pending->direction] && to.y == from->y + MOVE_DY[*pending->direction];
+    }
+};
+
+#endif //ROBOTS_CLIENT_INPUT_LATENCY_H
@@ -0,0 +1,134 @@
+#ifndef SIK_2_MESSAGE_READER_H
+#define SIK_2_MESSAGE_READER_H
+
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <endian.h>
+
+#include "../common/wire.h"
+
+/**
+ * Zgłaszany przez `MessageReader`, gdy w danych
+ * brakuje dalszej części dekodowanej wiadomości.
+ */
+struct IncompleteMessage : std::runtime_error {
+    IncompleteMessage() : std::runtime_error("Incomplete server message") {}
+};
+
+/**
+ * Czyta wiadomości serwera z bajtów odebranych wcześniej
+ * (np. asynchronicznie albo po rozpakowaniu), z tym samym interfejsem
+ * odczytu co `TcpConnection`, ale bez gniazda i buforów.
+ * Gdy dane się skończą, czytanie zgłasza `IncompleteMessage`.
+ */
+class MessageReader {
+public:
+    explicit MessageReader(std::span<const uint8_t> data,
+                           ProtocolVersion version = ProtocolVersion::V1)
+            : data(data), protocol_version(version) {}
+
+    /**
+     * Liczba przeczytanych bajtów.
+     */
+    [[nodiscard]] size_t consumed() const {
+        return pos;
+    }
+
+    /**
+     * Liczba jeszcze nieprzeczytanych bajtów.
+     */
+    [[nodiscard]] size_t buffered() const {
+        return data.size() - pos;
+    }
+
+    [[nodiscard]] ProtocolVersion protocol() const {
+        return protocol_version;
+    }
+
+    void setProtocol(ProtocolVersion version) {
+        protocol_version = version;
+    }
+
+    uint8_t readU8() {
+        require(1);
+        return data[pos++];
+    }
+
+    uint16_t readU16() {
+        return be16toh(readFixed<uint16_t>());
+    }
+
+    uint32_t readU32() {
+        return be32toh(readFixed<uint32_t>());
+    }
+
+    /**
+     * Czyta liczbę zapisaną po 7 bitów na bajt, od najmłodszych.
+     */
+    uint64_t readVarint() {
+        uint64_t res = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readU8();
+            res |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return res;
+            }
+        }
+        throw std::invalid_argument("Server message - varint too long");
+    }
+
+    /**
+     * Czyta varint, który musi się zmieścić w 32 bitach.
+     */
+    uint32_t readVarint32() {
+        uint64_t val = readVarint();
+        if (val > UINT32_MAX) {
+            throw std::invalid_argument("Server message - varint out of range");
+        }
+        return (uint32_t) val;
+    }
+
+    /**
+     * Długość listy lub słownika: w V1 liczba 32-bitowa, w V2 varint.
+     */
+    uint32_t readLength() {
+        return protocol_version == ProtocolVersion::V2 ? readVarint32() : readU32();
+    }
+
+    void readBytes(std::span<uint8_t> dst) {
+        require(dst.size());
+        memcpy(dst.data(), data.data() + pos, dst.size());
+        pos += dst.size();
+    }
+
+    std::string readString() {
+        uint8_t len = readU8();
+        require(len);
+        std::string res((const char *) data.data() + pos, len);
+        pos += len;
+        return res;
+    }
+
+private:
+    const std::span<const uint8_t> data;
+    ProtocolVersion protocol_version;
+    size_t pos = 0;
+
+    template<typename T>
+    T readFixed() {
+        T res;
+        readBytes({(uint8_t *) &res, sizeof(T)});
+        return res;
+    }
+
+    void require(size_t len) const {
+        if (data.size() - pos < len) {
+            throw IncompleteMessage{};
+        }
+    }
+};
+
+#endif //SIK_2_MESSAGE_READER_H
@@ -0,0 +1,159 @@
+#ifndef SIK_2_MESSAGES_H
+#define SIK_2_MESSAGES_H
+
+#ifdef ROBOTS_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include "types.h"
+#include "events.h"
+#include "message-reader.h"
+
+/**
+ * Struktury reprezentujące wiadomości
+ * przesyłane między klientem a serwerem gry.
+ * Rodzaje wiadomości i układ ich pól opisuje protocol.h.
+ */
+
+/* Tyle bajtów może mieć co najwyżej rozpakowana tura. */
+const uint64_t MAX_DECOMPRESSED_TURN_SIZE = 64 * 1024 * 1024;
+
+struct Hello {
+    string server_name;
+    uint8_t players_count;
+    uint16_t size_x;
+    uint16_t size_y;
+    uint16_t game_length;
+    uint16_t explosion_radius;
+    uint16_t bomb_timer;
+
+    using wire_layout = layout::Hello;
+    static constexpr auto wire_fields = std::tuple{
+            &Hello::server_name, &Hello::players_count, &Hello::size_x, &Hello::size_y,
+            &Hello::game_length, &Hello::explosion_radius, &Hello::bomb_timer};
+};
+
+struct AcceptedPlayer {
+    PlayerId id;
+    Player player;
+
+    using wire_layout = layout::AcceptedPlayer;
+    static constexpr auto wire_fields = std::tuple{&AcceptedPlayer::id, &AcceptedPlayer::player};
+};
+
+struct GameStarted {
+    map<PlayerId, Player> players;
+
+    using wire_layout = layout::GameStarted;
+    static constexpr auto wire_fields = std::tuple{&GameStarted::players};
+};
+
+struct Turn {
+    uint16_t turn;
+    vector<event_t> events;
+
+    template<typename Source>
+    static Turn read(Source &c) {
+        return {c.readU16(), readEventList(c)};
+    }
+};
+
+/* Bomba z obrazu gry i tura, w której ją podłożono. */
+struct PlacedBomb {
+    BombId id;
+    uint16_t turn;
+
+    using wire_layout = layout::PlacedBomb;
+    static constexpr auto wire_fields = std::tuple{&PlacedBomb::id, &PlacedBomb::turn};
+};
+
+/**
+ * Obraz gry wysyłany w V2 klientowi dołączającemu w trakcie gry:
+ * zdarzenia jak w turze oraz wyniki graczy i tury podłożenia bomb.
+ */
+struct Snapshot {
+    uint16_t turn;
+    // Wyniki graczy, których roboty zostały już zniszczone.
+    map<PlayerId, Score> scores;
+    vector<PlacedBomb> bombs;
+    vector<event_t> events;
+
+    using wire_layout = layout::Snapshot;
+    static constexpr auto wire_fields = std::tuple{&Snapshot::turn, &Snapshot::scores, &Snapshot::bombs};
+
+    template<typename Source>
+    static Snapshot read(Source &c) {
+        auto snapshot = wire::read<Snapshot>(c);
+        snapshot.events = readEventList(c);
+        return snapshot;
+    }
+};
+
+struct GameEnded {
+    map<PlayerId, Score> scores;
+
+    using wire_layout = layout::GameEnded;
+    static constexpr auto wire_fields = std::tuple{&GameEnded::scores};
+};
+
+/**
+ * Serwer potwierdza wersję protokołu. Potwierdzenie jest zawsze w V1,
+ * a kolejne wiadomości są już w potwierdzonej wersji.
+ */
+struct ProtocolSelected {
+    ProtocolVersion version;
+    uint8_t features;
+
+    using wire_layout = layout::ProtocolSelected;
+    static constexpr auto wire_fields = std::tuple{&ProtocolSelected::version, &ProtocolSelected::features};
+
+    static ProtocolSelected read(TcpConnection &c) {
+        auto selected = wire::read<ProtocolSelected>(c);
+        if (selected.version != ProtocolVersion::V1 && selected.version != ProtocolVersion::V2) {
+            throw std::invalid_argument((boost::format(
+                    "Server message - Unsupported protocol version: %1%") % (int) selected.version).str());
+        }
+        return selected;
+    }
+};
+
+/**
+ * Tura w V2 skompresowana deflate: długość rozpakowanej tury,
+ * długość danych i strumień zlib, który po rozpakowaniu
+ * jest zwykłą wiadomością TURN albo SNAPSHOT w V2.
+ */
+struct CompressedTurn {
+    template<typename Source>
+    static std::variant<Turn, Snapshot> read(Source &c) {
+        uint64_t raw_size = c.readVarint();
+        uint64_t size = c.readVarint();
+        if (raw_size > MAX_DECOMPRESSED_TURN_SIZE || size > MAX_DECOMPRESSED_TURN_SIZE) {
+            throw std::invalid_argument("Server message - compressed turn too large");
+        }
+        vector<uint8_t> compressed(size);
+        c.readBytes(compressed);
+
+#ifdef ROBOTS_WITH_ZLIB
+        vector<uint8_t> raw(raw_size);
+        uLongf len = (uLongf) raw_size;
+        if (uncompress(raw.data(), &len, compressed.data(), (uLong) size) != Z_OK
+            || len != raw_size) {
+            throw std::invalid_argument("Server message - corrupted compressed turn");
+        }
+
+        MessageReader turn{raw, ProtocolVersion::V2};
+        switch (turn.readU8()) {
+            case TURN:
+                return Turn::read(turn);
+            case SNAPSHOT:
+                return Snapshot::read(turn);
+            default:
+                throw std::invalid_argument("Server message - compressed message is not a turn");
+        }
+#else
+        throw std::invalid_argument("Server message - compressed turns are not supported");
+#endif
+    }
+};
+
+#endif //SIK_2_MESSAGES_H
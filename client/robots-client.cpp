@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <optional>
 #include <thread>
 
 #include <cerrno>
@@ -19,6 +20,8 @@
 #include "types.h"
 #include "server.h"
 #include "gui.h"
+#include "gui-publisher.h"
+#include "state-mailbox.h"
 
 using std::string;
 
@@ -57,40 +60,93 @@ namespace {
         }
     }
 
+    GuiProtocol parseGuiProtocol(const string &val) {
+        if (val == "full") {
+            return GuiProtocol::FULL;
+        } else if (val == "delta") {
+            return GuiProtocol::DELTA;
+        }
+        throw std::invalid_argument{"Program option invalid.\n"};
+    }
+
+    ProtocolVersion parseProtocolVersion(uint16_t val) {
+        if (val == (uint16_t) ProtocolVersion::V1 || val == (uint16_t) ProtocolVersion::V2) {
+            return (ProtocolVersion) val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    uint16_t parsePositive(uint16_t val) {
+        if (val > 0) {
+            return val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
     void usage(const options_description &desc) {
         std::cout << "Usage: " << program_invocation_name << "\n";
         std::cout << desc;
     }
 }
 
-void run(string server_addr, string server_port, string gui_addr,
-         string gui_port, const string &player_name, uint16_t port) {
+struct ClientParams {
+    string server_addr;
+    string server_port;
+    string gui_addr;
+    string gui_port;
+    string player_name;
+    uint16_t port;
+    GuiProtocol gui_protocol = GuiProtocol::FULL;
+    uint16_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+    std::optional<size_t> gui_mtu;
+    ProtocolVersion protocol = ProtocolVersion::V1;
+    bool measure_input_latency = false;
+    bool predict = false;
+};
+
+void run(const ClientParams &params) {
     boost::asio::io_context io_context;
     std::shared_ptr<TcpConnection> server;
     std::shared_ptr<UdpSocket> gui;
-    ClientState state{player_name};
+    ClientState state{params.player_name};
+    StateMailbox<GuiFrame> mailbox;
 
     // Próbuje nawiązać połączenie z serwerem.
     try {
-        server = std::make_shared<TcpConnection>(io_context, server_addr,
-                                                 server_port);
+        server = std::make_shared<TcpConnection>(io_context, params.server_addr,
+                                                 params.server_port);
     } catch (std::exception &e) {
         throw std::runtime_error{(boost::format(
                 "Failed to connect to game server at %1%:%2%. "
-                "Reason:\n") % server_addr % server_port).str() + e.what()};
+                "Reason:\n") % params.server_addr % params.server_port).str() + e.what()};
     }
 
     // Próbuje otworzyć gniazdo do komunikacji z GUI.
     try {
-        gui = std::make_shared<UdpSocket>(io_context, gui_addr, gui_port, port);
+        gui = std::make_shared<UdpSocket>(io_context, params.gui_addr, params.gui_port,
+                                          params.port, params.gui_mtu);
     } catch (std::exception &e) {
         throw std::runtime_error{(boost::format(
                 "Failed to open socket to GUI at %1%:%2%. "
-                "Reason:\n") % gui_addr % gui_port).str() + e.what()};
+                "Reason:\n") % params.gui_addr % params.gui_port).str() + e.what()};
+    }
+
+    std::unique_ptr<InputLatency> latency;
+    std::unique_ptr<MovePrediction> prediction;
+    if (params.measure_input_latency) {
+        latency = std::make_unique<InputLatency>();
+    }
+    if (params.predict) {
+        prediction = std::make_unique<MovePrediction>(mailbox);
     }
 
-    auto gui_handler = GuiHandler{*gui, *server, state};
-    auto server_handler = ServerHandler{*server, *gui, state};
+    auto gui_handler = GuiHandler{*gui, *server, state, latency.get(), prediction.get()};
+    auto server_handler = ServerHandler{*server, mailbox, state, latency.get(), prediction.get()};
+    auto gui_publisher = GuiPublisher{*gui, mailbox, params.gui_protocol, params.keyframe_interval,
+                                      prediction.get()};
+    if (params.protocol != ProtocolVersion::V1) {
+        gui_handler.requestProtocol(params.protocol);
+    }
 
     // Na oddzielnym wątku obsługujemy komunikację GUI -> klient -> serwer.
     std::jthread helper{[&]() {
@@ -102,7 +158,17 @@ void run(string server_addr, string server_port, string gui_addr,
         }
     }};
 
-    // W głównym wątku obsługujemy komunikację serwer -> klient -> GUI.
+    // Na kolejnym wątku wysyłamy do GUI najnowszy stan rozgrywki.
+    std::jthread publisher{[&]() {
+        try {
+            gui_publisher.run();
+        } catch (std::exception &e) {
+            std::cerr << e.what() << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }};
+
+    // W głównym wątku obsługujemy komunikację serwer -> klient.
     try {
         server_handler.run();
     } catch (std::exception &e) {
@@ -120,20 +186,46 @@ int main(int ac, char *av[]) {
             ("player-name,n", value<string>(), "At most 255 bytes string")
             ("port,p", value<uint16_t>())
             ("server-address,s", value<string>(),
-             "<(hostname):(port) or (IPv4):(port) or (IPv6):(port)>");
+             "<(hostname):(port) or (IPv4):(port) or (IPv6):(port)>")
+            ("gui-protocol", value<string>()->default_value("full"),
+             "'full' sends the whole game state to the GUI after every turn, "
+             "'delta' sends only the changes, with a full state every keyframe-interval turns.")
+            ("keyframe-interval", value<uint16_t>()->default_value(DEFAULT_KEYFRAME_INTERVAL),
+             "Turns between full game states in --gui-protocol delta. In (0, UINT16_MAX].")
+            ("gui-mtu", value<uint16_t>(),
+             "Split every message to the GUI into sequenced fragments that fit in packets "
+             "of this size (see UdpSocket for the reassembly format). At least 128. "
+             "Without it every message must fit in a single datagram.")
+            ("protocol-version", value<uint16_t>()->default_value(1),
+             "Version of the server protocol: 1 is the standard one, 2 is the compact one "
+             "(varint lengths, explosion arms instead of block lists and, when built with zlib, "
+             "compressed turns). Version 2 needs a server that supports it.")
+            ("measure-input-latency", bool_switch(),
+             "Measure the time from sending a move, bomb or block to receiving the turn with its effect "
+             "and print the percentiles to stderr after every game.")
+            ("predict", bool_switch(),
+             "Show the player's robot on the target field of a move before the server confirms it "
+             "and correct it when the turn from the server disagrees.");
 
     variables_map vm;
-    string server_addr, server_port, gui_addr, gui_port, player_name;
-    uint16_t port;
+    ClientParams params;
     try {
         store(parse_command_line(ac, av, desc), vm);
         notify(vm);
 
         checkOptions(vm);
-        player_name = vm["player-name"].as<string>();
-        port = vm["port"].as<uint16_t>();
-        splitPort(vm["server-address"].as<string>(), server_addr, server_port);
-        splitPort(vm["gui-address"].as<string>(), gui_addr, gui_port);
+        params.player_name = vm["player-name"].as<string>();
+        params.port = vm["port"].as<uint16_t>();
+        splitPort(vm["server-address"].as<string>(), params.server_addr, params.server_port);
+        splitPort(vm["gui-address"].as<string>(), params.gui_addr, params.gui_port);
+        params.gui_protocol = parseGuiProtocol(vm["gui-protocol"].as<string>());
+        params.keyframe_interval = parsePositive(vm["keyframe-interval"].as<uint16_t>());
+        if (vm.count("gui-mtu")) {
+            params.gui_mtu = vm["gui-mtu"].as<uint16_t>();
+        }
+        params.protocol = parseProtocolVersion(vm["protocol-version"].as<uint16_t>());
+        params.measure_input_latency = vm["measure-input-latency"].as<bool>();
+        params.predict = vm["predict"].as<bool>();
     } catch (std::exception &e) {
         usage(desc);
         exit(EXIT_FAILURE);
@@ -145,7 +237,7 @@ int main(int ac, char *av[]) {
     }
 
     try {
-        run(server_addr, server_port, gui_addr, gui_port, player_name, port);
+        run(params);
     } catch (std::exception &e) {
         std::cerr << e.what() << "\n";
         exit(EXIT_FAILURE);
@@ -6,14 +6,17 @@
 
 #include "types.h"
 #include "events.h"
-#include "udp-socket.h"
+#include "messages.h"
+#include "gui-publisher.h"
+#include "input-latency.h"
+#include "state-mailbox.h"
 
 /**
  * Obsługuje komunikację z serwerem gry, czyli:
  * - Odbiera wiadomości od serwera,
  * - Aktualizuje stan klienta,
- * - przesyła odpowiednie komunikaty do
- *   interfejsu użytkownika.
+ * - publikuje kopię stanu dla wątku wysyłającego
+ *   komunikaty do interfejsu użytkownika (GuiPublisher).
  */
 class ServerHandler {
 
@@ -27,85 +30,76 @@ class ServerHandler {
         using Ts::operator()...;
     };
 
-    // --- Struktury reprezentujące wiadomości od serwera ---
-
-    enum ServerMessage {
-        HELLO, ACCEPTED_PLAYER, GAME_STARTED, TURN, GAME_ENDED
-    };
+public:
+    ServerHandler(TcpConnection &server, StateMailbox<GuiFrame> &gui, ClientState &s,
+                  InputLatency *latency = nullptr, const MovePrediction *prediction = nullptr)
+            : server(server), gui(gui), state(s), latency(latency), prediction(prediction) {}
 
-    struct Hello {
-        string server_name;
-        uint8_t players_count;
-        uint16_t size_x;
-        uint16_t size_y;
-        uint16_t game_length;
-        uint16_t explosion_radius;
-        uint16_t bomb_timer;
-
-        static Hello read(TcpConnection &c) {
-            return {
-                    c.readString(), // server_name
-                    c.readU8(), // players_count
-                    c.readU16(), // size_x
-                    c.readU16(), // size_y
-                    c.readU16(), // game_length
-                    c.readU16(), // explosion_radius
-                    c.readU16(), // bomb_timer
-            };
+    [[noreturn]] void run() {
+        for (;;) {
+            handleMessage();
         }
-    };
+    }
 
-    struct AcceptedPlayer {
-        PlayerId id;
-        Player player;
+private:
+    TcpConnection &server;
+    StateMailbox<GuiFrame> &gui;
+    ClientState &state;
+    InputLatency *const latency;
+    const MovePrediction *const prediction;
+    uint64_t published = 0;
 
-        static AcceptedPlayer read(TcpConnection &c) {
-            return {PlayerId::read(c), Player::read(c)};
+    /**
+     * Kopiuje stan do wolnego bufora skrzynki i udostępnia go GUI.
+     * Zbiory pól planszy nie są kopiowane, tylko współdzielone
+     * do następnej zmiany (zob. PositionSet).
+     */
+    void publish() {
+        auto &frame = gui.back();
+        frame.view = state;
+        frame.is_lobby = state.is_lobby;
+        frame.keyframe_needed = state.keyframe_needed;
+        frame.seq = ++published;
+        frame.own_id = state.own_id;
+        if (!frame.is_lobby) {
+            state.keyframe_needed = false;
         }
-    };
-
-    struct GameStarted {
-        map<PlayerId, Player> players;
+        gui.publish();
+    }
 
-        static GameStarted read(TcpConnection &c) {
-            return {c.readMap<PlayerId, Player>()};
-        }
-    };
+    /**
+     * Aplikuje do stanu klienta zdarzenia z tury `turn`.
+     */
+    void applyTurn(uint16_t turn, const vector<event_t> &events) {
+        state.turn = turn;
+        state.explosions.clear();
 
-    struct Turn {
-        uint16_t turn;
-        vector<event_t> events;
+        // Z listy wydarzeń zbieramy informacje
+        // o zniszczonych blokach i robotach.
+        state.blocks_destroyed_in_turn.clear();
+        state.robots_destroyed_in_turn.clear();
+        state.delta.clear();
 
-        static Turn read(TcpConnection &c) {
-            return {c.readU16(), readEventList(c)};
+        for (auto &e: events) {
+            std::visit(Overloaded{
+                    [&](const BombPlaced &event) { event.apply(state); },
+                    [&](const BombExploded &event) { event.apply(state); },
+                    [&](const PlayerMoved &event) { event.apply(state); },
+                    [&](const BlockPlaced &event) { event.apply(state); }
+            }, e);
         }
-    };
-
-    struct GameEnded {
-        map<PlayerId, Score> scores;
 
-        static GameEnded read(TcpConnection &c) {
-            return {c.readMap<PlayerId, Score>()};
+        // Aplikujemy zebrane informacje
+        // o zniszczonych blokach i robotach.
+        // do stanu klienta.
+        for (const auto &p: state.robots_destroyed_in_turn) {
+            state.scores[p] = {state.scores[p].value + 1};
         }
-    };
-
-public:
-    ServerHandler(TcpConnection &server, UdpSocket &gui, ClientState &s)
-            : server(server), gui(gui), state(s) {}
-
-    [[noreturn]] void run() {
-        for (;;) {
-            gui.clearOutput();
-            handleMessage();
-            gui.send();
+        for (const auto &p: state.blocks_destroyed_in_turn) {
+            state.blocks.erase(p);
         }
     }
 
-private:
-    TcpConnection &server;
-    UdpSocket &gui;
-    ClientState &state;
-
     // --- Obsługa komunikatów od serwera. ---
 
     void handle(const Hello &m) {
@@ -116,12 +110,22 @@ private:
         state.game_length = m.game_length;
         state.explosion_radius = m.explosion_radius;
         state.bomb_timer = m.bomb_timer;
-        state.write(gui);
+        state.resetBoard();
+        // HELLO rozpoczyna obserwację lobby od nowa, np. po przeniesieniu
+        // klienta do innego pokoju albo po zmianie protokołu w trakcie gry.
+        // Trwającą grę wznowi dopiero ponowne GAME_STARTED.
+        state.is_lobby = true;
+        state.players.clear();
+        state.own_id.reset();
+        publish();
     }
 
     void handle(const AcceptedPlayer &m) {
         state.players[m.id] = m.player;
-        state.write(gui);
+        if (m.player.name == state.player_name) {
+            state.own_id = m.id;
+        }
+        publish();
     }
 
     void handle(const GameStarted &m) {
@@ -132,6 +136,11 @@ private:
 
         state.is_lobby = false; // Rozpoczęcie rozgrywki.
         state.players = m.players;
+        state.keyframe_needed = true;
+        // Klient dołączył za późno i tylko obserwuje grę.
+        if (state.own_id && !m.players.contains(*state.own_id)) {
+            state.own_id.reset();
+        }
 
         for (const auto &[id, player]: m.players) {
             state.scores[id] = {0};
@@ -139,68 +148,92 @@ private:
     }
 
     void handle(const Turn &m) {
-        state.turn = m.turn;
-        state.explosions.clear();
-
-        // Z listy wydarzeń zbieramy informacje
-        // o zniszczonych blokach i robotach.
-        state.blocks_destroyed_in_turn.clear();
-        state.robots_destroyed_in_turn.clear();
-
-        for (auto &[id, bomb]: state.bombs) {
-            --bomb.timer;
+        if (latency) {
+            std::optional<Position> own_position;
+            if (state.own_id && state.player_positions.contains(*state.own_id)) {
+                own_position = state.player_positions[*state.own_id];
+            }
+            latency->turnReceived(m, state.own_id, own_position);
         }
 
-        for (auto &e: m.events) {
-            std::visit(Overloaded{
-                    [&](const BombPlaced &event) { event.apply(state); },
-                    [&](const BombExploded &event) { event.apply(state); },
-                    [&](const PlayerMoved &event) { event.apply(state); },
-                    [&](const BlockPlaced &event) { event.apply(state); }
-            }, e);
-        }
+        applyTurn(m.turn, m.events);
+        publish();
+    }
 
-        // Aplikujemy zebrane informacje
-        // o zniszczonych blokach i robotach.
-        // do stanu klienta.
-        for (const auto &p: state.robots_destroyed_in_turn) {
-            state.scores[p] = {state.scores[p].value + 1};
+    /**
+     * Obraz gry odtwarza stan jak zwykła tura, a do tego ustawia
+     * wyniki graczy i liczniki bomb podłożonych przed dołączeniem klienta.
+     */
+    void handle(const Snapshot &m) {
+        applyTurn(m.turn, m.events);
+        for (const auto &bomb: m.bombs) {
+            if (auto it = state.bombs.find(bomb.id); it != state.bombs.end()) {
+                it->second.explode_turn = (uint32_t) bomb.turn + state.bomb_timer;
+            }
         }
-        for (const auto &p: state.blocks_destroyed_in_turn) {
-            state.blocks.erase(p);
+        for (const auto &[id, score]: m.scores) {
+            state.scores[id] = score;
         }
+        // Zmiany w `delta` mają pełne liczniki bomb, więc GUI dostaje cały stan.
+        state.keyframe_needed = true;
+        publish();
+    }
 
-        state.write(gui);
+    void handle(const std::variant<Turn, Snapshot> &m) {
+        std::visit([&](const auto &message) { handle(message); }, m);
+    }
+
+    void handle(const ProtocolSelected &m) {
+        server.setProtocol(m.version);
     }
 
     void handle(const GameEnded &m) {
+        // Ostatnia tura gry nie może ustąpić miejsca lobby,
+        // zanim GUI jej nie dostanie.
+        gui.drain();
         state.is_lobby = true; // Powrót do lobby.
         state.scores = m.scores;
         state.players.clear();
         state.blocks.clear();
         state.bombs.clear();
         state.explosions.clear();
-        state.write(gui);
+        state.own_id.reset();
+        publish();
+
+        if (latency) {
+            latency->print(std::cerr);
+        }
+        if (prediction) {
+            prediction->print(std::cerr);
+        }
     }
 
     void handleMessage() {
         uint8_t event_type = server.readU8();
-        std::scoped_lock lock(state.mutex);
         switch (event_type) {
             case HELLO:
-                handle(Hello::read(server));
+                handle(wire::read<Hello>(server));
                 break;
             case ACCEPTED_PLAYER:
-                handle(AcceptedPlayer::read(server));
+                handle(wire::read<AcceptedPlayer>(server));
                 break;
             case GAME_STARTED:
-                handle(GameStarted::read(server));
+                handle(wire::read<GameStarted>(server));
                 break;
             case TURN:
                 handle(Turn::read(server));
                 break;
             case GAME_ENDED:
-                handle(GameEnded::read(server));
+                handle(wire::read<GameEnded>(server));
+                break;
+            case PROTOCOL_SELECTED:
+                handle(ProtocolSelected::read(server));
+                break;
+            case COMPRESSED_TURN:
+                handle(CompressedTurn::read(server));
+                break;
+            case SNAPSHOT:
+                handle(Snapshot::read(server));
                 break;
             default:
                 // Klient powinien rozłączyć się
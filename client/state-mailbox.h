@@ -0,0 +1,99 @@
+#ifndef SIK_2_STATE_MAILBOX_H
+#define SIK_2_STATE_MAILBOX_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Skrzynka z najnowszą wartością dla jednego producenta i jednego konsumenta
+ * (potrójny bufor).
+ *
+ * Producent wypełnia swój bufor (`back()`) i wymienia go atomowo ze środkowym
+ * (`publish()`), nigdy nie czekając na konsumenta. Konsument zabiera środkowy
+ * bufor w zamian za swój (`take()`), więc dostaje zawsze ostatnią opublikowaną
+ * wartość, a wartości opublikowane w międzyczasie przepadają.
+ * Gdy wartość nie może przepaść, producent czeka na nią przez `drain()`.
+ * Inny wątek może obudzić konsumenta bez nowej wartości (`wake()`).
+ * Bufory są używane wielokrotnie, więc kopiowanie do `back()` nie musi
+ * przydzielać pamięci.
+ */
+template<typename T>
+class StateMailbox {
+public:
+    /**
+     * Bufor producenta, do wypełnienia przed `publish()`.
+     */
+    T &back() {
+        return buffers[back_index];
+    }
+
+    /**
+     * Udostępnia konsumentowi zawartość `back()`. Wartość,
+     * której konsument jeszcze nie zabrał, zostaje zastąpiona.
+     */
+    void publish() {
+        auto previous = middle.exchange((uint8_t) (back_index | FRESH), std::memory_order_acq_rel);
+        back_index = previous & INDEX_MASK;
+        middle.notify_all();
+    }
+
+    /**
+     * Czeka na wartość opublikowaną od poprzedniego wywołania i ją zwraca.
+     * Po `wake()` zwraca ponownie poprzednią wartość, o ile nie ma nowej.
+     * Wartość jest ważna do następnego wywołania `take()`.
+     */
+    const T &take() {
+        for (;;) {
+            auto current = middle.load(std::memory_order_acquire);
+            if (current & FRESH) {
+                auto previous = middle.exchange(front_index, std::memory_order_acq_rel);
+                front_index = previous & INDEX_MASK;
+                middle.notify_all();
+                return buffers[front_index];
+            }
+            if (current & WOKEN) {
+                if (middle.compare_exchange_weak(current, (uint8_t) (current & ~WOKEN),
+                                                 std::memory_order_acq_rel)) {
+                    return buffers[front_index];
+                }
+                continue;
+            }
+            middle.wait(current, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * Budzi konsumenta czekającego w `take()`, nawet bez nowej wartości.
+     * Może ją wołać dowolny wątek.
+     */
+    void wake() {
+        middle.fetch_or(WOKEN, std::memory_order_acq_rel);
+        middle.notify_all();
+    }
+
+    /**
+     * Czeka, aż konsument zabierze ostatnią opublikowaną wartość,
+     * żeby następna publikacja jej nie zastąpiła.
+     */
+    void drain() {
+        for (auto current = middle.load(std::memory_order_acquire); current & FRESH;
+             current = middle.load(std::memory_order_acquire)) {
+            middle.wait(current, std::memory_order_acquire);
+        }
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x3;
+    // Środkowy bufor zawiera wartość, której konsument jeszcze nie widział.
+    static const uint8_t FRESH = 0x4;
+    // Konsument ma wrócić z `take()`, choć nie ma nowej wartości.
+    static const uint8_t WOKEN = 0x8;
+
+    std::array<T, 3> buffers{};
+    uint8_t back_index = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t front_index = 2;
+};
+
+#endif //SIK_2_STATE_MAILBOX_H
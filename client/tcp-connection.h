@@ -1,6 +1,8 @@
 #ifndef SIK_2_TCPCONNECTION_H
 #define SIK_2_TCPCONNECTION_H
 
+#include <cstring>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -8,19 +10,14 @@
 #include <boost/array.hpp>
 #include <boost/format.hpp>
 
+#include "../common/wire.h"
+
 using std::vector;
 using std::map;
 using std::string;
 
 const size_t BUFFER_SIZE = 10000;
 
-class TcpConnection;
-
-template<typename T>
-concept Readable = requires(T, TcpConnection &c) {
-    { T::read(c) } -> std::convertible_to<T>;
-};
-
 namespace asio = boost::asio;
 
 /**
@@ -42,6 +39,24 @@ public:
         socket.set_option(tcp::no_delay{true});
     }
 
+    /**
+     * Liczba odebranych, jeszcze nieprzeczytanych bajtów.
+     */
+    [[nodiscard]] size_t buffered() const {
+        return input_end - input_beg;
+    }
+
+    /**
+     * Wersja protokołu, w której są kodowane odbierane wiadomości.
+     */
+    [[nodiscard]] ProtocolVersion protocol() const {
+        return protocol_version;
+    }
+
+    void setProtocol(ProtocolVersion version) {
+        protocol_version = version;
+    }
+
     // --- Czytanie przysyłanych danych ---
 
     uint8_t readU8() {
@@ -52,49 +67,70 @@ public:
     }
 
     uint16_t readU16() {
-        uint16_t res;
-        ((uint8_t *) &res)[0] = readU8();
-        ((uint8_t *) &res)[1] = readU8();
-        return be16toh(res);
+        return be16toh(readFixed<uint16_t>());
     }
 
     uint32_t readU32() {
-        uint32_t res;
-        ((uint8_t *) &res)[0] = readU8();
-        ((uint8_t *) &res)[1] = readU8();
-        ((uint8_t *) &res)[2] = readU8();
-        ((uint8_t *) &res)[3] = readU8();
-        return be32toh(res);
+        return be32toh(readFixed<uint32_t>());
     }
 
-    string readString() {
-        uint8_t len = readU8();
-        string res;
-        for (uint8_t i = 0; i < len; ++i) {
-            res += (char) readU8();
+    /**
+     * Czyta liczbę zapisaną po 7 bitów na bajt, od najmłodszych.
+     */
+    uint64_t readVarint() {
+        if (input_beg < input_end && !(input_buffer[input_beg] & 0x80)) {
+            // Krótkie varinty (długości list, ramiona wybuchów) mają jeden bajt.
+            return input_buffer[input_beg++];
         }
-        return res;
+        uint64_t res = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readU8();
+            res |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return res;
+            }
+        }
+        throw std::invalid_argument("Server message - varint too long");
     }
 
-    template<Readable T>
-    vector<T> readList() {
-        uint32_t len = readU32();
-        vector<T> res;
-        for (uint32_t i = 0; i < len; ++i) {
-            res.push_back(T::read(*this));
+    /**
+     * Czyta varint, który musi się zmieścić w 32 bitach.
+     */
+    uint32_t readVarint32() {
+        uint64_t val = readVarint();
+        if (val > UINT32_MAX) {
+            throw std::invalid_argument("Server message - varint out of range");
         }
-        return res;
+        return (uint32_t) val;
+    }
+
+    /**
+     * Długość listy lub słownika: w V1 liczba 32-bitowa, w V2 varint.
+     */
+    uint32_t readLength() {
+        return protocol_version == ProtocolVersion::V2 ? readVarint32() : readU32();
     }
 
-    template<Readable K, Readable V>
-    map<K, V> readMap() {
-        uint32_t len = readU32();
-        map<K, V> res;
-        for (uint32_t i = 0; i < len; ++i) {
-            K key = K::read(*this);
-            V value = V::read(*this);
-            res[key] = value;
+    /**
+     * Wypełnia `dst` kolejnymi odebranymi bajtami.
+     * Dane są kopiowane z bufora całymi porcjami.
+     */
+    void readBytes(std::span<uint8_t> dst) {
+        while (!dst.empty()) {
+            if (input_beg == input_end) {
+                receive();
+            }
+            size_t len = std::min(dst.size(), input_end - input_beg);
+            memcpy(dst.data(), input_buffer.data() + input_beg, len);
+            input_beg += len;
+            dst = dst.subspan(len);
         }
+    }
+
+    string readString() {
+        uint8_t len = readU8();
+        string res(len, '\0');
+        readBytes({(uint8_t *) res.data(), res.size()});
         return res;
     }
 
@@ -110,10 +146,24 @@ public:
         ++output_size;
     }
 
-    void write(string &s) {
+    void write(const string &s) {
         write((uint8_t) s.length());
-        for (char c : s) {
-            write((uint8_t) c);
+        writeBytes({(const uint8_t *) s.data(), s.length()});
+    }
+
+    /**
+     * Dopisuje do bufora `src`, wysyłając bufor za każdym razem,
+     * gdy się zapełni.
+     */
+    void writeBytes(std::span<const uint8_t> src) {
+        while (!src.empty()) {
+            if (output_size == output_buffer.size()) {
+                send();
+            }
+            size_t len = std::min(src.size(), output_buffer.size() - output_size);
+            memcpy(output_buffer.data() + output_size, src.data(), len);
+            output_size += len;
+            src = src.subspan(len);
         }
     }
 
@@ -151,6 +201,23 @@ private:
     size_t input_beg = 0;
     size_t input_end = 0;
     size_t output_size = 0;
+    ProtocolVersion protocol_version = ProtocolVersion::V1;
+
+    /**
+     * Czyta liczbę o stałej szerokości (w kolejności bajtów sieci).
+     * Jeśli cała liczba jest już w buforze, to wystarcza jedno kopiowanie.
+     */
+    template<typename T>
+    T readFixed() {
+        T res;
+        if (input_end - input_beg >= sizeof(T)) {
+            memcpy(&res, input_buffer.data() + input_beg, sizeof(T));
+            input_beg += sizeof(T);
+        } else {
+            readBytes({(uint8_t *) &res, sizeof(T)});
+        }
+        return res;
+    }
 
     /**
      * Odbiera porcję danych i przechowuje ją w buforze `input_buffer`
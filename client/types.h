@@ -1,28 +1,37 @@
 #ifndef SIK_2_TYPES_H
 #define SIK_2_TYPES_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <variant>
 #include <vector>
 #include <map>
+#include <memory>
+#include <ranges>
 #include <set>
 
 #include <endian.h>
 
+#include "../common/protocol.h"
 #include "tcp-connection.h"
 #include "udp-socket.h"
 
 /**
  * Definicje struktur występujących w komunikatach
  * przesyłanych między serwerem oraz interfejsem użytkownika.
+ * Ich układ w wiadomościach serwera opisuje protocol.h.
  */
 
 struct PlayerId {
     uint8_t value;
 
-    static PlayerId read(TcpConnection &c) {
-        return {c.readU8()};
-    }
+    using wire_layout = layout::PlayerId;
+    static constexpr auto wire_fields = std::tuple{&PlayerId::value};
 
     void write(UdpSocket &s) const {
         s.write(value);
@@ -37,9 +46,8 @@ struct PlayerId {
 struct Score {
     uint32_t value;
 
-    static Score read(TcpConnection &c) {
-        return {c.readU32()};
-    }
+    using wire_layout = layout::Score;
+    static constexpr auto wire_fields = std::tuple{&Score::value};
 
     void write(UdpSocket &s) const {
         s.write(value);
@@ -49,9 +57,8 @@ struct Score {
 struct BombId {
     uint32_t value;
 
-    static BombId read(TcpConnection &c) {
-        return {c.readU32()};
-    }
+    using wire_layout = layout::BombId;
+    static constexpr auto wire_fields = std::tuple{&BombId::value};
 
     void write(UdpSocket &s) const {
         s.write(value);
@@ -66,9 +73,8 @@ struct Player {
     string name;
     string address;
 
-    static Player read(TcpConnection &c) {
-        return {c.readString(), c.readString()};
-    }
+    using wire_layout = layout::Player;
+    static constexpr auto wire_fields = std::tuple{&Player::name, &Player::address};
 
     void write(UdpSocket &s) const {
         s.write(name);
@@ -80,9 +86,8 @@ struct Position {
     uint16_t x;
     uint16_t y;
 
-    static Position read(TcpConnection &c) {
-        return {c.readU16(), c.readU16()};
-    }
+    using wire_layout = layout::Position;
+    static constexpr auto wire_fields = std::tuple{&Position::x, &Position::y};
 
     void write(UdpSocket &s) const {
         s.write(x);
@@ -94,6 +99,10 @@ struct Position {
     }
 };
 
+// Przesunięcia w kierunkach ruchu: w górę, w prawo, w dół i w lewo.
+constexpr std::array<int, 4> MOVE_DX = {0, 1, 0, -1};
+constexpr std::array<int, 4> MOVE_DY = {1, 0, -1, 0};
+
 struct Bomb {
     Position position;
     uint16_t timer;
@@ -104,30 +113,375 @@ struct Bomb {
     }
 };
 
+/**
+ * Bomba na planszy. Zamiast licznika pamięta numer tury, w której
+ * licznik dojdzie do zera, więc kolejne tury nie muszą zmniejszać liczników.
+ */
+struct ArmedBomb {
+    Position position;
+    uint32_t explode_turn;
+
+    [[nodiscard]] Bomb at(uint16_t turn) const {
+        return {position, (uint16_t) (explode_turn > turn ? explode_turn - turn : 0)};
+    }
+};
+
+/* Budżet pamięci (w bajtach) na mapę bitową jednego zbioru pól planszy. */
+const uint64_t BOARD_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+/**
+ * Gęsta reprezentacja zbioru pól: mapa bitowa z jednym bitem na pole.
+ *
+ * Pola są numerowane kolumnami (x * size_y + y), więc kolejność bitów
+ * jest kolejnością pozycji, a odcinek kolumny to ciągły zakres bitów.
+ * Czyszczenie zeruje tylko słowa, w których coś ustawiono.
+ * Pozycje spoza planszy nie należą do zbioru i nie są do niego wstawiane.
+ */
+class DensePositionSet {
+public:
+    DensePositionSet(uint16_t size_x, uint16_t size_y)
+            : size_x(size_x), size_y(size_y), words(memoryFor(size_x, size_y) / sizeof(uint64_t)) {}
+
+    [[nodiscard]] bool contains(Position pos) const {
+        if (!inBoard(pos)) {
+            return false;
+        }
+        size_t i = index(pos);
+        return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    bool insert(Position pos) {
+        if (!inBoard(pos)) {
+            return false;
+        }
+        size_t i = index(pos);
+        return setBits(i / WORD_BITS, (uint64_t) 1 << (i % WORD_BITS)) > 0;
+    }
+
+    void erase(Position pos) {
+        if (!inBoard(pos)) {
+            return;
+        }
+        size_t i = index(pos);
+        uint64_t mask = (uint64_t) 1 << (i % WORD_BITS);
+        if (words[i / WORD_BITS] & mask) {
+            words[i / WORD_BITS] &= ~mask;
+            --count;
+        }
+    }
+
+    /**
+     * Wstawia pola (x, y) dla y z przedziału [y_from, y_to],
+     * całymi słowami mapy bitowej. Odcinek musi leżeć na planszy.
+     */
+    void insertColumnSpan(uint16_t x, uint16_t y_from, uint16_t y_to) {
+        assert(inBoard({x, y_to}) && y_from <= y_to);
+        size_t beg = index({x, y_from});
+        size_t end = index({x, y_to}) + 1;
+        while (beg < end) {
+            size_t bit = beg % WORD_BITS;
+            size_t len = std::min(WORD_BITS - bit, end - beg);
+            uint64_t mask = (len == WORD_BITS ? ~(uint64_t) 0 : ((uint64_t) 1 << len) - 1) << bit;
+            setBits(beg / WORD_BITS, mask);
+            beg += len;
+        }
+    }
+
+    void clear() {
+        if (count == 0 && touched.empty()) {
+            return;
+        }
+        if (all_touched) {
+            std::fill(words.begin(), words.end(), 0);
+        } else {
+            for (size_t w: touched) {
+                words[w] = 0;
+            }
+        }
+        touched.clear();
+        all_touched = false;
+        count = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    /**
+     * Zwraca pusty zbiór pól tej samej planszy.
+     */
+    [[nodiscard]] DensePositionSet empty() const {
+        return {(uint16_t) size_x, (uint16_t) size_y};
+    }
+
+    /**
+     * Woła `f` dla każdego pola zbioru, w kolejności pozycji.
+     */
+    template<typename F>
+    void forEach(F f) const {
+        size_t visited = 0;
+        for (size_t w = 0; visited < count; ++w) {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                size_t i = w * WORD_BITS + (size_t) std::countr_zero(bits);
+                f(Position{(uint16_t) (i / size_y), (uint16_t) (i % size_y)});
+                ++visited;
+            }
+        }
+    }
+
+    static size_t memoryFor(uint16_t size_x, uint16_t size_y) {
+        return ((size_t) size_x * size_y + WORD_BITS - 1) / WORD_BITS * sizeof(uint64_t);
+    }
+
+private:
+    static const size_t WORD_BITS = 64;
+
+    size_t size_x;
+    size_t size_y;
+    std::vector<uint64_t> words;
+    size_t count = 0;
+    // Słowa, które były niezerowe od ostatniego czyszczenia
+    // (z powtórzeniami); gdy jest ich zbyt wiele, czyszczona jest cała mapa.
+    std::vector<size_t> touched;
+    bool all_touched = false;
+
+    [[nodiscard]] bool inBoard(Position pos) const {
+        return pos.x < size_x && pos.y < size_y;
+    }
+
+    [[nodiscard]] size_t index(Position pos) const {
+        return (size_t) pos.x * size_y + pos.y;
+    }
+
+    /**
+     * Ustawia w słowie `w` bity maski. Zwraca liczbę nowo ustawionych bitów.
+     */
+    size_t setBits(size_t w, uint64_t mask) {
+        uint64_t added = mask & ~words[w];
+        if (added == 0) {
+            return 0;
+        }
+        if (words[w] == 0 && !all_touched) {
+            if (touched.size() < words.size() / 4) {
+                touched.push_back(w);
+            } else {
+                all_touched = true;
+            }
+        }
+        words[w] |= added;
+        auto n = (size_t) std::popcount(added);
+        count += n;
+        return n;
+    }
+};
+
+/**
+ * Rzadka reprezentacja zbioru pól, dla plansz,
+ * których mapa bitowa nie mieści się w budżecie pamięci.
+ */
+class SparsePositionSet {
+public:
+    [[nodiscard]] bool contains(Position pos) const {
+        return positions.contains(pos);
+    }
+
+    bool insert(Position pos) {
+        return positions.insert(pos).second;
+    }
+
+    void erase(Position pos) {
+        positions.erase(pos);
+    }
+
+    void insertColumnSpan(uint16_t x, uint16_t y_from, uint16_t y_to) {
+        for (uint32_t y = y_from; y <= y_to; ++y) {
+            positions.insert(Position{x, (uint16_t) y});
+        }
+    }
+
+    void clear() {
+        positions.clear();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return positions.size();
+    }
+
+    [[nodiscard]] SparsePositionSet empty() const {
+        return {};
+    }
+
+    template<typename F>
+    void forEach(F f) const {
+        for (const auto &pos: positions) {
+            f(pos);
+        }
+    }
+
+private:
+    std::set<Position> positions;
+};
+
+/**
+ * Zbiór pól planszy (np. bloków albo pól objętych wybuchami).
+ *
+ * Jeśli mapa bitowa planszy mieści się w budżecie pamięci, to sprawdzenie,
+ * wstawienie i usunięcie pola jest O(1), a wpp. używany jest
+ * uporządkowany zbiór pozycji. Do GUI zbiór trafia jako lista pozycji.
+ *
+ * Kopie zbioru współdzielą pola aż do zmiany jednej z nich (kopiowanie
+ * przy zapisie), więc kopia stanu dla GUI nie kopiuje planszy.
+ * Zmieniać zbiór może tylko jeden wątek, czytać jego kopie dowolne.
+ */
+class PositionSet {
+public:
+    PositionSet() = default;
+
+    PositionSet(uint16_t size_x, uint16_t size_y)
+            : positions(std::make_shared<Positions>(makePositions(size_x, size_y))) {}
+
+    [[nodiscard]] bool contains(Position pos) const {
+        return std::visit([&](const auto &p) { return p.contains(pos); }, *positions);
+    }
+
+    /**
+     * Wstawia pole `pos`. Zwraca `false`, jeśli już było w zbiorze.
+     */
+    bool insert(Position pos) {
+        if (contains(pos)) {
+            return false;
+        }
+        return std::visit([&](auto &p) { return p.insert(pos); }, own());
+    }
+
+    void erase(Position pos) {
+        if (contains(pos)) {
+            std::visit([&](auto &p) { p.erase(pos); }, own());
+        }
+    }
+
+    /**
+     * Wstawia wiersz pól [x_from, x_to] × {y}.
+     */
+    void insertRowSpan(uint16_t y, uint16_t x_from, uint16_t x_to) {
+        std::visit([&](auto &p) {
+            for (uint32_t x = x_from; x <= x_to; ++x) {
+                p.insert(Position{(uint16_t) x, y});
+            }
+        }, own());
+    }
+
+    /**
+     * Wstawia kolumnę pól {x} × [y_from, y_to].
+     */
+    void insertColumnSpan(uint16_t x, uint16_t y_from, uint16_t y_to) {
+        std::visit([&](auto &p) { p.insertColumnSpan(x, y_from, y_to); }, own());
+    }
+
+    void clear() {
+        if (size() == 0) {
+            return;
+        }
+        if (positions.use_count() > 1) {
+            // Pusty zbiór zamiast kopii, którą i tak trzeba by wyczyścić.
+            positions = std::make_shared<Positions>(
+                    std::visit([](const auto &p) -> Positions { return p.empty(); }, *positions));
+            return;
+        }
+        std::visit([](auto &p) { p.clear(); }, own());
+    }
+
+    [[nodiscard]] size_t size() const {
+        return std::visit([](const auto &p) { return p.size(); }, *positions);
+    }
+
+    void write(UdpSocket &s) const {
+        s.write((uint32_t) size());
+        std::visit([&](const auto &p) {
+            p.forEach([&](const Position &pos) { pos.write(s); });
+        }, *positions);
+    }
+
+private:
+    using Positions = std::variant<SparsePositionSet, DensePositionSet>;
+
+    std::shared_ptr<Positions> positions = std::make_shared<Positions>();
+
+    /**
+     * Zwraca pola do zmiany, najpierw kopiując je, jeśli współdzieli je
+     * inna kopia zbioru.
+     */
+    Positions &own() {
+        if (positions.use_count() > 1) {
+            positions = std::make_shared<Positions>(*positions);
+        } else {
+            // Inne kopie mogły zostać zwolnione na innym wątku; ich odczyty
+            // muszą poprzedzić zmiany.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *positions;
+    }
+
+    static Positions makePositions(uint16_t size_x, uint16_t size_y) {
+        if (DensePositionSet::memoryFor(size_x, size_y) <= BOARD_MEMORY_BUDGET) {
+            return DensePositionSet{size_x, size_y};
+        }
+        return SparsePositionSet{};
+    }
+};
+
 enum State {
-    LOBBY, GAME
+    LOBBY, GAME, GAME_DELTA
 };
 
 /**
- * To jest struktura reprezentująca aktualny stan rozgrywki.
- * Przechowuje wszystkie informacje,
- * które są wysyłane do interfejsu użytkownika.
+ * Sposób przesyłania stanu rozgrywki do GUI.
+ *
+ * W trybie FULL po każdej turze GUI dostaje cały stan gry (GAME).
+ * W trybie DELTA dostaje tylko zmiany od poprzedniej tury (GAME_DELTA),
+ * a co `keyframe_interval` tur (oraz w pierwszej turze gry) cały stan.
+ * Pełny stan naprawia ewentualne rozbieżności po zgubionych datagramach.
  */
-struct ClientState {
-    explicit ClientState(std::string player_name_opt)
-            : player_name(std::move(player_name_opt)) {}
+enum class GuiProtocol {
+    FULL, DELTA
+};
+
+const uint16_t DEFAULT_KEYFRAME_INTERVAL = 50;
+
+/**
+ * Zmiany stanu rozgrywki w ostatniej turze.
+ *
+ * GUI w trybie DELTA aplikuje je do stanu z poprzedniej tury
+ * w kolejności pól, po zmniejszeniu liczników wszystkich bomb o 1.
+ * Tak jak na serwerze bomby wybuchają, zanim gracze postawią nowe, więc
+ * wybuchłe bomby poprzedzają postawione. Za każdą pozycję wybuchłej bomby
+ * GUI usuwa bombę z tego pola o najmniejszym liczniku (czyli tę, której
+ * licznik doszedł do 0), a nie bombę postawioną w tej samej turze.
+ */
+struct TurnDelta {
+    std::set<PlayerId> players_moved;
+    vector<Position> blocks_placed;
+    vector<Position> bombs_exploded;
+    vector<Bomb> bombs_placed;
+
+    void clear() {
+        players_moved.clear();
+        blocks_placed.clear();
+        bombs_exploded.clear();
+        bombs_placed.clear();
+    }
+};
 
+/**
+ * Stan rozgrywki widoczny w GUI, razem z zapisem
+ * do każdego z komunikatów dla interfejsu użytkownika.
+ */
+struct GameView {
     /* Agregacja informacji z listy wydarzeń
      * przesyłanej przez serwer w wiadomości TURN. */
     std::set<PlayerId> robots_destroyed_in_turn;
     std::set<Position> blocks_destroyed_in_turn;
-
-    /* Synchronizacja, żeby klient nie wysłał komunikatu JOIN
-     * po odbiorze od serwera wiadomości GAME_STARTED. */
-    std::mutex mutex;
-
-    bool is_lobby = true;
-    string player_name{};
+    TurnDelta delta;
 
     string server_name;
     uint8_t players_count{};
@@ -141,20 +495,19 @@ struct ClientState {
     uint16_t turn{};
     map<PlayerId, Player> players;
     map<PlayerId, Position> player_positions;
-    std::set<Position> blocks;
-    map<BombId, Bomb> bombs;
-    std::set<Position> explosions;
+    PositionSet blocks;
+    map<BombId, ArmedBomb> bombs;
+    PositionSet explosions;
     map<PlayerId, Score> scores;
 
-    void write(UdpSocket &s) {
-        if (is_lobby) {
-            writeLobby(s);
-        } else {
-            writeGame(s);
-        }
+    /**
+     * Dopasowuje zbiory pól do rozmiaru planszy z HELLO.
+     */
+    void resetBoard() {
+        blocks = PositionSet{size_x, size_y};
+        explosions = PositionSet{size_x, size_y};
     }
 
-private:
     void writeLobby(UdpSocket &s) const {
         s.write((uint8_t) LOBBY);
         s.write(server_name);
@@ -176,24 +529,76 @@ private:
         s.write(turn);
         s.writeMap<PlayerId, Player>(players);
         s.writeMap<PlayerId, Position>(player_positions);
-        s.writeList<Position>(
-                vector<Position>(blocks.begin(), blocks.end()));
-        s.writeList<Bomb>(toList(bombs));
-        s.writeList<Position>(
-                vector<Position>(explosions.begin(), explosions.end()));
+        blocks.write(s);
+        s.writeList(bombs | std::views::values | std::views::transform([&](const ArmedBomb &bomb) {
+            return bomb.at(turn);
+        }));
+        explosions.write(s);
         s.writeMap<PlayerId, Score>(scores);
     }
 
-private:
-    static vector<Bomb> toList(const map<BombId, Bomb> &bombs) {
-        vector<Bomb> res;
-        res.reserve(bombs.size());
-        for (const auto &[k, v]: bombs) {
-            res.push_back(v);
+    /**
+     * Zapisuje zmiany stanu z ostatniej tury:
+     * nowe pozycje robotów, roboty zniszczone (i nieodrodzone w tej turze),
+     * postawione i zniszczone bloki, wybuchłe i nowe bomby,
+     * wybuchy oraz wyniki graczy, których roboty zniszczono.
+     */
+    void writeDelta(UdpSocket &s) const {
+        s.write((uint8_t) GAME_DELTA);
+        s.write(turn);
+
+        s.write((uint32_t) delta.players_moved.size());
+        for (const auto &id: delta.players_moved) {
+            id.write(s);
+            player_positions.at(id).write(s);
+        }
+        auto removed = robots_destroyed_in_turn | std::views::filter([&](const PlayerId &id) {
+            return !player_positions.contains(id);
+        });
+        s.write((uint32_t) std::ranges::distance(removed));
+        for (const auto &id: removed) {
+            id.write(s);
+        }
+
+        s.writeList(delta.blocks_placed);
+        s.writeList(blocks_destroyed_in_turn);
+        s.writeList(delta.bombs_exploded);
+        s.writeList(delta.bombs_placed);
+        explosions.write(s);
+
+        s.write((uint32_t) robots_destroyed_in_turn.size());
+        for (const auto &id: robots_destroyed_in_turn) {
+            id.write(s);
+            scores.at(id).write(s);
         }
-        return res;
     }
 };
 
+/**
+ * To jest struktura reprezentująca aktualny stan rozgrywki.
+ *
+ * Zmienia ją tylko wątek obsługujący serwer; GUI dostaje jej
+ * kopie (zob. GuiFrame), współdzielące z nią niezmienione zbiory pól,
+ * a wątek wejścia GUI czyta wyłącznie atomową flagę `is_lobby`
+ * i stałą nazwę gracza.
+ */
+struct ClientState : GameView {
+    explicit ClientState(std::string player_name_opt)
+            : player_name(std::move(player_name_opt)) {}
+
+    /* Czy klient obserwuje lobby. Wątek wejścia GUI na tej podstawie
+     * wysyła JOIN zamiast ruchu; JOIN spóźniony względem GAME_STARTED
+     * serwer po prostu zignoruje. */
+    std::atomic<bool> is_lobby = true;
+    const string player_name{};
+
+    // Czy następna tura musi trafić do GUI jako pełny stan gry
+    // (np. pierwsza tura rozgrywki).
+    bool keyframe_needed = true;
+
+    // Identyfikator gracza tego klienta, rozpoznany po nazwie
+    // w ACCEPTED_PLAYER; używa go tylko wątek obsługi serwera.
+    std::optional<PlayerId> own_id;
+};
 
 #endif //SIK_2_TYPES_H
@@ -1,14 +1,29 @@
 #ifndef SIK_2_UDPSOCKET_H
 #define SIK_2_UDPSOCKET_H
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <ranges>
 #include <string>
 #include <vector>
 
+#include <sys/socket.h>
+
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <boost/format.hpp>
 
 const size_t DATAGRAM_MAX_SIZE = 65507;
 
+/* Nagłówki IPv6 i UDP, które nie mieszczą się w MTU razem z danymi. */
+const size_t IP_UDP_HEADERS_SIZE = 48;
+/* Najmniejsze dopuszczalne MTU dla podziału wiadomości na fragmenty. */
+const size_t MIN_GUI_MTU = 128;
+/* Tyle fragmentów wysyłamy jednym wywołaniem `sendmmsg`. */
+const size_t FRAGMENTS_PER_SYSCALL = 64;
+
 using std::vector;
 using std::map;
 
@@ -24,18 +39,34 @@ concept Writable = requires(T t, UdpSocket &s) {
 /**
  * Reprezentuje gniazdo UDP
  * do komunikacji z interfejsem użytkownika.
+ *
+ * Domyślnie każda wiadomość do GUI jest jednym datagramem, więc
+ * nie może przekroczyć DATAGRAM_MAX_SIZE bajtów. Jeśli podano `mtu`,
+ * to każda wiadomość jest dzielona na fragmenty, z których każdy
+ * mieści się w jednym pakiecie IP:
+ *
+ *   FRAGMENT (u8 = 255), numer wiadomości (u32), numer fragmentu (u16),
+ *   liczba fragmentów (u16), kolejny kawałek bajtów wiadomości.
+ *
+ * GUI składa wiadomość z fragmentów o tym samym numerze, ustawiając
+ * je według numeru fragmentu. Wiadomość jest kompletna, gdy dotrze
+ * wszystkie `liczba fragmentów` fragmentów. Numery wiadomości rosną,
+ * więc fragment nowszej wiadomości unieważnia niekompletne starsze.
  */
 class UdpSocket {
     using udp = boost::asio::ip::udp;
     using resolver = udp::resolver;
 public:
+    static const uint8_t FRAGMENT = UINT8_MAX;
+    static const size_t FRAGMENT_HEADER_SIZE = 9;
+
     udp_buffer input_buffer{};
-    udp_buffer output_buffer{};
 
     UdpSocket(boost::asio::io_context &io_context,
               const std::string &address, const std::string &port,
-              const uint16_t my_port)
-            : socket(io_context, udp::endpoint(udp::v6(), my_port)) {
+              const uint16_t my_port, std::optional<size_t> mtu = std::nullopt)
+            : socket(io_context, udp::endpoint(udp::v6(), my_port)),
+              fragment_size(fragmentSize(mtu)) {
         resolver resolver(io_context);
         endpoint = *resolver.resolve(address, port,
                                      resolver::resolver_base::numeric_service);
@@ -59,21 +90,24 @@ public:
 
     void write(const string &s) {
         write((uint8_t) s.length());
-        for (char c : s) {
-            write((uint8_t) c);
-        }
+        copyToBuffer((const uint8_t *) s.data(), s.length());
     }
 
-    template<Writable T>
-    void writeList(const std::vector<T> &v) {
-        write((uint32_t) v.size());
-        for (const T &t: v) {
+    /**
+     * Zapisuje listę elementów dowolnego kontenera (lub widoku),
+     * bez kopiowania ich do tymczasowego wektora.
+     */
+    template<std::ranges::sized_range R>
+    requires Writable<std::ranges::range_value_t<R>>
+    void writeList(const R &range) {
+        write((uint32_t) std::ranges::size(range));
+        for (const auto &t: range) {
             t.write(*this);
         }
     }
 
     template<Writable K, Writable V>
-    void writeMap(const std::map<K, V> m) {
+    void writeMap(const std::map<K, V> &m) {
         write((uint32_t) m.size());
         for (const auto &[k, v]: m) {
             k.write(*this);
@@ -85,22 +119,34 @@ public:
      * Zeruje rozmiar bufora wyjściowego.
      */
     void clearOutput() {
-        output_size = 0;
+        output_buffer.clear();
+    }
+
+    [[nodiscard]] size_t outputSize() const {
+        return output_buffer.size();
     }
 
     /**
-     * Przesyła przez UDP zawartość bufora `output_buffer`.
+     * Przesyła przez UDP zawartość bufora `output_buffer`,
+     * w razie potrzeby dzieląc ją na fragmenty.
      */
     void send() {
-        if (output_size == 0) {
+        if (output_buffer.empty()) {
             return;
         }
-        if (output_size > DATAGRAM_MAX_SIZE) {
-            throw std::runtime_error("UDP: Message too big!");
+        if (fragment_size) {
+            sendFragments();
+            return;
+        }
+        if (output_buffer.size() > DATAGRAM_MAX_SIZE) {
+            throw std::runtime_error{(boost::format(
+                    "UDP: Message too big (%1% bytes, at most %2% fit in a datagram). "
+                    "Use --gui-mtu to split it into fragments.") % output_buffer.size()
+                                      % DATAGRAM_MAX_SIZE).str()};
         }
 
         boost::system::error_code error;
-        socket.send_to(boost::asio::buffer(output_buffer, output_size),
+        socket.send_to(boost::asio::buffer(output_buffer),
                        endpoint, 0, error);
         if (error) {
             throw std::runtime_error{
@@ -128,16 +174,81 @@ public:
 private:
     udp::socket socket;
     udp::endpoint endpoint;
-    size_t output_size = 0;
+    vector<uint8_t> output_buffer;
+
+    // Rozmiar danych w jednym fragmencie, o ile wiadomości są dzielone.
+    const std::optional<size_t> fragment_size;
+    uint32_t message_number = 0;
+    vector<std::array<uint8_t, FRAGMENT_HEADER_SIZE>> headers;
+    vector<std::array<iovec, 2>> iovecs;
+    vector<mmsghdr> datagrams;
+
+    static std::optional<size_t> fragmentSize(std::optional<size_t> mtu) {
+        if (!mtu) {
+            return std::nullopt;
+        }
+        if (*mtu < MIN_GUI_MTU) {
+            throw std::invalid_argument{"GUI MTU too small."};
+        }
+        return std::min(*mtu, DATAGRAM_MAX_SIZE + IP_UDP_HEADERS_SIZE)
+               - IP_UDP_HEADERS_SIZE - FRAGMENT_HEADER_SIZE;
+    }
 
     /**
      * Kopiuje ciąg bajtów długości `len` wskazywany przez `arr`
      * do bufora `output_buffer`.
      */
     void copyToBuffer(const uint8_t *arr, size_t len) {
-        assert(output_size + len <= output_buffer.size());
-        memcpy(output_buffer.data() + output_size, arr, len);
-        output_size += len;
+        output_buffer.insert(output_buffer.end(), arr, arr + len);
+    }
+
+    /**
+     * Dzieli zawartość `output_buffer` na fragmenty i wysyła je
+     * paczkami przez `sendmmsg`. Dane fragmentów nie są kopiowane:
+     * każdy datagram składa się z nagłówka i wskaźnika na kawałek bufora.
+     */
+    void sendFragments() {
+        size_t count = (output_buffer.size() + *fragment_size - 1) / *fragment_size;
+        if (count > UINT16_MAX) {
+            throw std::runtime_error("UDP: Message too big!");
+        }
+
+        headers.resize(count);
+        iovecs.resize(count);
+        datagrams.resize(count);
+        uint32_t number = htobe32(message_number++);
+        uint16_t total = htobe16((uint16_t) count);
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t index = htobe16((uint16_t) i);
+            headers[i][0] = FRAGMENT;
+            memcpy(headers[i].data() + 1, &number, sizeof(number));
+            memcpy(headers[i].data() + 5, &index, sizeof(index));
+            memcpy(headers[i].data() + 7, &total, sizeof(total));
+
+            size_t beg = i * *fragment_size;
+            size_t len = std::min(*fragment_size, output_buffer.size() - beg);
+            iovecs[i][0] = {headers[i].data(), FRAGMENT_HEADER_SIZE};
+            iovecs[i][1] = {output_buffer.data() + beg, len};
+
+            datagrams[i] = {};
+            datagrams[i].msg_hdr.msg_name = endpoint.data();
+            datagrams[i].msg_hdr.msg_namelen = (socklen_t) endpoint.size();
+            datagrams[i].msg_hdr.msg_iov = iovecs[i].data();
+            datagrams[i].msg_hdr.msg_iovlen = iovecs[i].size();
+        }
+
+        for (size_t sent = 0; sent < count;) {
+            auto batch = (unsigned) std::min(count - sent, FRAGMENTS_PER_SYSCALL);
+            int res = sendmmsg(socket.native_handle(), datagrams.data() + sent, batch, 0);
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error{
+                        "Failed to send message to GUI. Error: " + std::to_string(errno)};
+            }
+            sent += (size_t) res;
+        }
     }
 };
 
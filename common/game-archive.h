@@ -0,0 +1,88 @@
+#ifndef ROBOTS_COMMON_GAME_ARCHIVE_H
+#define ROBOTS_COMMON_GAME_ARCHIVE_H
+
+#include <array>
+#include <cstring>
+#include <string>
+
+#include <endian.h>
+
+#include <boost/format.hpp>
+
+/**
+ * Archiwum rozegranych gier do analizy, zapisywane przez serwer
+ * (`--export`) i czytane przez robots-export-reader.
+ *
+ * Archiwum o ścieżce P to:
+ * - segmenty P.000000.seg, P.000001.seg, ...: wiadomości serwera HELLO,
+ *   GAME_STARTED, TURN i GAME_ENDED w postaci wysyłanej klientom V2,
+ *   dopisywane jedna za drugą, bez żadnych nagłówków,
+ * - indeks P.idx: "RBTX", wersja formatu, a dalej po jednym wpisie
+ *   stałej długości na każdą wiadomość w segmentach.
+ *
+ * Wpis mówi, gdzie leży wiadomość danej gry (i tury), więc czytelnik
+ * znajduje dowolną turę bez dekodowania segmentów. Wpis trafia do indeksu
+ * dopiero po zapisaniu wiadomości, więc indeks przerwanego eksportu
+ * wskazuje tylko kompletne wiadomości.
+ */
+
+const std::array<uint8_t, 4> GAME_ARCHIVE_MAGIC = {'R', 'B', 'T', 'X'};
+const uint8_t GAME_ARCHIVE_VERSION = 1;
+const size_t GAME_ARCHIVE_HEADER_SIZE = GAME_ARCHIVE_MAGIC.size() + 1;
+
+/**
+ * Wpis indeksu archiwum. Liczby w kolejności bajtów sieci:
+ * numer gry (U32), numer tury (U16), rodzaj wiadomości (U8), bajt zerowy,
+ * numer segmentu, przesunięcie i długość wiadomości w segmencie (U32).
+ */
+struct ArchiveEntry {
+    static const size_t SIZE = 20;
+
+    // Gry są numerowane od 0 w kolejności rozpoczęcia.
+    uint32_t game;
+    // Numer tury dla TURN, a dla pozostałych wiadomości 0.
+    uint16_t turn;
+    uint8_t type;
+    uint32_t segment;
+    uint32_t offset;
+    uint32_t length;
+
+    void store(uint8_t *out) const {
+        storeU32(out, game);
+        uint16_t turn_be = htobe16(turn);
+        memcpy(out + 4, &turn_be, sizeof(turn_be));
+        out[6] = type;
+        out[7] = 0;
+        storeU32(out + 8, segment);
+        storeU32(out + 12, offset);
+        storeU32(out + 16, length);
+    }
+
+    static ArchiveEntry load(const uint8_t *in) {
+        uint16_t turn_be;
+        memcpy(&turn_be, in + 4, sizeof(turn_be));
+        return {loadU32(in), be16toh(turn_be), in[6], loadU32(in + 8), loadU32(in + 12), loadU32(in + 16)};
+    }
+
+private:
+    static void storeU32(uint8_t *out, uint32_t val) {
+        val = htobe32(val);
+        memcpy(out, &val, sizeof(val));
+    }
+
+    static uint32_t loadU32(const uint8_t *in) {
+        uint32_t val;
+        memcpy(&val, in, sizeof(val));
+        return be32toh(val);
+    }
+};
+
+inline std::string archiveIndexPath(const std::string &path) {
+    return path + ".idx";
+}
+
+inline std::string archiveSegmentPath(const std::string &path, uint32_t segment) {
+    return (boost::format("%1%.%2$06d.seg") % path % segment).str();
+}
+
+#endif //ROBOTS_COMMON_GAME_ARCHIVE_H
@@ -0,0 +1,67 @@
+#ifndef ROBOTS_COMMON_PROTOCOL_H
+#define ROBOTS_COMMON_PROTOCOL_H
+
+#include "wire.h"
+
+/**
+ * Protokół komunikacji serwera z klientem, wspólny dla obu programów:
+ * rodzaje wiadomości i zdarzeń oraz układ ich pól.
+ */
+
+/* To są rodzaje wiadomości od klientów. */
+enum ClientMessageType : uint8_t {
+    CLIENT_JOIN, CLIENT_PLACE_BOMB, CLIENT_PLACE_BLOCK, CLIENT_MOVE, CLIENT_SELECT_PROTOCOL
+};
+
+/* To są rodzaje wiadomości wysyłanych przez serwer. */
+enum ServerMessage : uint8_t {
+    HELLO, ACCEPTED_PLAYER, GAME_STARTED, TURN, GAME_ENDED,
+    PROTOCOL_SELECTED, COMPRESSED_TURN, SNAPSHOT
+};
+
+/* To są rodzaje zdarzeń w turze. */
+enum EventType : uint8_t {
+    BOMB_PLACED, BOMB_EXPLODED,
+    PLAYER_MOVED, BLOCK_PLACED
+};
+
+/* Klient przyjmuje tury skompresowane algorytmem deflate (zlib). */
+const uint8_t PROTOCOL_FEATURE_DEFLATE = 1;
+
+/**
+ * Układy struktur i wiadomości przesyłanych od serwera do klienta.
+ *
+ * TURN i BOMB_EXPLODED mają kodeki pisane ręcznie: lista zdarzeń jest
+ * listą wariantów, a wybuch ma w V2 inną postać (ramiona krzyża) niż w V1.
+ * Tak samo zapisywana jest lista zdarzeń po polach SNAPSHOT.
+ */
+namespace layout {
+    using PlayerId = wire::Struct<wire::U8>;
+    using Score = wire::Struct<wire::U32>;
+    using BombId = wire::Struct<wire::Id>;
+    using Position = wire::Struct<wire::U16, wire::U16>;
+    // Nazwa i adres gracza.
+    using Player = wire::Struct<wire::String, wire::String>;
+
+    // Nazwa serwera, liczba graczy, rozmiar planszy, długość gry,
+    // promień wybuchu i czas do wybuchu bomby.
+    using Hello = wire::Message<HELLO, wire::String, wire::U8,
+            wire::U16, wire::U16, wire::U16, wire::U16, wire::U16>;
+    using AcceptedPlayer = wire::Message<ACCEPTED_PLAYER, PlayerId, Player>;
+    using GameStarted = wire::Message<GAME_STARTED, wire::Map<PlayerId, Player>>;
+    using GameEnded = wire::Message<GAME_ENDED, wire::Map<PlayerId, Score>>;
+    // Wersja protokołu i dodatki.
+    using ProtocolSelected = wire::Message<PROTOCOL_SELECTED, wire::U8, wire::U8>;
+
+    // Bomba i tura, w której ją podłożono.
+    using PlacedBomb = wire::Struct<BombId, wire::U16>;
+    // Obraz gry dla klienta dołączającego w trakcie gry, tylko w V2: numer tury,
+    // wyniki graczy i tury podłożenia bomb, a po nich lista zdarzeń jak w TURN.
+    using Snapshot = wire::Message<SNAPSHOT, wire::U16, wire::Map<PlayerId, Score>, wire::List<PlacedBomb>>;
+
+    using BombPlaced = wire::Message<BOMB_PLACED, BombId, Position>;
+    using PlayerMoved = wire::Message<PLAYER_MOVED, PlayerId, Position>;
+    using BlockPlaced = wire::Message<BLOCK_PLACED, Position>;
+}
+
+#endif //ROBOTS_COMMON_PROTOCOL_H
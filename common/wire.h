@@ -0,0 +1,661 @@
+#ifndef ROBOTS_COMMON_WIRE_H
+#define ROBOTS_COMMON_WIRE_H
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <endian.h>
+
+/**
+ * Wersje protokołu komunikacji serwera z klientem.
+ */
+enum class ProtocolVersion : uint8_t {
+    // Standardowy protokół: liczby o stałej szerokości.
+    V1 = 1,
+    // Zwięzły protokół: długości list i identyfikatory bomb jako varinty,
+    // a wybuchy opisane ramionami krzyża zamiast listy zniszczonych bloków.
+    V2 = 2
+};
+
+/* Najdłuższy varint liczby 64-bitowej. */
+const size_t MAX_VARINT_SIZE = 10;
+
+/**
+ * Kodek wiadomości protokołu generowany w czasie kompilacji z ich opisów.
+ *
+ * Opis (układ) wiadomości w protocol.h to lista rodzajów jej pól:
+ * - U8, U16, U32: liczby o stałej szerokości w kolejności bajtów sieci,
+ * - String: napis poprzedzony bajtem długości,
+ * - Id: identyfikator, w V1 liczba 32-bitowa, a w V2 varint,
+ * - List<E>, Map<K, V>: długość (w V1 32-bitowa, w V2 varint) i elementy,
+ * - Struct<...>: pola po kolei,
+ * - Message<TAG, ...>: bajt rodzaju wiadomości (lub zdarzenia) i pola.
+ *
+ * Struktury serwera i klienta podają swój układ w `wire_layout`, a w `wire_fields`
+ * wskaźniki na odpowiadające mu pola. Kodek sprawdza w czasie kompilacji, że
+ * typy pól pasują do układu, i dla każdej wersji protokołu osobno łączy kolejne
+ * pola o stałym rozmiarze w jeden blok bajtów zapisywany i czytany jednym
+ * kopiowaniem.
+ *
+ * Bufor zapisu ma write(uint8_t), write(const string &), writeVarint,
+ * writeLength i writeBytes, a bufor odczytu readString, readVarint32,
+ * readLength, readBytes i buffered(); oba podają wersję protokołu.
+ */
+namespace wire {
+    /**
+     * Liczba bajtów varintu `val`.
+     */
+    constexpr size_t varintSize(uint64_t val) {
+        size_t size = 1;
+        while (val >= 0x80) {
+            val >>= 7;
+            ++size;
+        }
+        return size;
+    }
+
+    /**
+     * Liczba bajtów długości listy lub słownika.
+     */
+    constexpr size_t lengthSize(size_t len, ProtocolVersion version) {
+        return version == ProtocolVersion::V2 ? varintSize(len) : sizeof(uint32_t);
+    }
+
+    /* Struktura z opisanym układem. */
+    template<typename T>
+    concept Described = requires {
+        typename T::wire_layout;
+        T::wire_fields;
+    };
+
+    namespace detail {
+        template<typename T>
+        struct IsVector : std::false_type {};
+
+        template<typename T, typename Alloc>
+        struct IsVector<std::vector<T, Alloc>> : std::true_type {};
+
+        template<typename T>
+        struct IsMap : std::false_type {};
+
+        template<typename K, typename V, typename Compare, typename Alloc>
+        struct IsMap<std::map<K, V, Compare, Alloc>> : std::true_type {};
+
+        template<typename B>
+        ProtocolVersion versionOf(const B &buffer) {
+            if constexpr (requires { buffer.version(); }) {
+                return buffer.version();
+            } else {
+                return buffer.protocol();
+            }
+        }
+
+        /* Rozmiar rodzaju `K` w wersji `V` albo 0, jeśli zależy od wartości. */
+        template<typename K, ProtocolVersion V>
+        constexpr size_t fixed_size = K::template fixed_size<V>;
+
+        template<typename K, typename M>
+        constexpr bool matches() {
+            return K::template matches<M>();
+        }
+
+        template<typename K, ProtocolVersion V, typename Sink, typename M>
+        void writeValue(Sink &s, const M &value);
+
+        template<typename K, ProtocolVersion V, typename Source, typename M>
+        void readValue(Source &s, M &value);
+
+        template<typename K, ProtocolVersion V, typename M>
+        size_t sizeOf(const M &value);
+
+        // --- Pola struktur i wiadomości ---
+
+        template<typename L>
+        constexpr size_t field_count = std::tuple_size_v<typename L::fields>;
+
+        template<typename L, size_t I>
+        using field_t = std::tuple_element_t<I, typename L::fields>;
+
+        /**
+         * Pole struktury odpowiadające polu układu o numerze `I`.
+         * Bajt rodzaju wiadomości nie ma swojego pola.
+         */
+        template<typename L, size_t I, typename M>
+        decltype(auto) member(M &value) {
+            return value.*std::get<I - L::first_field>(std::remove_const_t<M>::wire_fields);
+        }
+
+        /* Koniec ciągu pól o stałym rozmiarze zaczynającego się od pola `I`. */
+        template<typename L, ProtocolVersion V, size_t I>
+        constexpr size_t runEnd() {
+            if constexpr (I == field_count<L>) {
+                return I;
+            } else if constexpr (fixed_size<field_t<L, I>, V> == 0) {
+                return I;
+            } else {
+                return runEnd<L, V, I + 1>();
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, size_t End>
+        constexpr size_t runSize() {
+            if constexpr (I == End) {
+                return 0;
+            } else {
+                return fixed_size<field_t<L, I>, V> + runSize<L, V, I + 1, End>();
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, size_t End, typename M>
+        void packFields(uint8_t *out, const M &value) {
+            if constexpr (I < End) {
+                if constexpr (I < L::first_field) {
+                    *out = L::tag;
+                } else {
+                    field_t<L, I>::template pack<V>(out, member<L, I>(value));
+                }
+                packFields<L, V, I + 1, End>(out + fixed_size<field_t<L, I>, V>, value);
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, size_t End, typename M>
+        void unpackFields(const uint8_t *in, M &value) {
+            if constexpr (I < End) {
+                field_t<L, I>::template unpack<V>(in, member<L, I>(value));
+                unpackFields<L, V, I + 1, End>(in + fixed_size<field_t<L, I>, V>, value);
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, typename Sink, typename M>
+        void writeFields(Sink &s, const M &value) {
+            if constexpr (I < field_count<L>) {
+                constexpr size_t end = runEnd<L, V, I>();
+                if constexpr (end > I) {
+                    std::array<uint8_t, runSize<L, V, I, end>()> run;
+                    packFields<L, V, I, end>(run.data(), value);
+                    s.writeBytes(run);
+                    writeFields<L, V, end>(s, value);
+                } else {
+                    field_t<L, I>::template write<V>(s, member<L, I>(value));
+                    writeFields<L, V, I + 1>(s, value);
+                }
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, typename Source, typename M>
+        void readFields(Source &s, M &value) {
+            if constexpr (I < field_count<L>) {
+                constexpr size_t end = runEnd<L, V, I>();
+                if constexpr (end > I) {
+                    std::array<uint8_t, runSize<L, V, I, end>()> run;
+                    s.readBytes(run);
+                    unpackFields<L, V, I, end>(run.data(), value);
+                    readFields<L, V, end>(s, value);
+                } else {
+                    field_t<L, I>::template read<V>(s, member<L, I>(value));
+                    readFields<L, V, I + 1>(s, value);
+                }
+            }
+        }
+
+        template<typename L, ProtocolVersion V, size_t I, typename M>
+        size_t fieldsSize(const M &value) {
+            if constexpr (I == field_count<L>) {
+                return 0;
+            } else if constexpr (I < L::first_field) {
+                return 1 + fieldsSize<L, V, I + 1>(value);
+            } else {
+                return sizeOf<field_t<L, I>, V>(member<L, I>(value)) + fieldsSize<L, V, I + 1>(value);
+            }
+        }
+
+        template<typename L, size_t I, typename M>
+        constexpr bool fieldsMatch() {
+            if constexpr (I == field_count<L>) {
+                return true;
+            } else {
+                using Member = std::remove_cvref_t<decltype(member<L, I>(std::declval<M &>()))>;
+                return matches<field_t<L, I>, Member>() && fieldsMatch<L, I + 1, M>();
+            }
+        }
+
+        /**
+         * Wspólna część Struct i Message: pola od `FIRST` są polami struktury.
+         */
+        template<size_t FIRST, typename... Fields>
+        struct Record {
+            using fields = std::tuple<Fields...>;
+            static constexpr size_t first_field = FIRST;
+
+            template<ProtocolVersion V>
+            static constexpr size_t fixed_size = ((detail::fixed_size<Fields, V> > 0) && ...)
+                                                 ? (0 + ... + detail::fixed_size<Fields, V>) : 0;
+        };
+
+        template<typename L, typename M>
+        constexpr bool recordMatches() {
+            if constexpr (Described<M>) {
+                if constexpr (std::same_as<typename M::wire_layout, L>
+                              && std::tuple_size_v<decltype(M::wire_fields)> == field_count<L> - L::first_field) {
+                    return fieldsMatch<L, L::first_field, M>();
+                } else {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+
+    // --- Rodzaje pól ---
+
+    template<std::unsigned_integral T>
+    struct Int {
+        template<ProtocolVersion>
+        static constexpr size_t fixed_size = sizeof(T);
+
+        template<typename M>
+        static constexpr bool matches() {
+            return (std::is_integral_v<M> || std::is_enum_v<M>) && sizeof(M) == sizeof(T);
+        }
+
+        template<ProtocolVersion, typename M>
+        static void pack(uint8_t *out, const M &value) {
+            T val = toNetwork((T) value);
+            memcpy(out, &val, sizeof(T));
+        }
+
+        template<ProtocolVersion, typename M>
+        static void unpack(const uint8_t *in, M &value) {
+            T val;
+            memcpy(&val, in, sizeof(T));
+            value = (M) fromNetwork(val);
+        }
+
+    private:
+        static T toNetwork(T val) {
+            if constexpr (sizeof(T) == 2) {
+                return htobe16(val);
+            } else if constexpr (sizeof(T) == 4) {
+                return htobe32(val);
+            } else if constexpr (sizeof(T) == 8) {
+                return htobe64(val);
+            } else {
+                return val;
+            }
+        }
+
+        static T fromNetwork(T val) {
+            if constexpr (sizeof(T) == 2) {
+                return be16toh(val);
+            } else if constexpr (sizeof(T) == 4) {
+                return be32toh(val);
+            } else if constexpr (sizeof(T) == 8) {
+                return be64toh(val);
+            } else {
+                return val;
+            }
+        }
+    };
+
+    using U8 = Int<uint8_t>;
+    using U16 = Int<uint16_t>;
+    using U32 = Int<uint32_t>;
+
+    struct String {
+        template<ProtocolVersion>
+        static constexpr size_t fixed_size = 0;
+
+        template<typename M>
+        static constexpr bool matches() {
+            return std::same_as<M, std::string>;
+        }
+
+        template<ProtocolVersion, typename Sink>
+        static void write(Sink &s, const std::string &value) {
+            s.write(value);
+        }
+
+        template<ProtocolVersion, typename Source>
+        static void read(Source &s, std::string &value) {
+            value = s.readString();
+        }
+
+        template<ProtocolVersion>
+        static size_t size(const std::string &value) {
+            return 1 + value.size();
+        }
+    };
+
+    struct Id {
+        template<ProtocolVersion V>
+        static constexpr size_t fixed_size = V == ProtocolVersion::V1 ? sizeof(uint32_t) : 0;
+
+        template<typename M>
+        static constexpr bool matches() {
+            return std::same_as<M, uint32_t>;
+        }
+
+        // W V1 identyfikator jest zwykłą liczbą 32-bitową.
+        template<ProtocolVersion V>
+        static void pack(uint8_t *out, uint32_t value) {
+            U32::pack<V>(out, value);
+        }
+
+        template<ProtocolVersion V>
+        static void unpack(const uint8_t *in, uint32_t &value) {
+            U32::unpack<V>(in, value);
+        }
+
+        template<ProtocolVersion, typename Sink>
+        static void write(Sink &s, uint32_t value) {
+            s.writeVarint(value);
+        }
+
+        template<ProtocolVersion, typename Source>
+        static void read(Source &s, uint32_t &value) {
+            value = s.readVarint32();
+        }
+
+        template<ProtocolVersion>
+        static size_t size(uint32_t value) {
+            return varintSize(value);
+        }
+    };
+
+    template<typename... Fields>
+    struct Struct : detail::Record<0, Fields...> {
+        template<typename M>
+        static constexpr bool matches() {
+            return detail::recordMatches<Struct, M>();
+        }
+
+        template<ProtocolVersion V, typename M>
+        static void pack(uint8_t *out, const M &value) {
+            detail::packFields<Struct, V, 0, sizeof...(Fields)>(out, value);
+        }
+
+        template<ProtocolVersion V, typename M>
+        static void unpack(const uint8_t *in, M &value) {
+            detail::unpackFields<Struct, V, 0, sizeof...(Fields)>(in, value);
+        }
+
+        template<ProtocolVersion V, typename Sink, typename M>
+        static void write(Sink &s, const M &value) {
+            detail::writeFields<Struct, V, 0>(s, value);
+        }
+
+        template<ProtocolVersion V, typename Source, typename M>
+        static void read(Source &s, M &value) {
+            detail::readFields<Struct, V, 0>(s, value);
+        }
+
+        template<ProtocolVersion V, typename M>
+        static size_t size(const M &value) {
+            return detail::fieldsSize<Struct, V, 0>(value);
+        }
+    };
+
+    /**
+     * Wiadomość zaczynająca się bajtem rodzaju `TAG`. Rodzaj czyta ten,
+     * kto rozpoznaje wiadomość, więc odczyt zaczyna się od pierwszego pola.
+     */
+    template<uint8_t TAG, typename... Fields>
+    struct Message : detail::Record<1, U8, Fields...> {
+        static constexpr uint8_t tag = TAG;
+
+        template<typename M>
+        static constexpr bool matches() {
+            return detail::recordMatches<Message, M>();
+        }
+
+        template<ProtocolVersion V, typename M>
+        static void pack(uint8_t *out, const M &value) {
+            detail::packFields<Message, V, 0, 1 + sizeof...(Fields)>(out, value);
+        }
+
+        template<ProtocolVersion V, typename Sink, typename M>
+        static void write(Sink &s, const M &value) {
+            detail::writeFields<Message, V, 0>(s, value);
+        }
+
+        template<ProtocolVersion V, typename Source, typename M>
+        static void read(Source &s, M &value) {
+            detail::readFields<Message, V, 1>(s, value);
+        }
+
+        template<ProtocolVersion V, typename M>
+        static size_t size(const M &value) {
+            return detail::fieldsSize<Message, V, 0>(value);
+        }
+    };
+
+    template<typename Element>
+    struct List {
+        template<ProtocolVersion>
+        static constexpr size_t fixed_size = 0;
+
+        template<typename M>
+        static constexpr bool matches() {
+            if constexpr (detail::IsVector<M>::value) {
+                return detail::matches<Element, typename M::value_type>();
+            } else {
+                return false;
+            }
+        }
+
+        template<ProtocolVersion V, typename Sink, typename M>
+        static void write(Sink &s, const M &value) {
+            s.writeLength(value.size());
+            for (const auto &element: value) {
+                detail::writeValue<Element, V>(s, element);
+            }
+        }
+
+        template<ProtocolVersion V, typename Source, typename M>
+        static void read(Source &s, M &value) {
+            uint32_t len = s.readLength();
+            value.clear();
+            // Długość pochodzi z sieci, więc rezerwuj tylko tyle, ile już odebrano.
+            value.reserve(std::min<size_t>(len, s.buffered()));
+            for (uint32_t i = 0; i < len; ++i) {
+                typename M::value_type element{};
+                detail::readValue<Element, V>(s, element);
+                value.push_back(std::move(element));
+            }
+        }
+
+        template<ProtocolVersion V, typename M>
+        static size_t size(const M &value) {
+            size_t res = lengthSize(value.size(), V);
+            if constexpr (detail::fixed_size<Element, V> > 0) {
+                return res + value.size() * detail::fixed_size<Element, V>;
+            } else {
+                for (const auto &element: value) {
+                    res += detail::sizeOf<Element, V>(element);
+                }
+                return res;
+            }
+        }
+    };
+
+    template<typename Key, typename Value>
+    struct Map {
+        template<ProtocolVersion>
+        static constexpr size_t fixed_size = 0;
+
+        template<typename M>
+        static constexpr bool matches() {
+            if constexpr (detail::IsMap<M>::value) {
+                return detail::matches<Key, typename M::key_type>()
+                       && detail::matches<Value, typename M::mapped_type>();
+            } else {
+                return false;
+            }
+        }
+
+        template<ProtocolVersion V, typename Sink, typename M>
+        static void write(Sink &s, const M &value) {
+            s.writeLength(value.size());
+            for (const auto &[k, v]: value) {
+                detail::writeValue<Key, V>(s, k);
+                detail::writeValue<Value, V>(s, v);
+            }
+        }
+
+        template<ProtocolVersion V, typename Source, typename M>
+        static void read(Source &s, M &value) {
+            uint32_t len = s.readLength();
+            value.clear();
+            for (uint32_t i = 0; i < len; ++i) {
+                typename M::key_type k{};
+                typename M::mapped_type v{};
+                detail::readValue<Key, V>(s, k);
+                detail::readValue<Value, V>(s, v);
+                value.insert_or_assign(std::move(k), std::move(v));
+            }
+        }
+
+        template<ProtocolVersion V, typename M>
+        static size_t size(const M &value) {
+            size_t res = lengthSize(value.size(), V);
+            for (const auto &[k, v]: value) {
+                res += detail::sizeOf<Key, V>(k) + detail::sizeOf<Value, V>(v);
+            }
+            return res;
+        }
+    };
+
+    namespace detail {
+        template<typename K, ProtocolVersion V, typename Sink, typename M>
+        void writeValue(Sink &s, const M &value) {
+            if constexpr (fixed_size<K, V> > 0) {
+                std::array<uint8_t, fixed_size<K, V>> bytes;
+                K::template pack<V>(bytes.data(), value);
+                s.writeBytes(bytes);
+            } else {
+                K::template write<V>(s, value);
+            }
+        }
+
+        template<typename K, ProtocolVersion V, typename Source, typename M>
+        void readValue(Source &s, M &value) {
+            if constexpr (fixed_size<K, V> > 0) {
+                std::array<uint8_t, fixed_size<K, V>> bytes;
+                s.readBytes(bytes);
+                K::template unpack<V>(bytes.data(), value);
+            } else {
+                K::template read<V>(s, value);
+            }
+        }
+
+        template<typename K, ProtocolVersion V, typename M>
+        size_t sizeOf(const M &value) {
+            if constexpr (fixed_size<K, V> > 0) {
+                return fixed_size<K, V>;
+            } else {
+                return K::template size<V>(value);
+            }
+        }
+
+        /* Układ struktury z opisem albo listy lub słownika takich struktur. */
+        template<typename T>
+        struct LayoutOf {
+            using type = typename T::wire_layout;
+        };
+
+        template<typename T, typename Alloc>
+        struct LayoutOf<std::vector<T, Alloc>> {
+            using type = List<typename LayoutOf<T>::type>;
+        };
+
+        template<typename K, typename V, typename Compare, typename Alloc>
+        struct LayoutOf<std::map<K, V, Compare, Alloc>> {
+            using type = Map<typename LayoutOf<K>::type, typename LayoutOf<V>::type>;
+        };
+
+        template<typename T>
+        using layout_t = typename LayoutOf<T>::type;
+
+        /* Największy rozmiar rodzaju `K` w wersji `V` albo 0, jeśli jest nieograniczony. */
+        template<typename K, ProtocolVersion V>
+        constexpr size_t max_size = fixed_size<K, V>;
+
+        template<ProtocolVersion V>
+        constexpr size_t max_size<Id, V> = V == ProtocolVersion::V1 ? sizeof(uint32_t) : varintSize(UINT32_MAX);
+
+        template<typename... Fields, ProtocolVersion V>
+        constexpr size_t max_size<Struct<Fields...>, V> = ((max_size<Fields, V> > 0) && ...)
+                                                          ? (0 + ... + max_size<Fields, V>) : 0;
+
+        template<uint8_t TAG, typename... Fields, ProtocolVersion V>
+        constexpr size_t max_size<Message<TAG, Fields...>, V> = max_size<Struct<Fields...>, V> > 0
+                                                                ? 1 + max_size<Struct<Fields...>, V> : 0;
+
+    }
+
+    /**
+     * Liczba bajtów, które zajmie `value` zapisane w wersji `version`.
+     */
+    template<typename T>
+    size_t size(const T &value, ProtocolVersion version) {
+        using L = detail::layout_t<T>;
+        static_assert(L::template matches<T>(), "Fields do not match the wire layout");
+        return version == ProtocolVersion::V2 ? detail::sizeOf<L, ProtocolVersion::V2>(value)
+                                              : detail::sizeOf<L, ProtocolVersion::V1>(value);
+    }
+
+    /**
+     * Największa liczba bajtów zapisanej struktury typu `T`, o ile
+     * układ nie ma pól zmiennej długości poza identyfikatorami.
+     * W przeciwieństwie do `size` nie wymaga przeglądania wartości.
+     */
+    template<typename T>
+    constexpr size_t maxSize(ProtocolVersion version) {
+        using L = detail::layout_t<T>;
+        static_assert(detail::max_size<L, ProtocolVersion::V1> > 0 && detail::max_size<L, ProtocolVersion::V2> > 0,
+                      "Wire layout has unbounded fields");
+        return version == ProtocolVersion::V2 ? detail::max_size<L, ProtocolVersion::V2>
+                                              : detail::max_size<L, ProtocolVersion::V1>;
+    }
+
+    /**
+     * Zapisuje `value` w wersji protokołu bufora `s`.
+     */
+    template<typename Sink, typename T>
+    void write(Sink &s, const T &value) {
+        using L = detail::layout_t<T>;
+        static_assert(L::template matches<T>(), "Fields do not match the wire layout");
+        if (detail::versionOf(s) == ProtocolVersion::V2) {
+            detail::writeValue<L, ProtocolVersion::V2>(s, value);
+        } else {
+            detail::writeValue<L, ProtocolVersion::V1>(s, value);
+        }
+    }
+
+    /**
+     * Czyta wartość typu `T` w wersji protokołu bufora `s`.
+     * Bajt rodzaju wiadomości musi być już przeczytany.
+     */
+    template<typename T, typename Source>
+    T read(Source &s) {
+        using L = detail::layout_t<T>;
+        static_assert(L::template matches<T>(), "Fields do not match the wire layout");
+        T value{};
+        if (detail::versionOf(s) == ProtocolVersion::V2) {
+            L::template read<ProtocolVersion::V2>(s, value);
+        } else {
+            L::template read<ProtocolVersion::V1>(s, value);
+        }
+        return value;
+    }
+}
+
+#endif //ROBOTS_COMMON_WIRE_H
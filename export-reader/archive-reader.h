@@ -0,0 +1,114 @@
+#ifndef ROBOTS_EXPORT_READER_ARCHIVE_READER_H
+#define ROBOTS_EXPORT_READER_ARCHIVE_READER_H
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../common/game-archive.h"
+#include "../common/protocol.h"
+
+/**
+ * Wpisy indeksu archiwum dotyczące jednej gry.
+ */
+struct ArchivedGame {
+    std::optional<ArchiveEntry> hello;
+    std::optional<ArchiveEntry> started;
+    std::optional<ArchiveEntry> ended;
+    std::map<uint16_t, ArchiveEntry> turns;
+};
+
+/**
+ * Archiwum gier wyeksportowanych przez serwer.
+ *
+ * Czyta tylko indeks, a z segmentów tylko wskazane wiadomości,
+ * więc dostęp do dowolnej tury nie zależy od rozmiaru archiwum.
+ * Archiwum może wciąż być zapisywane: niepełny ostatni wpis
+ * indeksu jest pomijany.
+ */
+class ArchiveReader {
+public:
+    explicit ArchiveReader(std::string path) : path(std::move(path)) {
+        auto index_path = archiveIndexPath(this->path);
+        std::ifstream in(index_path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error{(boost::format("Failed to open game archive index %1%") % index_path).str()};
+        }
+        std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        if (bytes.size() < GAME_ARCHIVE_HEADER_SIZE
+            || !std::equal(GAME_ARCHIVE_MAGIC.begin(), GAME_ARCHIVE_MAGIC.end(), bytes.begin())) {
+            throw std::runtime_error{(boost::format("%1% is not a game archive index") % index_path).str()};
+        }
+        if (bytes[GAME_ARCHIVE_MAGIC.size()] != GAME_ARCHIVE_VERSION) {
+            throw std::runtime_error{(boost::format("Unsupported game archive version %1%")
+                                      % (int) bytes[GAME_ARCHIVE_MAGIC.size()]).str()};
+        }
+        for (size_t pos = GAME_ARCHIVE_HEADER_SIZE; pos + ArchiveEntry::SIZE <= bytes.size();
+             pos += ArchiveEntry::SIZE) {
+            add(ArchiveEntry::load(bytes.data() + pos));
+        }
+    }
+
+    [[nodiscard]] const std::map<uint32_t, ArchivedGame> &games() const {
+        return archived_games;
+    }
+
+    [[nodiscard]] const ArchivedGame &game(uint32_t game) const {
+        auto it = archived_games.find(game);
+        if (it == archived_games.end()) {
+            throw std::invalid_argument{(boost::format("No game %1% in the archive") % game).str()};
+        }
+        return it->second;
+    }
+
+    /**
+     * Czyta z segmentu wiadomość wskazaną przez wpis indeksu.
+     */
+    [[nodiscard]] std::vector<uint8_t> message(const ArchiveEntry &entry) const {
+        auto segment_path = archiveSegmentPath(path, entry.segment);
+        std::ifstream in(segment_path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error{(boost::format("Failed to open game archive segment %1%")
+                                      % segment_path).str()};
+        }
+        std::vector<uint8_t> bytes(entry.length);
+        in.seekg(entry.offset);
+        if (!in.read((char *) bytes.data(), (std::streamsize) bytes.size())) {
+            throw std::runtime_error{(boost::format("Game archive segment %1% is truncated")
+                                      % segment_path).str()};
+        }
+        return bytes;
+    }
+
+private:
+    const std::string path;
+    std::map<uint32_t, ArchivedGame> archived_games;
+
+    void add(const ArchiveEntry &entry) {
+        auto &game = archived_games[entry.game];
+        switch (entry.type) {
+            case HELLO:
+                game.hello = entry;
+                break;
+            case GAME_STARTED:
+                game.started = entry;
+                break;
+            case TURN:
+                game.turns.insert_or_assign(entry.turn, entry);
+                break;
+            case GAME_ENDED:
+                game.ended = entry;
+                break;
+            default:
+                throw std::runtime_error{(boost::format("Unexpected message type %1% in the archive index")
+                                          % (int) entry.type).str()};
+        }
+    }
+};
+
+#endif //ROBOTS_EXPORT_READER_ARCHIVE_READER_H
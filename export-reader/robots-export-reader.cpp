@@ -0,0 +1,195 @@
+/**
+ * Czytnik archiwum gier eksportowanych przez serwer gry Roboty.
+ *
+ * Wypisuje listę gier w archiwum, przebieg wskazanej gry albo zdarzenia
+ * jednej jej tury. Korzysta z indeksu, więc dekoduje tylko potrzebne
+ * wiadomości, a nie całe archiwum.
+ */
+
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../client/tcp-connection.h"
+#include "../client/types.h"
+#include "../client/events.h"
+#include "../client/message-reader.h"
+#include "../client/messages.h"
+#include "archive-reader.h"
+
+using std::string;
+
+using namespace boost::program_options;
+
+namespace {
+    template<class... Ts>
+    struct Overloaded : Ts ... {
+        using Ts::operator()...;
+    };
+
+    /**
+     * Dekoduje wiadomość z archiwum; archiwum zawiera wiadomości V2.
+     */
+    template<typename M>
+    M decode(const std::vector<uint8_t> &bytes, ServerMessage type) {
+        MessageReader c{bytes, ProtocolVersion::V2};
+        if (c.readU8() != type) {
+            throw std::runtime_error("Game archive message has an unexpected type");
+        }
+        if constexpr (std::is_same_v<M, Turn>) {
+            return Turn::read(c);
+        } else {
+            return wire::read<M>(c);
+        }
+    }
+
+    string format(const Position &p) {
+        return (boost::format("(%1%, %2%)") % p.x % p.y).str();
+    }
+
+    void printGames(const ArchiveReader &archive) {
+        for (const auto &[number, game]: archive.games()) {
+            std::cout << boost::format("game %1%: ") % number;
+            if (game.hello) {
+                auto hello = decode<Hello>(archive.message(*game.hello), HELLO);
+                std::cout << boost::format("\"%1%\", %2%x%3%, ") % hello.server_name % hello.size_x % hello.size_y;
+            }
+            if (!game.turns.empty()) {
+                std::cout << boost::format("turns %1%-%2% (%3% archived), ")
+                             % game.turns.begin()->first % game.turns.rbegin()->first % game.turns.size();
+            }
+            std::cout << (game.ended ? "ended" : "unfinished") << "\n";
+        }
+    }
+
+    void printGame(const ArchiveReader &archive, uint32_t number) {
+        const auto &game = archive.game(number);
+        if (game.hello) {
+            auto hello = decode<Hello>(archive.message(*game.hello), HELLO);
+            std::cout << boost::format("server \"%1%\", board %2%x%3%, %4% turns, "
+                                       "explosion radius %5%, bomb timer %6%\n")
+                         % hello.server_name % hello.size_x % hello.size_y % hello.game_length
+                         % hello.explosion_radius % hello.bomb_timer;
+        }
+        if (game.started) {
+            for (const auto &[id, player]: decode<GameStarted>(archive.message(*game.started), GAME_STARTED).players) {
+                std::cout << boost::format("player %1%: %2% (%3%)\n") % (int) id.value % player.name % player.address;
+            }
+        }
+        std::cout << boost::format("%1% turns archived\n") % game.turns.size();
+        if (game.ended) {
+            for (const auto &[id, score]: decode<GameEnded>(archive.message(*game.ended), GAME_ENDED).scores) {
+                std::cout << boost::format("score of player %1%: %2%\n") % (int) id.value % score.value;
+            }
+        }
+    }
+
+    void printEvent(const event_t &event) {
+        std::visit(Overloaded{
+                [](const BombPlaced &e) {
+                    std::cout << boost::format("bomb %1% placed at %2%\n") % e.id.value % format(e.position);
+                },
+                [](const BombExploded &e) {
+                    std::cout << boost::format("bomb %1% exploded") % e.id.value;
+                    if (e.cross) {
+                        std::cout << boost::format(" at %1%, arms %2% %3% %4% %5%") % format(e.cross->center)
+                                     % e.cross->arms[0] % e.cross->arms[1] % e.cross->arms[2] % e.cross->arms[3];
+                    }
+                    for (const auto &id: e.robots_destroyed) {
+                        std::cout << boost::format(", robot %1% destroyed") % (int) id.value;
+                    }
+                    for (const auto &p: e.blocks_destroyed) {
+                        std::cout << boost::format(", block %1% destroyed") % format(p);
+                    }
+                    std::cout << "\n";
+                },
+                [](const PlayerMoved &e) {
+                    std::cout << boost::format("player %1% moved to %2%\n") % (int) e.id.value % format(e.position);
+                },
+                [](const BlockPlaced &e) {
+                    std::cout << boost::format("block placed at %1%\n") % format(e.position);
+                }
+        }, event);
+    }
+
+    const ArchiveEntry &turnEntry(const ArchiveReader &archive, uint32_t number, uint16_t turn) {
+        const auto &turns = archive.game(number).turns;
+        auto it = turns.find(turn);
+        if (it == turns.end()) {
+            throw std::invalid_argument{(boost::format("No turn %1% of game %2% in the archive")
+                                         % turn % number).str()};
+        }
+        return it->second;
+    }
+
+    void printTurn(const ArchiveReader &archive, uint32_t number, uint16_t turn) {
+        auto message = decode<Turn>(archive.message(turnEntry(archive, number, turn)), TURN);
+        std::cout << boost::format("turn %1%: %2% events\n") % message.turn % message.events.size();
+        for (const auto &event: message.events) {
+            printEvent(event);
+        }
+    }
+
+    void usage(const options_description &desc) {
+        std::cout << "Usage: " << program_invocation_name << "\n";
+        std::cout << desc;
+    }
+}
+
+int main(int ac, char *av[]) {
+    options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "Print help information")
+            ("archive,a", value<string>(),
+             "Path of the archive given to the server as --export.")
+            ("game,g", value<uint32_t>(),
+             "Print the parameters, players and scores of this game instead of the list of games.")
+            ("turn,t", value<uint16_t>(),
+             "Print the events of this turn of --game.")
+            ("raw", bool_switch(),
+             "Write the turn of --game and --turn to stdout as the V2 message sent to clients.");
+
+    variables_map vm;
+    try {
+        store(parse_command_line(ac, av, desc), vm);
+        notify(vm);
+
+        if (!vm.count("archive")) {
+            throw std::invalid_argument("Missing option: archive");
+        }
+        if ((vm.count("turn") || vm["raw"].as<bool>()) && !vm.count("game")) {
+            throw std::invalid_argument("Option turn requires option game");
+        }
+        if (vm["raw"].as<bool>() && !vm.count("turn")) {
+            throw std::invalid_argument("Option raw requires option turn");
+        }
+    } catch (std::exception &e) {
+        usage(desc);
+        exit(EXIT_FAILURE);
+    }
+
+    if (vm.count("help")) {
+        usage(desc);
+        exit(EXIT_SUCCESS);
+    }
+
+    try {
+        ArchiveReader archive{vm["archive"].as<string>()};
+        if (!vm.count("game")) {
+            printGames(archive);
+        } else if (!vm.count("turn")) {
+            printGame(archive, vm["game"].as<uint32_t>());
+        } else if (vm["raw"].as<bool>()) {
+            auto bytes = archive.message(turnEntry(archive, vm["game"].as<uint32_t>(), vm["turn"].as<uint16_t>()));
+            std::cout.write((const char *) bytes.data(), (std::streamsize) bytes.size());
+        } else {
+            printTurn(archive, vm["game"].as<uint32_t>(), vm["turn"].as<uint16_t>());
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
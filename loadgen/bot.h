@@ -0,0 +1,336 @@
+#ifndef ROBOTS_LOADGEN_BOT_H
+#define ROBOTS_LOADGEN_BOT_H
+
+#include <chrono>
+#include <compare>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../client/tcp-connection.h"
+#include "../client/types.h"
+#include "../client/events.h"
+#include "../client/message-reader.h"
+#include "../client/messages.h"
+#include "load-stats.h"
+
+/**
+ * Symulowany gracz: łączy się z serwerem, dołącza do każdej gry
+ * i po każdej turze wysyła losowy ruch.
+ *
+ * Cała komunikacja jest asynchroniczna, na wspólnym `io_context`,
+ * więc jeden proces obsługuje tysiące botów na kilku wątkach.
+ * Odebrane bajty są dekodowane tymi samymi strukturami co w kliencie,
+ * przez `MessageReader`.
+ */
+class Bot : public std::enable_shared_from_this<Bot> {
+    using tcp = asio::ip::tcp;
+    using clock = std::chrono::steady_clock;
+
+    template<class... Ts>
+    struct Overloaded : Ts ... {
+        using Ts::operator()...;
+    };
+
+public:
+    Bot(asio::io_context &context, string name, uint32_t seed, LoadStats &stats)
+            : socket(context), strand(asio::make_strand(context)),
+              name(std::move(name)), random(seed), stats(stats) {}
+
+    void start(const tcp::resolver::results_type &endpoints) {
+        asio::async_connect(
+                socket, endpoints,
+                asio::bind_executor(strand, [self = shared_from_this()](
+                        const boost::system::error_code &error, const tcp::endpoint &) {
+                    self->onConnect(error);
+                }));
+    }
+
+private:
+    tcp::socket socket;
+    asio::strand<asio::io_context::executor_type> strand;
+    const string name;
+    std::minstd_rand random;
+    LoadStats &stats;
+
+    std::array<uint8_t, BUFFER_SIZE> read_buffer{};
+    // Odebrane, ale jeszcze nie w pełni zdekodowane bajty.
+    vector<uint8_t> input;
+    // Tura, której zdarzenia nie dotarły jeszcze w całości,
+    // i liczba jej brakujących zdarzeń.
+    std::optional<Turn> partial_turn;
+    uint32_t events_left = 0;
+    // Wysyłane właśnie bajty i bajty czekające na wysłanie.
+    vector<uint8_t> output;
+    vector<uint8_t> queued;
+    bool is_writing = false;
+
+    // Identyfikator bota w bieżącej grze, o ile został przyjęty.
+    std::optional<PlayerId> id;
+    std::optional<Position> position;
+    std::optional<clock::time_point> last_turn;
+    std::optional<clock::duration> last_interval;
+
+    // Ostatni wysłany ruch, którego skutku bot jeszcze nie zobaczył.
+    std::optional<ClientMessageType> pending_input;
+    clock::time_point pending_since;
+
+    void onConnect(const boost::system::error_code &error) {
+        if (error) {
+            ++stats.connect_failures;
+            return;
+        }
+        ++stats.connected;
+        socket.set_option(tcp::no_delay{true});
+        doRead();
+    }
+
+    void close() {
+        if (socket.is_open()) {
+            ++stats.disconnects;
+            boost::system::error_code ignored;
+            socket.close(ignored);
+        }
+    }
+
+    // --- Odbiór wiadomości ---
+
+    void doRead() {
+        socket.async_read_some(
+                asio::buffer(read_buffer),
+                asio::bind_executor(strand, [self = shared_from_this()](
+                        const boost::system::error_code &error, size_t len) {
+                    self->onRead(error, len);
+                }));
+    }
+
+    void onRead(const boost::system::error_code &error, size_t len) {
+        if (error) {
+            close();
+            return;
+        }
+        stats.bytes_received += len;
+
+        try {
+            input.insert(input.end(), read_buffer.begin(), read_buffer.begin() + (long) len);
+            MessageReader c{input};
+            size_t decoded = 0;
+            try {
+                for (;;) {
+                    decodeNext(c);
+                    decoded = c.consumed();
+                }
+            } catch (IncompleteMessage &e) {
+                // Reszta danych dotrze w kolejnych porcjach.
+            }
+            input.erase(input.begin(), input.begin() + (long) decoded);
+        } catch (std::exception &e) {
+            close();
+            return;
+        }
+
+        doRead();
+    }
+
+    /**
+     * Dekoduje kolejną wiadomość, a w trakcie tury kolejne jej zdarzenie,
+     * więc tura odbierana w wielu porcjach nie jest dekodowana od początku
+     * po każdej z nich.
+     */
+    void decodeNext(MessageReader &c) {
+        if (partial_turn) {
+            partial_turn->events.push_back(readEvent(c));
+            --events_left;
+        } else {
+            handleMessage(c);
+        }
+        if (partial_turn && events_left == 0) {
+            auto turn = std::move(*partial_turn);
+            partial_turn.reset();
+            handle(turn);
+        }
+    }
+
+    void handleMessage(MessageReader &c) {
+        uint8_t type = c.readU8();
+        switch (type) {
+            case HELLO:
+                wire::read<Hello>(c);
+                ++stats.messages_received;
+                join();
+                break;
+            case ACCEPTED_PLAYER:
+                handle(wire::read<AcceptedPlayer>(c));
+                break;
+            case GAME_STARTED:
+                handle(wire::read<GameStarted>(c));
+                break;
+            case TURN: {
+                auto turn = c.readU16();
+                events_left = c.readLength();
+                partial_turn = Turn{turn, {}};
+                break;
+            }
+            case GAME_ENDED:
+                wire::read<GameEnded>(c);
+                ++stats.messages_received;
+                id.reset();
+                position.reset();
+                pending_input.reset();
+                join();
+                break;
+            default:
+                throw std::invalid_argument((boost::format(
+                        "Server message - Unrecognised message type: %1%.\n") % (int) type).str());
+        }
+    }
+
+    void handle(const AcceptedPlayer &m) {
+        ++stats.messages_received;
+        if (m.player.name == name) {
+            id = m.id;
+        }
+    }
+
+    void handle(const GameStarted &m) {
+        ++stats.messages_received;
+        if (id && !m.players.contains(*id)) {
+            id.reset();
+        }
+        if (id) {
+            ++stats.games_played;
+        }
+        last_turn.reset();
+        last_interval.reset();
+    }
+
+    void handle(const Turn &m) {
+        ++stats.messages_received;
+        ++stats.turns_received;
+
+        auto now = clock::now();
+        if (last_turn) {
+            auto interval = now - *last_turn;
+            stats.turn_interval_us.record(microseconds(interval));
+            if (last_interval) {
+                auto diff = interval - *last_interval;
+                stats.turn_jitter_us.record(microseconds(diff < diff.zero() ? -diff : diff));
+            }
+            last_interval = interval;
+        }
+        last_turn = now;
+
+        if (!id) {
+            return;
+        }
+        for (const auto &e: m.events) {
+            std::visit(Overloaded{
+                    [&](const PlayerMoved &event) {
+                        if (std::is_eq(event.id <=> *id)) {
+                            position = event.position;
+                            inputTookEffect(CLIENT_MOVE, now);
+                        }
+                    },
+                    [&](const BombPlaced &event) {
+                        if (isOnPosition(event.position)) {
+                            inputTookEffect(CLIENT_PLACE_BOMB, now);
+                        }
+                    },
+                    [&](const BlockPlaced &event) {
+                        if (isOnPosition(event.position)) {
+                            inputTookEffect(CLIENT_PLACE_BLOCK, now);
+                        }
+                    },
+                    [&](const BombExploded &event) {
+                        for (const auto &robot: event.robots_destroyed) {
+                            if (std::is_eq(robot <=> *id)) {
+                                position.reset();
+                            }
+                        }
+                    }
+            }, e);
+        }
+        sendRandomInput();
+    }
+
+    [[nodiscard]] bool isOnPosition(const Position &p) const {
+        return position && std::is_eq(p <=> *position);
+    }
+
+    /**
+     * Zalicza opóźnienie ruchu, jeśli tura zawiera jego skutek.
+     * Ruch bez widocznego skutku (np. w ścianę) jest pomijany.
+     */
+    void inputTookEffect(ClientMessageType kind, clock::time_point now) {
+        if (pending_input == kind) {
+            stats.input_latency_us.record(microseconds(now - pending_since));
+            pending_input.reset();
+        }
+    }
+
+    // --- Wysyłka wiadomości ---
+
+    void join() {
+        queued.push_back(CLIENT_JOIN);
+        queued.push_back((uint8_t) name.size());
+        queued.insert(queued.end(), name.begin(), name.end());
+        doWrite();
+    }
+
+    void sendRandomInput() {
+        // Bot nie nadąża z wysyłką, więc nie dokłada kolejnych ruchów.
+        if (is_writing) {
+            ++stats.inputs_skipped;
+            return;
+        }
+
+        // Cztery kierunki ruchu oraz postawienie bomby lub bloku.
+        auto choice = std::uniform_int_distribution<uint8_t>(0, 5)(random);
+        if (choice < 4) {
+            pending_input = CLIENT_MOVE;
+            queued.push_back(CLIENT_MOVE);
+            queued.push_back(choice);
+        } else if (choice == 4) {
+            pending_input = CLIENT_PLACE_BOMB;
+            queued.push_back(CLIENT_PLACE_BOMB);
+        } else {
+            pending_input = CLIENT_PLACE_BLOCK;
+            queued.push_back(CLIENT_PLACE_BLOCK);
+        }
+        pending_since = clock::now();
+        ++stats.inputs_sent;
+        doWrite();
+    }
+
+    void doWrite() {
+        if (is_writing || queued.empty()) {
+            return;
+        }
+        is_writing = true;
+        std::swap(output, queued);
+        queued.clear();
+        asio::async_write(
+                socket, asio::buffer(output),
+                asio::bind_executor(strand, [self = shared_from_this()](
+                        const boost::system::error_code &error, size_t) {
+                    self->is_writing = false;
+                    if (error) {
+                        self->close();
+                        return;
+                    }
+                    self->doWrite();
+                }));
+    }
+
+    static uint64_t microseconds(clock::duration d) {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+};
+
+#endif //ROBOTS_LOADGEN_BOT_H
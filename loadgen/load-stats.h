@@ -0,0 +1,59 @@
+#ifndef ROBOTS_LOADGEN_LOAD_STATS_H
+#define ROBOTS_LOADGEN_LOAD_STATS_H
+
+#include <atomic>
+#include <ostream>
+
+#include <boost/format.hpp>
+
+#include "../server/stats.h"
+
+/**
+ * Liczniki i histogramy zbierane przez wszystkie boty generatora obciążenia.
+ *
+ * Boty działają na wielu wątkach, więc wszystkie pola są atomowe,
+ * a zapis do nich nie wymaga blokad.
+ */
+struct LoadStats {
+    std::atomic<uint64_t> connected{0};
+    std::atomic<uint64_t> connect_failures{0};
+    std::atomic<uint64_t> disconnects{0};
+
+    std::atomic<uint64_t> messages_received{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> turns_received{0};
+    std::atomic<uint64_t> games_played{0};
+
+    std::atomic<uint64_t> inputs_sent{0};
+    std::atomic<uint64_t> inputs_skipped{0};
+
+    // Odstęp między kolejnymi turami odebranymi przez jednego bota.
+    Histogram turn_interval_us;
+    // Różnica między kolejnymi odstępami (jak w RFC 3550).
+    Histogram turn_jitter_us;
+    // Czas od wysłania ruchu do odebrania tury z jego skutkiem.
+    Histogram input_latency_us;
+
+    /**
+     * Wypisuje podsumowanie pomiaru trwającego `seconds` sekund.
+     */
+    void print(std::ostream &os, double seconds) const {
+        auto rate = [&](uint64_t value) { return (double) value / seconds; };
+
+        os << boost::format("bots: %1% connected, %2% failed to connect, %3% disconnected\n")
+              % connected.load() % connect_failures.load() % disconnects.load();
+        os << boost::format("duration: %1$.1f s\n") % seconds;
+        os << boost::format("received: %1% messages (%2$.0f/s), %3% bytes (%4$.0f/s)\n")
+              % messages_received.load() % rate(messages_received.load())
+              % bytes_received.load() % rate(bytes_received.load());
+        os << boost::format("turns: %1% received (%2$.0f/s), %3% games played\n")
+              % turns_received.load() % rate(turns_received.load()) % games_played.load();
+        os << boost::format("inputs: %1% sent (%2$.0f/s), %3% skipped\n")
+              % inputs_sent.load() % rate(inputs_sent.load()) % inputs_skipped.load();
+        turn_interval_us.print(os, "turn interval us");
+        turn_jitter_us.print(os, "turn jitter us");
+        input_latency_us.print(os, "input latency us");
+    }
+};
+
+#endif //ROBOTS_LOADGEN_LOAD_STATS_H
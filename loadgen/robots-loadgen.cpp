@@ -0,0 +1,171 @@
+/**
+ * Generator obciążenia serwera gry Roboty.
+ *
+ * Otwiera wiele połączeń symulowanych graczy (botów) i po zadanym czasie
+ * wypisuje przepustowość, rozrzut odstępów między turami
+ * oraz opóźnienie od wysłania ruchu do odebrania jego skutku.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <sys/resource.h>
+
+#include <boost/program_options.hpp>
+
+#include "bot.h"
+#include "load-stats.h"
+
+using std::string;
+
+using namespace boost::program_options;
+
+namespace {
+    /**
+     * Rozdziela napis postaci: <nazwa hosta/adres IPv4/adres IPv6>:<port>
+     * na części <nazwa hosta/adres IPv4/adres IPv6> oraz port.
+     */
+    void splitPort(const string &s, string &addr, string &port) {
+        auto i = s.rfind(':');
+        if (i + 1 >= s.length()) {
+            throw std::invalid_argument(s);
+        }
+        addr = s.substr(0, i);
+        port = s.substr(i + 1);
+    }
+
+    uint32_t parsePositive(uint32_t val) {
+        if (val > 0) {
+            return val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    /**
+     * Podnosi limit otwartych plików, żeby każdy bot miał własne gniazdo.
+     */
+    void raiseFileLimit(size_t bots) {
+        rlimit limit{};
+        if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+            return;
+        }
+        // Zapas na deskryptory samego procesu.
+        rlim_t needed = bots + 64;
+        if (limit.rlim_cur < needed) {
+            limit.rlim_cur = std::min(needed, limit.rlim_max);
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+        if (limit.rlim_cur < needed) {
+            std::cerr << "Warning: open file limit " << limit.rlim_cur
+                      << " is too low for " << bots << " bots.\n";
+        }
+    }
+
+    void usage(const options_description &desc) {
+        std::cout << "Usage: " << program_invocation_name << "\n";
+        std::cout << desc;
+    }
+}
+
+struct LoadParams {
+    string server_addr;
+    string server_port;
+    uint32_t bots;
+    uint32_t threads;
+    uint32_t duration;
+    uint32_t seed;
+    string name_prefix;
+};
+
+void run(const LoadParams &params) {
+    asio::io_context context;
+    LoadStats stats;
+
+    asio::ip::tcp::resolver resolver(context);
+    auto endpoints = resolver.resolve(params.server_addr, params.server_port,
+                                      asio::ip::tcp::resolver::numeric_service);
+
+    raiseFileLimit(params.bots);
+    for (uint32_t i = 0; i < params.bots; ++i) {
+        auto name = params.name_prefix + std::to_string(i);
+        auto bot = std::make_shared<Bot>(context, name, params.seed + i, stats);
+        bot->start(endpoints);
+    }
+
+    // Boty trzymają się przy życiu przez własne operacje asynchroniczne,
+    // więc pomiar kończy zatrzymanie `io_context`.
+    auto start = std::chrono::steady_clock::now();
+    asio::steady_timer deadline(context, std::chrono::seconds(params.duration));
+    deadline.async_wait([&](const boost::system::error_code &) {
+        context.stop();
+    });
+
+    size_t threads = params.threads > 0 ? params.threads : std::max(1u, std::thread::hardware_concurrency());
+    vector<std::jthread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([&] { context.run(); });
+    }
+    context.run();
+    workers.clear();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.print(std::cout, elapsed.count());
+}
+
+int main(int ac, char *av[]) {
+    options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "Print help information")
+            ("server-address,s", value<string>(),
+             "<(hostname):(port) or (IPv4):(port) or (IPv6):(port)>")
+            ("bots,b", value<uint32_t>()->default_value(100),
+             "Number of simulated players. A room holds at most players-count of them, "
+             "so thousands of players need a server started with --rooms. In (0, UINT32_MAX].")
+            ("threads,t", value<uint32_t>()->default_value(0),
+             "Number of I/O threads. 0 means one per CPU core.")
+            ("duration,d", value<uint32_t>()->default_value(10),
+             "Length of the measurement in seconds. In (0, UINT32_MAX].")
+            ("seed", value<uint32_t>()->default_value(1),
+             "Seed of the random moves. Bot i uses seed + i.")
+            ("name-prefix", value<string>()->default_value("bot-"),
+             "Bots join as <name-prefix><bot index>.");
+
+    variables_map vm;
+    LoadParams params;
+    try {
+        store(parse_command_line(ac, av, desc), vm);
+        notify(vm);
+
+        if (!vm.count("server-address")) {
+            throw std::invalid_argument("Missing option: server-address");
+        }
+        splitPort(vm["server-address"].as<string>(), params.server_addr, params.server_port);
+        params.bots = parsePositive(vm["bots"].as<uint32_t>());
+        params.threads = vm["threads"].as<uint32_t>();
+        params.duration = parsePositive(vm["duration"].as<uint32_t>());
+        params.seed = vm["seed"].as<uint32_t>();
+        params.name_prefix = vm["name-prefix"].as<string>();
+        if (params.name_prefix.length() + std::to_string(params.bots).length() > UINT8_MAX) {
+            throw std::invalid_argument("Player name too long");
+        }
+    } catch (std::exception &e) {
+        usage(desc);
+        exit(EXIT_FAILURE);
+    }
+
+    if (vm.count("help")) {
+        usage(desc);
+        exit(EXIT_SUCCESS);
+    }
+
+    try {
+        run(params);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
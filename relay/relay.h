@@ -0,0 +1,90 @@
+#ifndef ROBOTS_RELAY_RELAY_H
+#define ROBOTS_RELAY_RELAY_H
+
+#include <memory>
+#include <utility>
+#include <variant>
+
+#include "../server/server.h"
+#include "upstream.h"
+
+/**
+ * Przekaźnik rozgrywki do obserwatorów.
+ *
+ * Odbiera rozgrywkę od serwera źródłowego jako jeden obserwator
+ * i rozsyła ją swoim klientom przez własny `Server`: z historią,
+ * obrazem gry dla dołączających w trakcie gry, resynchronizacją
+ * i kodowaniem każdej wiadomości raz na kodowanie. Klienci V2 dostają
+ * bajty odebrane od serwera źródłowego, więc przekaźnik niczego dla
+ * nich nie koduje, a przekaźnik może być serwerem źródłowym kolejnego.
+ *
+ * Przekaźnik nie przyjmuje graczy: Join od klienta jest ignorowany.
+ */
+class Relay {
+public:
+    /**
+     * Łączy się z serwerem źródłowym i czeka na jego HELLO, z którego
+     * bierze parametry gry. Reszta parametrów pochodzi z `params`.
+     */
+    Relay(std::unique_ptr<Upstream> upstream_connection, ServerParams params)
+            : upstream(std::move(upstream_connection)) {
+        auto hello = upstream->next();
+        if (!std::holds_alternative<Hello>(hello.message())) {
+            throw std::runtime_error("Upstream server did not start with HELLO");
+        }
+        server_hello = std::get<Hello>(hello.message());
+        params.server_name = server_hello.server_name;
+        params.players_count = server_hello.players_count;
+        params.size_x = server_hello.size_x;
+        params.size_y = server_hello.size_y;
+        params.game_length = server_hello.game_length;
+        params.explosion_radius = server_hello.explosion_radius;
+        params.bomb_timer = server_hello.bomb_timer;
+        params.spectators_only = true;
+        server = std::make_shared<Server>(params);
+    }
+
+    [[nodiscard]] const std::shared_ptr<Server> &getServer() const {
+        return server;
+    }
+
+    /**
+     * Przekazuje klientom wiadomości od serwera źródłowego.
+     * Kończy się wyjątkiem, gdy połączenie z nim zostanie zerwane.
+     */
+    [[noreturn]] void run() {
+        for (;;) {
+            auto message = upstream->next();
+            const auto &value = message.message();
+            if (const auto *hello = std::get_if<Hello>(&value)) {
+                if (!sameParams(*hello, server_hello)) {
+                    throw std::runtime_error("Upstream server changed the game parameters");
+                }
+                server->restartHistory();
+            } else if (std::holds_alternative<AcceptedPlayer>(value)) {
+                server->relayAcceptedPlayer(std::make_shared<EncodedMessage>(std::move(message)));
+            } else if (std::holds_alternative<GameStarted>(value)) {
+                server->relayGameStarted(std::make_shared<EncodedMessage>(std::move(message)));
+            } else if (std::holds_alternative<Turn>(value)) {
+                server->closeTurn(std::move(message));
+            } else if (std::holds_alternative<Snapshot>(value)) {
+                server->relaySnapshot(std::move(message));
+            } else if (std::holds_alternative<GameEnded>(value)) {
+                server->endGame(std::move(message));
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<Upstream> upstream;
+    Hello server_hello;
+    std::shared_ptr<Server> server;
+
+    static bool sameParams(const Hello &a, const Hello &b) {
+        return a.server_name == b.server_name && a.players_count == b.players_count
+               && a.size_x == b.size_x && a.size_y == b.size_y && a.game_length == b.game_length
+               && a.explosion_radius == b.explosion_radius && a.bomb_timer == b.bomb_timer;
+    }
+};
+
+#endif //ROBOTS_RELAY_RELAY_H
@@ -0,0 +1,231 @@
+/**
+ * Przekaźnik rozgrywek gry Roboty do obserwatorów.
+ *
+ * Ogląda grę na serwerze źródłowym (serwerze gry albo innym przekaźniku)
+ * jako jeden obserwator i rozsyła ją wszystkim swoim klientom, więc
+ * serwer gry wysyła każdą turę raz na przekaźnik, a nie raz na obserwatora.
+ * Klienci łączą się z przekaźnikiem tak samo jak z serwerem gry.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../server/async-client-acceptor.h"
+#include "../server/lobby.h"
+#include "../server/metrics.h"
+#include "relay.h"
+
+using std::string;
+using std::vector;
+
+using namespace boost::program_options;
+
+namespace {
+    /**
+     * Rozdziela napis postaci: <nazwa hosta/adres IPv4/adres IPv6>:<port>
+     * na części <nazwa hosta/adres IPv4/adres IPv6> oraz port.
+     */
+    void splitPort(const string &s, string &addr, string &port) {
+        auto i = s.rfind(':');
+        if (i + 1 >= s.length()) {
+            throw std::invalid_argument(s);
+        }
+        addr = s.substr(0, i);
+        port = s.substr(i + 1);
+    }
+
+    uint16_t parse(int32_t val) {
+        if (0 <= val && val <= UINT16_MAX) {
+            return (uint16_t) val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    uint16_t parsePositive(int32_t val) {
+        if (0 < val && val <= UINT16_MAX) {
+            return (uint16_t) val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    uint64_t parse(const string &val) {
+        char *endptr = nullptr;
+        errno = 0;
+        uint64_t res = std::strtoull(val.c_str(), &endptr, 10);
+        if (val[0] != '-' && errno == 0 && endptr == val.c_str() + val.length()) {
+            return res;
+        }
+        throw std::invalid_argument{"Program option invalid.\n"};
+    }
+
+    uint64_t parsePositive(const string &val) {
+        uint64_t res = parse(val);
+        if (res > 0) {
+            return res;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    int parseBacklog(int32_t val) {
+        if (0 < val) {
+            return val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    OverflowPolicy parseOverflowPolicy(const string &val) {
+        if (val == "resync") {
+            return OverflowPolicy::RESYNC;
+        } else if (val == "disconnect") {
+            return OverflowPolicy::DISCONNECT;
+        }
+        throw std::invalid_argument{"Program option invalid.\n"};
+    }
+
+    size_t threadsOrCores(uint16_t requested) {
+        if (requested > 0) {
+            return requested;
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void runContext(boost::asio::io_context &context) {
+        try {
+            context.run();
+        } catch (std::exception &e) {
+            std::cerr << "Worker thread failed. Reason:\n";
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    void usage(const options_description &desc) {
+        std::cout << "Usage: " << program_invocation_name << "\n";
+        std::cout << desc;
+    }
+}
+
+int main(int ac, char *av[]) {
+    options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "Print help information")
+            ("server-address,s", value<string>(),
+             "Game server or relay to watch: <(hostname):(port) or (IPv4):(port) or (IPv6):(port)>. "
+             "It must support protocol version 2.")
+            ("port,p", value<int32_t>(),
+             "On this port the relay accepts spectators. In (0, UINT16_MAX].")
+            ("io-threads", value<int32_t>()->default_value(0),
+             "Number of threads serving the spectators. 0 means one per CPU core. In [0, UINT16_MAX].")
+            ("queue-capacity", value<string>()->default_value(std::to_string(DEFAULT_QUEUE_CAPACITY)),
+             "Maximum number of messages waiting to be sent to one spectator. "
+             "Values below 512 are raised to 512.")
+            ("overflow-policy", value<string>()->default_value("resync"),
+             "What to do with a spectator whose message queue is full: "
+             "'resync' drops the backlog and sends the current game state, 'disconnect' drops the spectator.")
+            ("queue-bytes-limit", value<string>()->default_value("0"),
+             "Maximum number of bytes waiting to be sent to one spectator; exceeding it "
+             "is handled like a full queue. 0 means no limit. In [0, UINT64_MAX].")
+            ("metrics-port", value<int32_t>()->default_value(0),
+             "Serve Prometheus metrics over HTTP on this port. 0 disables the endpoint. In [0, UINT16_MAX].")
+            ("listen-backlog", value<int32_t>()->default_value(DEFAULT_LISTEN_BACKLOG),
+             "Length of the queue of connections waiting to be accepted. "
+             "The kernel caps it at net.core.somaxconn. In (0, INT32_MAX].")
+            ("accept-threads", value<int32_t>()->default_value(1),
+             "Number of acceptors, each with its own listening socket "
+             "on the same port (SO_REUSEPORT). In (0, UINT16_MAX].");
+
+    variables_map vm;
+    string upstream_addr;
+    string upstream_port;
+    ServerParams params{};
+    try {
+        store(parse_command_line(ac, av, desc), vm);
+        notify(vm);
+
+        for (const string s: {"server-address", "port"}) {
+            if (!vm.count(s)) {
+                throw std::invalid_argument((boost::format("Missing option: %1%") % s).str());
+            }
+        }
+        splitPort(vm["server-address"].as<string>(), upstream_addr, upstream_port);
+        params.port = parsePositive(vm["port"].as<int32_t>());
+        params.io_threads = parse(vm["io-threads"].as<int32_t>());
+        params.queue_capacity = parsePositive(vm["queue-capacity"].as<string>());
+        params.player_overflow_policy = parseOverflowPolicy(vm["overflow-policy"].as<string>());
+        params.spectator_overflow_policy = params.player_overflow_policy;
+        params.queue_bytes_limit = parse(vm["queue-bytes-limit"].as<string>());
+        params.metrics_port = parse(vm["metrics-port"].as<int32_t>());
+        params.listen_backlog = parseBacklog(vm["listen-backlog"].as<int32_t>());
+        params.accept_threads = parsePositive(vm["accept-threads"].as<int32_t>());
+    } catch (std::exception &e) {
+        usage(desc);
+        exit(EXIT_FAILURE);
+    }
+
+    if (vm.count("help")) {
+        usage(desc);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parametry gry przychodzą w HELLO od serwera źródłowego.
+    boost::asio::io_context upstream_context;
+    std::unique_ptr<Relay> relay;
+    try {
+        relay = std::make_unique<Relay>(
+                std::make_unique<Upstream>(upstream_context, upstream_addr, upstream_port), params);
+    } catch (std::exception &e) {
+        std::cerr << (boost::format("Failed to watch the game at %1%:%2%. Reason:\n")
+                      % upstream_addr % upstream_port) << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (params.metrics_port != 0) {
+        try {
+            auto endpoint = std::make_shared<MetricsEndpoint>(params.metrics_port);
+            std::thread([endpoint] { endpoint->run(); }).detach();
+        } catch (std::exception &e) {
+            std::cerr << "Metrics endpoint failed. Reason:\n";
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Obserwatorów może być wielu, więc są obsługiwani asynchronicznie,
+    // przez kilka wątków wykonujących `io_context::run()`.
+    boost::asio::io_context context;
+    auto lobby = std::make_shared<Lobby>(vector<std::shared_ptr<Server>>{relay->getServer()});
+    vector<std::unique_ptr<AsyncClientAcceptor>> acceptors;
+    ListenParams listen{params.port, params.listen_backlog, params.accept_threads > 1};
+    try {
+        for (uint16_t i = 0; i < params.accept_threads; ++i) {
+            acceptors.push_back(std::make_unique<AsyncClientAcceptor>(listen, lobby, context));
+            acceptors.back()->start();
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Client acceptor failed. Reason:\n";
+        std::cerr << e.what() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    size_t io_threads = threadsOrCores(params.io_threads);
+    boost::asio::thread_pool thread_pool(io_threads);
+    for (size_t i = 0; i < io_threads; ++i) {
+        boost::asio::post(thread_pool, [&] {
+            runContext(context);
+        });
+    }
+
+    // W głównym wątku odbieramy rozgrywkę od serwera źródłowego.
+    try {
+        relay->run();
+    } catch (std::exception &e) {
+        std::cerr << "Connection to the game at " << upstream_addr << ":" << upstream_port
+                  << " lost. Reason:\n" << e.what() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+}
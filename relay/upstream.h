@@ -0,0 +1,285 @@
+#ifndef ROBOTS_RELAY_UPSTREAM_H
+#define ROBOTS_RELAY_UPSTREAM_H
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/format.hpp>
+
+#include "../server/messages.h"
+#include "../server/tcp-connection.h"
+
+/*
+ * Rozmiar bufora odbiorczego połączenia z serwerem źródłowym: tyle może mieć
+ * najdłuższa wiadomość, czyli obraz gry dla obserwatora dołączającego
+ * w trakcie gry, z wszystkimi blokami planszy.
+ */
+const size_t UPSTREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Zgłaszany, gdy w odebranych danych brakuje dalszej części wiadomości.
+ */
+struct IncompleteMessage : std::runtime_error {
+    IncompleteMessage() : std::runtime_error("Incomplete server message") {}
+};
+
+/**
+ * Bufor odczytu kodeka (zob. wire.h) nad odebranymi bajtami wiadomości serwera.
+ * Gdy bajty się skończą, czytanie zgłasza `IncompleteMessage`.
+ */
+class MessageSource {
+public:
+    MessageSource(std::span<const uint8_t> data, ProtocolVersion version)
+            : data(data), protocol_version(version) {}
+
+    [[nodiscard]] ProtocolVersion version() const {
+        return protocol_version;
+    }
+
+    /**
+     * Liczba przeczytanych bajtów.
+     */
+    [[nodiscard]] size_t consumed() const {
+        return pos;
+    }
+
+    [[nodiscard]] size_t buffered() const {
+        return data.size() - pos;
+    }
+
+    uint8_t readU8() {
+        require(1);
+        return data[pos++];
+    }
+
+    uint16_t readU16() {
+        uint16_t res;
+        readBytes({(uint8_t *) &res, sizeof(res)});
+        return be16toh(res);
+    }
+
+    uint64_t readVarint() {
+        uint64_t res = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readU8();
+            res |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return res;
+            }
+        }
+        throw std::invalid_argument("Upstream message - varint too long");
+    }
+
+    uint32_t readVarint32() {
+        uint64_t val = readVarint();
+        if (val > UINT32_MAX) {
+            throw std::invalid_argument("Upstream message - varint out of range");
+        }
+        return (uint32_t) val;
+    }
+
+    uint32_t readLength() {
+        if (protocol_version == ProtocolVersion::V2) {
+            return readVarint32();
+        }
+        uint32_t res;
+        readBytes({(uint8_t *) &res, sizeof(res)});
+        return be32toh(res);
+    }
+
+    void readBytes(std::span<uint8_t> dst) {
+        require(dst.size());
+        memcpy(dst.data(), data.data() + pos, dst.size());
+        pos += dst.size();
+    }
+
+    string readString() {
+        uint8_t len = readU8();
+        require(len);
+        string res((const char *) data.data() + pos, len);
+        pos += len;
+        return res;
+    }
+
+private:
+    const std::span<const uint8_t> data;
+    const ProtocolVersion protocol_version;
+    size_t pos = 0;
+
+    void require(size_t len) const {
+        if (data.size() - pos < len) {
+            throw IncompleteMessage{};
+        }
+    }
+};
+
+/**
+ * Połączenie przekaźnika z serwerem źródłowym: serwerem gry
+ * albo kolejnym przekaźnikiem, który wysyła dokładnie to samo.
+ *
+ * Przekaźnik łączy się jako obserwator i prosi o protokół V2 bez
+ * kompresji. Wiadomości sprzed potwierdzenia protokołu (historia w V1)
+ * są pomijane, bo serwer po potwierdzeniu przysyła całą historię od nowa.
+ * Każda wiadomość jest dekodowana (przekaźnik potrzebuje historii
+ * i obrazu planszy dla nowych obserwatorów), ale jej odebrane bajty
+ * stają się od razu postacią V2 do rozesłania, bez ponownego kodowania.
+ */
+class Upstream {
+    using tcp = asio::ip::tcp;
+public:
+    Upstream(asio::io_context &context, const string &address, const string &port)
+            : connection(connect(context, address, port), UPSTREAM_BUFFER_SIZE) {
+        std::array<uint8_t, 3> request = {CLIENT_SELECT_PROTOCOL, (uint8_t) ProtocolVersion::V2, 0};
+        connection.send(asio::buffer(request));
+    }
+
+    /**
+     * Czeka na kolejną wiadomość od serwera źródłowego w V2.
+     * Rzuca wyjątek, gdy połączenie zostanie zamknięte albo wiadomość jest niepoprawna.
+     */
+    EncodedMessage next() {
+        for (;;) {
+            auto input = connection.buffered();
+            MessageSource source{input, version};
+            std::optional<server_mess_t> message;
+            try {
+                message = read(source);
+            } catch (IncompleteMessage &e) {
+                connection.receiveMore();
+                continue;
+            }
+
+            auto bytes = input.first(source.consumed());
+            connection.consume(bytes.size());
+            if (auto *selected = std::get_if<ProtocolSelected>(&*message)) {
+                if (selected->version != (uint8_t) ProtocolVersion::V2) {
+                    throw std::runtime_error("Upstream server does not support protocol version 2");
+                }
+                version = ProtocolVersion::V2;
+                continue;
+            }
+            if (source.version() != ProtocolVersion::V2) {
+                continue;
+            }
+
+            auto encoded = std::make_shared<OutputBuffer>(ProtocolVersion::V2);
+            encoded->writeBytes(bytes);
+            return {std::move(*message), Encoding::V2, std::move(encoded)};
+        }
+    }
+
+private:
+    TcpConnection connection;
+    ProtocolVersion version = ProtocolVersion::V1;
+
+    static tcp::socket connect(asio::io_context &context, const string &address, const string &port) {
+        tcp::resolver resolver(context);
+        tcp::socket socket(context);
+        asio::connect(socket, resolver.resolve(address, port, tcp::resolver::numeric_service));
+        socket.set_option(tcp::no_delay{true});
+        return socket;
+    }
+
+    static server_mess_t read(MessageSource &s) {
+        uint8_t type = s.readU8();
+        switch (type) {
+            case HELLO:
+                return wire::read<Hello>(s);
+            case ACCEPTED_PLAYER:
+                return wire::read<AcceptedPlayer>(s);
+            case GAME_STARTED:
+                return wire::read<GameStarted>(s);
+            case TURN:
+                return readTurn(s);
+            case GAME_ENDED:
+                return wire::read<GameEnded>(s);
+            case PROTOCOL_SELECTED:
+                return wire::read<ProtocolSelected>(s);
+            case SNAPSHOT: {
+                auto snapshot = wire::read<Snapshot>(s);
+                readEventList(s, snapshot.events);
+                return snapshot;
+            }
+            default:
+                throw std::invalid_argument((boost::format(
+                        "Upstream message - Unrecognised message type: %1%.") % (int) type).str());
+        }
+    }
+
+    static Turn readTurn(MessageSource &s) {
+        Turn turn{s.readU16(), {}};
+        readEventList(s, turn.events);
+        return turn;
+    }
+
+    static void readEventList(MessageSource &s, event_list_t &events) {
+        uint32_t len = s.readLength();
+        // Długość pochodzi z sieci, więc rezerwuj tylko tyle, ile już odebrano.
+        events.reserve(std::min<size_t>(len, s.buffered()));
+        for (uint32_t i = 0; i < len; ++i) {
+            uint8_t type = s.readU8();
+            switch (type) {
+                case BOMB_PLACED:
+                    events.emplace_back(wire::read<BombPlaced>(s));
+                    break;
+                case BOMB_EXPLODED:
+                    events.emplace_back(readBombExploded(s));
+                    break;
+                case PLAYER_MOVED:
+                    events.emplace_back(wire::read<PlayerMoved>(s));
+                    break;
+                case BLOCK_PLACED:
+                    events.emplace_back(wire::read<BlockPlaced>(s));
+                    break;
+                default:
+                    throw std::invalid_argument((boost::format(
+                            "Upstream message - Unrecognised event type: %1%.") % (int) type).str());
+            }
+        }
+    }
+
+    /**
+     * W V2 wybuch to krzyż, a najmłodszy bit długości ramienia mówi,
+     * czy na jego końcu został zniszczony blok (zob. BombExploded::write).
+     * Wybuch z V1 nie ma krzyża, ale takie wiadomości nie są rozsyłane.
+     */
+    static BombExploded readBombExploded(MessageSource &s) {
+        BombExploded event{wire::read<BombId>(s), {}, {}, {}};
+        if (s.version() == ProtocolVersion::V1) {
+            event.robots_destroyed = wire::read<std::pmr::vector<PlayerId>>(s);
+            event.blocks_destroyed = wire::read<std::pmr::vector<Position>>(s);
+            return event;
+        }
+
+        event.explosion.center = wire::read<Position>(s);
+        for (size_t i = 0; i < DIRECTIONS; ++i) {
+            uint64_t arm = s.readVarint();
+            if ((arm >> 1) > UINT16_MAX) {
+                throw std::invalid_argument("Upstream message - explosion arm too long");
+            }
+            event.explosion.arms[i] = (uint16_t) (arm >> 1);
+            if (arm & 1) {
+                event.blocks_destroyed.push_back(event.explosion.armEnd(i));
+            }
+        }
+        // Tak samo jak na serwerze gry (zob. GameManager::calcDestroyedBlocks),
+        // żeby postać V1 była identyczna z wysłaną przez serwer.
+        std::sort(event.blocks_destroyed.begin(), event.blocks_destroyed.end());
+        // Ramiona długości 0 kończą się na środku, więc ten sam blok może się powtórzyć.
+        event.blocks_destroyed.erase(std::unique(event.blocks_destroyed.begin(), event.blocks_destroyed.end(),
+                                                 [](const Position &a, const Position &b) {
+                                                     return a.x == b.x && a.y == b.y;
+                                                 }),
+                                     event.blocks_destroyed.end());
+        event.robots_destroyed = wire::read<std::pmr::vector<PlayerId>>(s);
+        return event;
+    }
+};
+
+#endif //ROBOTS_RELAY_UPSTREAM_H
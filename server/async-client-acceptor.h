@@ -0,0 +1,69 @@
+#ifndef ROBOTS_SERVER_ASYNC_CLIENT_ACCEPTOR_H
+#define ROBOTS_SERVER_ASYNC_CLIENT_ACCEPTOR_H
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include <boost/asio.hpp>
+
+#include "lobby.h"
+#include "listener.h"
+#include "async-client-handler.h"
+
+/**
+ * Asynchronicznie akceptuje nowe połączenia klientów
+ * i dla każdego z nich uruchamia `AsyncClientHandler`.
+ *
+ * Każde połączenie dostaje własny `strand`, więc wystarczy
+ * niewielka liczba wątków wykonujących `io_context::run()`.
+ * Przy `listen.shared` kilka akceptorów nasłuchuje na tym samym porcie.
+ */
+class AsyncClientAcceptor {
+    using tcp = asio::ip::tcp;
+public:
+    AsyncClientAcceptor(const ListenParams &listen,
+                        std::shared_ptr<Lobby> server,
+                        asio::io_context &context,
+                        uint32_t input_rate_limit = 0)
+            : acceptor(openListener(context, listen)),
+              context(context),
+              server(std::move(server)),
+              input_rate_limit(input_rate_limit) {}
+
+    void start() {
+        doAccept();
+    }
+
+private:
+    tcp::acceptor acceptor;
+    asio::io_context &context;
+    std::shared_ptr<Lobby> server;
+    const uint32_t input_rate_limit;
+
+    void doAccept() {
+        acceptor.async_accept(
+                asio::make_strand(context),
+                [this](const boost::system::error_code &error, tcp::socket socket) {
+                    if (!error) {
+                        onAccept(std::move(socket));
+                    }
+                    doAccept();
+                });
+    }
+
+    void onAccept(tcp::socket socket) {
+        auto accepted_at = std::chrono::steady_clock::now();
+        auto client_id = server->acceptClient();
+        try {
+            socket.set_option(tcp::no_delay{true});
+            std::make_shared<AsyncClientHandler>(std::move(socket), server, client_id, input_rate_limit,
+                                                 accepted_at)->start();
+        } catch (std::exception &e) {
+            server->eraseClient(client_id);
+            std::cerr << e.what() << "\n";
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_ASYNC_CLIENT_ACCEPTOR_H
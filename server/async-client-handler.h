@@ -0,0 +1,226 @@
+#ifndef ROBOTS_SERVER_ASYNC_CLIENT_HANDLER_H
+#define ROBOTS_SERVER_ASYNC_CLIENT_HANDLER_H
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <variant>
+
+#include <boost/asio.hpp>
+
+#include "input-batch.h"
+#include "messages.h"
+#include "lobby.h"
+#include "stats.h"
+
+/**
+ * Obsługuje połączenie z klientem w trybie asynchronicznym.
+ *
+ * W odróżnieniu od pary `MessageSender` i `MessageReceiver` nie zajmuje
+ * na stałe żadnego wątku. Odbiór i wysyłka są automatami stanów
+ * sterowanymi przez `io_context`, a wszystkie procedury obsługi
+ * danego połączenia wykonują się sekwencyjnie na jego `strand`.
+ */
+class AsyncClientHandler : public std::enable_shared_from_this<AsyncClientHandler> {
+    using tcp = asio::ip::tcp;
+public:
+    AsyncClientHandler(tcp::socket socket,
+                       std::shared_ptr<Lobby> server_state,
+                       client_id_t client_id,
+                       uint32_t input_rate_limit = 0,
+                       std::chrono::steady_clock::time_point accepted_at = {})
+            : socket(std::move(socket)),
+              strand(this->socket.get_executor()),
+              server_state(std::move(server_state)),
+              id(client_id),
+              inputs(input_rate_limit),
+              accepted_at(accepted_at) {}
+
+    /**
+     * Tworzy kolejkę wiadomości klienta i rozpoczyna obsługę połączenia.
+     */
+    void start() {
+        std::stringstream ss;
+        ss << socket.remote_endpoint();
+        remote_address = ss.str();
+
+        // Każda zmiana kolejki budzi nadawcę na `strand` połączenia.
+        std::weak_ptr<AsyncClientHandler> weak_self = shared_from_this();
+        messages = server_state->createMessageQueue(id, [weak_self] {
+            if (auto self = weak_self.lock()) {
+                asio::post(self->strand, [self] { self->onQueueEvent(); });
+            }
+        });
+
+        asio::post(strand, [self = shared_from_this()] {
+            self->doWrite();
+            self->doRead();
+        });
+    }
+
+private:
+    tcp::socket socket;
+    asio::strand<asio::any_io_executor> strand;
+    std::shared_ptr<Lobby> server_state;
+    std::shared_ptr<server_mess_queue_t> messages;
+    const client_id_t id;
+    string remote_address;
+
+    std::array<uint8_t, BUFFER_SIZE> input_buffer{};
+    // Początek wiadomości, której nie udało się jeszcze w całości odebrać.
+    vector<uint8_t> partial_input;
+    // Ostatni ruch z odebranej porcji danych.
+    InputBatch inputs;
+
+    // Wysyłane właśnie wiadomości i ich bajty.
+    vector<encoded_mess_t> messages_in_flight;
+    vector<asio::const_buffer> buffers_in_flight;
+    std::chrono::steady_clock::time_point write_start;
+    // Chwila przyjęcia połączenia, do pomiaru czasu do wysłania HELLO.
+    std::chrono::steady_clock::time_point accepted_at;
+    bool is_closed = false;
+
+    // --- Odbiór wiadomości ---
+
+    void doRead() {
+        socket.async_read_some(
+                asio::buffer(input_buffer),
+                asio::bind_executor(strand, [self = shared_from_this()](
+                        const boost::system::error_code &error, size_t len) {
+                    self->onRead(error, len);
+                }));
+    }
+
+    void onRead(const boost::system::error_code &error, size_t len) {
+        if (is_closed) {
+            return;
+        }
+        if (error) {
+            shutdown();
+            return;
+        }
+
+        try {
+            partial_input.insert(partial_input.end(), input_buffer.begin(),
+                                 input_buffer.begin() + (long) len);
+            size_t beg = 0;
+            size_t consumed = 0;
+            while (auto m = parseClientMessage(partial_input.data() + beg,
+                                               partial_input.size() - beg, consumed)) {
+                handle(*m);
+                beg += consumed;
+            }
+            partial_input.erase(partial_input.begin(), partial_input.begin() + (long) beg);
+            publishInput();
+        } catch (std::exception &e) {
+            shutdown();
+            return;
+        }
+
+        doRead();
+    }
+
+    void handle(const client_mess_t &message) {
+        std::visit(Overloaded{
+                [&](const Join &m) {
+                    publishInput();
+                    server_state->tryAcceptPlayer(id, m.name, remote_address);
+                },
+                [&](const SelectProtocol &m) {
+                    publishInput();
+                    server_state->selectProtocol(id, m);
+                },
+                [&](const auto &m) {
+                    inputs.add(client_mess_t{m});
+                }
+        }, message);
+    }
+
+    void publishInput() {
+        if (auto message = inputs.take()) {
+            server_state->setLastMessage(id, *message);
+        }
+    }
+
+    // --- Wysyłka wiadomości ---
+
+    void onQueueEvent() {
+        if (!messages->isOpen()) {
+            // Serwer rozłączył klienta, który nie nadążał odbierać wiadomości.
+            shutdown();
+            return;
+        }
+        doWrite();
+    }
+
+    void doWrite() {
+        if (is_closed || !messages_in_flight.empty()) {
+            return;
+        }
+
+        try {
+            while (messages_in_flight.size() < MAX_GATHERED_MESSAGES) {
+                auto m = messages->tryPop();
+                if (!m) {
+                    break;
+                }
+                buffers_in_flight.emplace_back((*m)->data(), (*m)->size());
+                messages_in_flight.push_back(std::move(*m));
+            }
+        } catch (std::exception &e) {
+            shutdown();
+            return;
+        }
+        if (messages_in_flight.empty()) {
+            return;
+        }
+
+        write_start = std::chrono::steady_clock::now();
+        asio::async_write(
+                socket, buffers_in_flight,
+                asio::bind_executor(strand, [self = shared_from_this()](
+                        const boost::system::error_code &error, size_t len) {
+                    self->onWrite(error, len);
+                }));
+    }
+
+    void onWrite(const boost::system::error_code &error, size_t len) {
+        size_t sent = messages_in_flight.size();
+        messages_in_flight.clear();
+        buffers_in_flight.clear();
+        if (error) {
+            shutdown();
+            return;
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - write_start;
+        codec_stats.send_time_ns += (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        latency_stats.send_us.record(
+                (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        codec_stats.sent_messages += sent;
+        codec_stats.sent_bytes += len;
+        if (accepted_at != std::chrono::steady_clock::time_point{}) {
+            recordHelloLatency(std::exchange(accepted_at, {}));
+        }
+        doWrite();
+    }
+
+    /**
+     * Zamyka połączenie i usuwa związane z klientem struktury serwera.
+     */
+    void shutdown() {
+        if (is_closed) {
+            return;
+        }
+        is_closed = true;
+
+        boost::system::error_code ignored;
+        socket.shutdown(tcp::socket::shutdown_both, ignored);
+        socket.close(ignored);
+        messages->close();
+        server_state->eraseClient(id);
+    }
+};
+
+#endif //ROBOTS_SERVER_ASYNC_CLIENT_HANDLER_H
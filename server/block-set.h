@@ -0,0 +1,143 @@
+#ifndef ROBOTS_SERVER_BLOCK_SET_H
+#define ROBOTS_SERVER_BLOCK_SET_H
+
+#include <set>
+#include <variant>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * Gęsta reprezentacja zbioru bloków: mapa bitowa
+ * z jednym bitem na każde pole planszy.
+ * Sprawdzenie, wstawienie i usunięcie bloku to O(1).
+ */
+class DenseBlockSet {
+public:
+    DenseBlockSet(uint16_t size_x, uint16_t size_y)
+            : size_x(size_x), bits(((size_t) size_x * size_y + WORD_BITS - 1) / WORD_BITS) {}
+
+    [[nodiscard]] bool contains(Position pos) const {
+        size_t i = index(pos);
+        return (bits[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    bool insert(Position pos) {
+        size_t i = index(pos);
+        uint64_t mask = (uint64_t) 1 << (i % WORD_BITS);
+        if (bits[i / WORD_BITS] & mask) {
+            return false;
+        }
+        bits[i / WORD_BITS] |= mask;
+        ++count;
+        return true;
+    }
+
+    void erase(Position pos) {
+        size_t i = index(pos);
+        uint64_t mask = (uint64_t) 1 << (i % WORD_BITS);
+        if (bits[i / WORD_BITS] & mask) {
+            bits[i / WORD_BITS] &= ~mask;
+            --count;
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    /**
+     * Liczba bajtów pamięci potrzebna do
+     * reprezentacji planszy danego rozmiaru.
+     */
+    static size_t memoryFor(uint16_t size_x, uint16_t size_y) {
+        return ((size_t) size_x * size_y + WORD_BITS - 1) / WORD_BITS * sizeof(uint64_t);
+    }
+
+private:
+    static const size_t WORD_BITS = 64;
+
+    size_t size_x;
+    std::vector<uint64_t> bits;
+    size_t count = 0;
+
+    [[nodiscard]] size_t index(Position pos) const {
+        return (size_t) pos.y * size_x + pos.x;
+    }
+};
+
+/**
+ * Rzadka reprezentacja zbioru bloków, przeznaczona dla
+ * ogromnych plansz, dla których mapa bitowa nie mieści się w budżecie pamięci.
+ */
+class SparseBlockSet {
+public:
+    [[nodiscard]] bool contains(Position pos) const {
+        return blocks.contains(pos);
+    }
+
+    bool insert(Position pos) {
+        return blocks.insert(pos).second;
+    }
+
+    void erase(Position pos) {
+        blocks.erase(pos);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return blocks.size();
+    }
+
+private:
+    std::set<Position> blocks;
+};
+
+/**
+ * Zbiór pozycji bloków na planszy.
+ *
+ * Jeśli mapa bitowa planszy mieści się w budżecie pamięci
+ * `memory_budget` (w bajtach), to używana jest reprezentacja gęsta,
+ * a wpp. uporządkowany zbiór pozycji.
+ */
+class BlockSet {
+public:
+    BlockSet(uint16_t size_x, uint16_t size_y, uint64_t memory_budget)
+            : blocks(makeBlocks(size_x, size_y, memory_budget)) {}
+
+    [[nodiscard]] bool contains(Position pos) const {
+        return std::visit([&](const auto &b) { return b.contains(pos); }, blocks);
+    }
+
+    /**
+     * Wstawia blok na pozycję `pos`.
+     * Zwraca `false`, jeśli blok już tam stał.
+     */
+    bool insert(Position pos) {
+        return std::visit([&](auto &b) { return b.insert(pos); }, blocks);
+    }
+
+    void erase(Position pos) {
+        std::visit([&](auto &b) { b.erase(pos); }, blocks);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return std::visit([&](const auto &b) { return b.size(); }, blocks);
+    }
+
+    [[nodiscard]] bool isDense() const {
+        return std::holds_alternative<DenseBlockSet>(blocks);
+    }
+
+private:
+    std::variant<DenseBlockSet, SparseBlockSet> blocks;
+
+    static std::variant<DenseBlockSet, SparseBlockSet>
+    makeBlocks(uint16_t size_x, uint16_t size_y, uint64_t memory_budget) {
+        if (DenseBlockSet::memoryFor(size_x, size_y) <= memory_budget) {
+            return DenseBlockSet{size_x, size_y};
+        }
+        return SparseBlockSet{};
+    }
+};
+
+#endif //ROBOTS_SERVER_BLOCK_SET_H
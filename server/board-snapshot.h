@@ -0,0 +1,121 @@
+#ifndef ROBOTS_SERVER_BOARD_SNAPSHOT_H
+#define ROBOTS_SERVER_BOARD_SNAPSHOT_H
+
+#include <map>
+#include <memory_resource>
+#include <set>
+#include <variant>
+
+#include "types.h"
+#include "events.h"
+#include "messages.h"
+
+/**
+ * Zwięzły obraz planszy po ostatniej rozegranej turze.
+ *
+ * Obraz jest aktualizowany zdarzeniami z każdej tury, więc zajmuje
+ * pamięć proporcjonalną do rozmiaru planszy, a nie do długości gry.
+ * Klient, który dołącza w trakcie gry, zamiast wszystkich
+ * dotychczasowych tur dostaje jeden obraz gry (SNAPSHOT, a w V1 zbiorczą turę).
+ *
+ * Węzły słowników pochodzą z puli obrazu, więc po usunięciu
+ * robota, bloku czy bomby są ponownie używane w kolejnych turach.
+ */
+class BoardSnapshot {
+public:
+    void reset() {
+        turn = 0;
+        player_pos.clear();
+        blocks.clear();
+        bombs.clear();
+        scores.clear();
+    }
+
+    /**
+     * Aplikuje zdarzenia z tury `turn_id` w kolejności,
+     * w jakiej zarządca gry je wygenerował.
+     */
+    void apply(uint16_t turn_id, const event_list_t &events) {
+        turn = turn_id;
+        // Robot zniszczony kilkoma bombami w jednej turze liczy się raz, jak u zarządcy gry.
+        std::pmr::set<PlayerId> robots_destroyed{&pool};
+        for (const auto &e: events) {
+            std::visit(Overloaded{
+                    [&](const BombPlaced &event) {
+                        bombs[event.id] = {event.position, turn_id};
+                    },
+                    [&](const BombExploded &event) {
+                        for (const auto &id: event.robots_destroyed) {
+                            player_pos.erase(id);
+                            robots_destroyed.insert(id);
+                        }
+                        for (const auto &pos: event.blocks_destroyed) {
+                            blocks.erase(pos);
+                        }
+                        bombs.erase(event.id);
+                    },
+                    [&](const PlayerMoved &event) {
+                        player_pos[event.id] = event.position;
+                    },
+                    [&](const BlockPlaced &event) {
+                        blocks.insert(event.position);
+                    }
+            }, e);
+        }
+        for (const auto &id: robots_destroyed) {
+            ++scores[id].value;
+        }
+    }
+
+    /**
+     * Zastępuje obraz planszy obrazem gry `snapshot`, np. odebranym
+     * przez przekaźnik od serwera źródłowego.
+     */
+    void restore(const Snapshot &snapshot) {
+        reset();
+        apply(snapshot.turn, snapshot.events);
+        for (const auto &bomb: snapshot.bombs) {
+            if (auto it = bombs.find(bomb.id); it != bombs.end()) {
+                it->second.turn = bomb.turn;
+            }
+        }
+        scores.insert(snapshot.scores.begin(), snapshot.scores.end());
+    }
+
+    /**
+     * Tworzy obraz gry, który odtwarza u nowego klienta roboty,
+     * bloki i bomby z obrazu planszy, a także wyniki graczy i liczniki bomb.
+     */
+    [[nodiscard]] Snapshot toSnapshot() const {
+        Snapshot catch_up{turn, map<PlayerId, Score>(scores.begin(), scores.end()), {}, {}};
+        catch_up.bombs.reserve(bombs.size());
+        catch_up.events.reserve(blocks.size() + bombs.size() + player_pos.size());
+        for (const auto &pos: blocks) {
+            catch_up.events.emplace_back(BlockPlaced{pos});
+        }
+        for (const auto &[id, bomb]: bombs) {
+            catch_up.events.emplace_back(BombPlaced{id, bomb.position});
+            catch_up.bombs.push_back({id, bomb.turn});
+        }
+        for (const auto &[id, pos]: player_pos) {
+            catch_up.events.emplace_back(PlayerMoved{id, pos});
+        }
+        return catch_up;
+    }
+
+private:
+    struct ArmedBomb {
+        Position position;
+        // Tura, w której bombę podłożono.
+        uint16_t turn;
+    };
+
+    uint16_t turn = 0;
+    std::pmr::unsynchronized_pool_resource pool;
+    std::pmr::map<PlayerId, Position> player_pos{&pool};
+    std::pmr::set<Position> blocks{&pool};
+    std::pmr::map<BombId, ArmedBomb> bombs{&pool};
+    std::pmr::map<PlayerId, Score> scores{&pool};
+};
+
+#endif //ROBOTS_SERVER_BOARD_SNAPSHOT_H
@@ -1,6 +1,7 @@
 #ifndef ROBOTS_SERVER_CLIENT_ACCEPTOR_H
 #define ROBOTS_SERVER_CLIENT_ACCEPTOR_H
 
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <string>
@@ -9,9 +10,11 @@
 #include <boost/asio.hpp>
 #include <boost/format.hpp>
 
+#include "connection-pool.h"
+#include "listener.h"
 #include "tcp-connection.h"
 #include "types.h"
-#include "server.h"
+#include "lobby.h"
 #include "client-handler.h"
 
 using std::map;
@@ -21,41 +24,41 @@ using boost::asio::ip::tcp;
 /**
  * Akceptuje nowe połączenia klientów i
  * inicjuje ich obsługę.
+ *
+ * Wątek akceptujący tylko odbiera połączenie z kolejki gniazda
+ * nasłuchującego. Resztą (opcjami gniazda, połączeniem z puli i kolejką
+ * wiadomości) zajmuje się już wątek odbiorcy, więc fala połączeń nie czeka
+ * na siebie nawzajem w kolejce gniazda. Przy `listen.shared` kilka
+ * akceptorów na osobnych wątkach nasłuchuje na tym samym porcie.
  */
 class ClientAcceptor {
+    using clock = std::chrono::steady_clock;
 public:
-    ClientAcceptor(uint16_t port,
-                   std::shared_ptr<Server> server,
+    ClientAcceptor(const ListenParams &listen,
+                   std::shared_ptr<Lobby> server,
                    std::shared_ptr<boost::asio::io_context> context,
-                   std::shared_ptr<boost::asio::thread_pool> thread_pool)
-            : acceptor(*context, tcp::endpoint(tcp::v6(), port)),
+                   std::shared_ptr<boost::asio::thread_pool> thread_pool,
+                   std::shared_ptr<ConnectionPool> connections,
+                   uint32_t input_rate_limit = 0)
+            : acceptor(openListener(*context, listen)),
               context(std::move(context)),
               thread_pool(std::move(thread_pool)),
-              server(std::move(server)) {}
+              connections(std::move(connections)),
+              server(std::move(server)),
+              input_rate_limit(input_rate_limit) {}
 
     [[noreturn]] void run() {
         for (;;) {
             auto socket = tcp::socket(*context);
             acceptor.accept(socket);
-
-            socket.set_option(tcp::no_delay{true});
-            auto tcp = std::make_shared<TcpConnection>(std::move(socket));
-            auto client_id = server->acceptClient();
-            auto message_queue_ptr = server->createMessageQueue(client_id);
-
-            // Wątek do wysyłki wiadomości do klienta.
-            boost::asio::post(*thread_pool, [tcp, message_queue_ptr] {
-                try {
-                    MessageSender{tcp, message_queue_ptr}.run();
-                } catch (std::exception &e) {
-                    std::cerr << e.what() << "\n";
-                }
-            });
+            auto accepted_at = clock::now();
 
             // Wątek do odbioru wiadomości od klienta.
-            boost::asio::post(*thread_pool, [tcp, server = this->server, client_id] {
+            boost::asio::post(*thread_pool, [socket = std::move(socket), accepted_at, server = server,
+                                             thread_pool = thread_pool, connections = connections,
+                                             rate_limit = input_rate_limit]() mutable {
                 try {
-                    MessageReceiver{tcp, server, client_id}.run();
+                    serve(std::move(socket), accepted_at, server, thread_pool, *connections, rate_limit);
                 } catch (std::exception &e) {
                     std::cerr << e.what() << "\n";
                 }
@@ -67,7 +70,38 @@ private:
     tcp::acceptor acceptor;
     std::shared_ptr<boost::asio::io_context> context;
     std::shared_ptr<boost::asio::thread_pool> thread_pool;
-    std::shared_ptr<Server> server;
+    std::shared_ptr<ConnectionPool> connections;
+    std::shared_ptr<Lobby> server;
+    const uint32_t input_rate_limit;
+
+    /**
+     * Przygotowuje obsługę połączenia, uruchamia wątek nadawcy
+     * i sam zostaje odbiorcą wiadomości od klienta.
+     *
+     * Odbiorca zajmuje wątek puli przed nadawcą: to on wykrywa
+     * rozłączenie klienta, więc nadawcy nie mogą zająć wszystkich
+     * wątków, czekając na odbiorców, którzy wątku nie dostaną.
+     */
+    static void serve(tcp::socket socket, clock::time_point accepted_at,
+                      const std::shared_ptr<Lobby> &server,
+                      const std::shared_ptr<boost::asio::thread_pool> &thread_pool,
+                      ConnectionPool &connections, uint32_t input_rate_limit) {
+        socket.set_option(tcp::no_delay{true});
+        auto tcp = connections.acquire(std::move(socket));
+        auto client_id = server->acceptClient();
+        auto message_queue_ptr = server->createMessageQueue(client_id);
+
+        // Wątek do wysyłki wiadomości do klienta.
+        boost::asio::post(*thread_pool, [tcp, message_queue_ptr, accepted_at] {
+            try {
+                MessageSender{tcp, message_queue_ptr, accepted_at}.run();
+            } catch (std::exception &e) {
+                std::cerr << e.what() << "\n";
+            }
+        });
+
+        MessageReceiver{tcp, server, client_id, input_rate_limit}.run();
+    }
 };
 
 
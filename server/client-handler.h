@@ -1,6 +1,7 @@
 #ifndef ROBOTS_SERVER_CLIENT_HANDLER_H
 #define ROBOTS_SERVER_CLIENT_HANDLER_H
 
+#include <chrono>
 #include <optional>
 #include <thread>
 #include <utility>
@@ -8,9 +9,10 @@
 
 #include "types.h"
 #include "events.h"
-#include "blocking-queue.h"
+#include "input-batch.h"
 #include "messages.h"
-#include "server.h"
+#include "lobby.h"
+#include "stats.h"
 
 using std::queue;
 
@@ -18,21 +20,63 @@ using std::queue;
  * To jest nadawca wiadomości do klienta.
  *
  * W nieskończonej pętli wysyła klientowi wszystko,
- * co zostanie mu przekazane poprzez kolejkę blokującą.
+ * co zostanie mu przekazane poprzez kolejkę wiadomości.
+ * Wiadomości, które zebrały się w kolejce, są wysyłane razem, każda
+ * w całości. Jeśli po zebraniu porcji w kolejce zostały kolejne wiadomości,
+ * porcja jest wysyłana z MSG_MORE, więc jądro łączy ją z następną
+ * w pełne segmenty zamiast wysyłać niepełny segment na końcu każdej porcji.
  */
 class MessageSender {
 public:
+    /**
+     * `accepted_at` to chwila przyjęcia połączenia; pierwsza wysyłka
+     * (z HELLO) zapisuje czas od niej w statystykach.
+     */
     MessageSender(std::shared_ptr<TcpConnection> connection,
-                  std::shared_ptr<server_mess_queue_t> init_messages)
+                  std::shared_ptr<server_mess_queue_t> init_messages,
+                  std::chrono::steady_clock::time_point accepted_at = {})
             : tcp(std::move(connection)),
-              messages(std::move(init_messages)) {}
+              messages(std::move(init_messages)),
+              accepted_at(accepted_at) {}
 
     void run() {
         try {
+            vector<encoded_mess_t> batch;
+            vector<asio::const_buffer> buffers;
             for (;;) {
-                auto m = messages->pop();
-                writeServerMessage(*tcp, m);
-                tcp->send();
+                batch.clear();
+                batch.push_back(messages->pop());
+                while (batch.size() < MAX_GATHERED_MESSAGES) {
+                    auto m = messages->tryPop();
+                    if (!m) {
+                        break;
+                    }
+                    batch.push_back(std::move(*m));
+                }
+
+                buffers.clear();
+                size_t bytes = 0;
+                for (const auto &m: batch) {
+                    buffers.emplace_back(m->data(), m->size());
+                    bytes += m->size();
+                }
+                bool backlog = messages->size() > 0;
+                {
+                    ScopedTimer timer{codec_stats.send_time_ns, latency_stats.send_us};
+                    if (backlog) {
+                        tcp->sendMore(buffers);
+                    } else {
+                        tcp->send(buffers);
+                    }
+                }
+                if (backlog) {
+                    ++codec_stats.coalesced_sends;
+                }
+                if (accepted_at != std::chrono::steady_clock::time_point{}) {
+                    recordHelloLatency(std::exchange(accepted_at, {}));
+                }
+                codec_stats.sent_messages += batch.size();
+                codec_stats.sent_bytes += bytes;
             }
         } catch (std::exception &e) {
             tcp->close();
@@ -42,28 +86,33 @@ public:
 
 private:
     std::shared_ptr<TcpConnection> tcp;
-    std::shared_ptr<BlockingQueue<std::shared_ptr<server_mess_t>>> messages;
+    std::shared_ptr<server_mess_queue_t> messages;
+    std::chrono::steady_clock::time_point accepted_at;
 };
 
 /**
  * To jest odbiorca wiadomości od klienta.
  *
- * W nieskończonej pętli odbiera wiadomości i
- * odpowiednio je obsługuje.
+ * W nieskończonej pętli odbiera porcje danych i obsługuje
+ * wszystkie mieszczące się w nich w całości wiadomości.
+ * Ostatni ruch z porcji jest przekazywany serwerowi raz, po całej porcji.
  */
 class MessageReceiver {
 public:
     MessageReceiver(std::shared_ptr<TcpConnection> connection,
-                    std::shared_ptr<Server> server_state,
-                    client_id_t client_id)
+                    std::shared_ptr<Lobby> server_state,
+                    client_id_t client_id,
+                    uint32_t input_rate_limit = 0)
             : connection(std::move(connection)),
               server_state(std::move(server_state)),
-              id(client_id) {}
+              id(client_id),
+              inputs(input_rate_limit) {}
 
     void run() {
         try {
             for (;;) {
-                handleClientMessage();
+                handleBufferedMessages();
+                connection->receiveMore();
             }
         } catch (std::exception &e) {
             connection->close();
@@ -73,47 +122,53 @@ public:
 
 private:
     std::shared_ptr<TcpConnection> connection;
-    std::shared_ptr<Server> server_state;
+    std::shared_ptr<Lobby> server_state;
     const client_id_t id;
+    InputBatch inputs;
 
     void handle(const Join &message) {
+        publishInput();
         server_state->tryAcceptPlayer(id, message.name, connection->getRemoteAddress());
     }
 
     void handle(const PlaceBomb &message) {
-        server_state->setLastMessage(id, client_mess_t{message});
+        inputs.add(client_mess_t{message});
     }
 
     void handle(const PlaceBlock &message) {
-        server_state->setLastMessage(id, client_mess_t{message});
+        inputs.add(client_mess_t{message});
     }
 
     void handle(const Move &message) {
-        server_state->setLastMessage(id, client_mess_t{message});
+        inputs.add(client_mess_t{message});
+    }
+
+    void handle(const SelectProtocol &message) {
+        publishInput();
+        server_state->selectProtocol(id, message);
     }
 
     /*
-     * Odbiera i obsługuje wiadomość od klienta.
-     *
-     * Operacja blokująca.
+     * Obsługuje wiadomości, które w całości są już w buforze połączenia,
+     * i przekazuje serwerowi ostatni ruch spośród nich.
      */
-    void handleClientMessage() {
-        auto t = readClientMessageType(*connection);
-        switch (t) {
-            case CLIENT_JOIN:
-                handle(Join{t, connection->readString()});
-                break;
-            case CLIENT_PLACE_BOMB:
-                handle(PlaceBomb{t});
-                break;
-            case CLIENT_PLACE_BLOCK:
-                handle(PlaceBlock{t});
+    void handleBufferedMessages() {
+        for (;;) {
+            auto input = connection->buffered();
+            size_t consumed = 0;
+            auto message = parseClientMessage(input.data(), input.size(), consumed);
+            if (!message) {
                 break;
-            case CLIENT_MOVE:
-                handle(Move{t, readDirection(*connection)});
-                break;
-            default:
-                throw std::invalid_argument("Client message type not recognised!");
+            }
+            connection->consume(consumed);
+            std::visit([&](const auto &m) { handle(m); }, *message);
+        }
+        publishInput();
+    }
+
+    void publishInput() {
+        if (auto message = inputs.take()) {
+            server_state->setLastMessage(id, *message);
         }
     }
 };
@@ -0,0 +1,73 @@
+#ifndef ROBOTS_SERVER_CONNECTION_POOL_H
+#define ROBOTS_SERVER_CONNECTION_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "stats.h"
+#include "tcp-connection.h"
+
+/* Domyślna liczba połączeń przygotowanych zawczasu w puli. */
+const size_t DEFAULT_CONNECTION_POOL_SIZE = 64;
+
+/**
+ * Pula obiektów połączeń z gotowymi buforami odbiorczymi.
+ *
+ * Połączenia są tworzone przy starcie serwera, a po rozłączeniu klienta
+ * wracają do puli z zamkniętym gniazdem, więc fala połączeń na początku
+ * gry nie przydziela po kilka kilobajtów pamięci na każde. Gdy pula jest
+ * pusta, powstaje nowe połączenie, które po rozłączeniu też trafia do puli,
+ * o ile nie ma w niej już `capacity` połączeń.
+ */
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+    using tcp = asio::ip::tcp;
+public:
+    ConnectionPool(asio::io_context &context, size_t capacity) : capacity(capacity) {
+        idle.reserve(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            idle.push_back(std::make_unique<TcpConnection>(tcp::socket(context)));
+        }
+    }
+
+    /**
+     * Zwraca połączenie z gniazdem `socket`. Połączenie wraca
+     * do puli, gdy zniknie ostatni wskaźnik na nie.
+     */
+    std::shared_ptr<TcpConnection> acquire(tcp::socket socket) {
+        std::unique_ptr<TcpConnection> connection;
+        {
+            std::scoped_lock lock(mutex);
+            if (!idle.empty()) {
+                connection = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if (connection) {
+            connection->reset(std::move(socket));
+            ++connection_stats.pooled;
+        } else {
+            connection = std::make_unique<TcpConnection>(std::move(socket));
+        }
+        return {connection.release(), [pool = shared_from_this()](TcpConnection *c) {
+            pool->release(std::unique_ptr<TcpConnection>(c));
+        }};
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TcpConnection>> idle;
+
+    void release(std::unique_ptr<TcpConnection> connection) {
+        connection->release();
+        std::scoped_lock lock(mutex);
+        if (idle.size() < capacity) {
+            idle.push_back(std::move(connection));
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_CONNECTION_POOL_H
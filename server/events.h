@@ -1,36 +1,99 @@
 #ifndef ROBOTS_SERVER_EVENTS_H
 #define ROBOTS_SERVER_EVENTS_H
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory_resource>
+#include <tuple>
 #include <variant>
 #include "types.h"
 
-enum EventType {
-    BOMB_PLACED, BOMB_EXPLODED,
-    PLAYER_MOVED, BLOCK_PLACED
-};
-
 struct BombPlaced {
     BombId id;
     Position position;
 
-    void write(TcpConnection &c) const {
-        c.write((uint8_t) BOMB_PLACED);
-        id.write(c);
-        position.write(c);
+    using wire_layout = layout::BombPlaced;
+    static constexpr auto wire_fields = std::tuple{&BombPlaced::id, &BombPlaced::position};
+};
+
+/**
+ * Obszar objęty wybuchem bomby: krzyż o środku `center`
+ * i ramionach długości `arms[i]` w kierunku (DX[i], DY[i]).
+ */
+struct Explosion {
+    static constexpr std::array<int, DIRECTIONS> DX = {1, -1, 0, 0};
+    static constexpr std::array<int, DIRECTIONS> DY = {0, 0, 1, -1};
+
+    Position center;
+    std::array<uint16_t, DIRECTIONS> arms;
+
+    [[nodiscard]] Position armEnd(size_t i) const {
+        return Position{(uint16_t) (center.x + DX[i] * arms[i]),
+                        (uint16_t) (center.y + DY[i] * arms[i])};
+    }
+
+    /**
+     * Sprawdza w czasie O(1), czy pole `pos` leży na krzyżu.
+     */
+    [[nodiscard]] bool contains(Position pos) const {
+        if (pos.y == center.y) {
+            return (int) center.x - arms[1] <= (int) pos.x
+                   && (int) pos.x <= (int) center.x + arms[0];
+        }
+        if (pos.x == center.x) {
+            return (int) center.y - arms[3] <= (int) pos.y
+                   && (int) pos.y <= (int) center.y + arms[2];
+        }
+        return false;
     }
 };
 
 struct BombExploded {
     BombId id;
-    vector<PlayerId> robots_destroyed;
-    vector<Position> blocks_destroyed;
+    Explosion explosion;
+    std::pmr::vector<PlayerId> robots_destroyed;
+    std::pmr::vector<Position> blocks_destroyed;
 
-    void write(TcpConnection &c) const {
+    /**
+     * W V2 zamiast listy zniszczonych bloków zapisuje środek krzyża
+     * i długości jego ramion. Najmłodszy bit długości ramienia mówi,
+     * czy na jego końcu został zniszczony blok, więc klient odtwarza
+     * z nich zarówno pola wybuchu, jak i listę bloków.
+     */
+    void write(OutputBuffer &c) const {
         c.write((uint8_t) BOMB_EXPLODED);
-        id.write(c);
-        c.writeList<PlayerId>(robots_destroyed);
-        c.writeList<Position>(blocks_destroyed);
+        wire::write(c, id);
+        if (c.version() == ProtocolVersion::V1) {
+            wire::write(c, robots_destroyed);
+            wire::write(c, blocks_destroyed);
+            return;
+        }
+
+        wire::write(c, explosion.center);
+        for (size_t i = 0; i < DIRECTIONS; ++i) {
+            c.writeVarint((uint64_t) explosion.arms[i] << 1 | endsOnBlock(i));
+        }
+        wire::write(c, robots_destroyed);
+    }
+
+    /**
+     * Górne ograniczenie liczby bajtów zapisanego zdarzenia.
+     */
+    [[nodiscard]] size_t maxSize(ProtocolVersion version) const {
+        size_t res = 1 + wire::maxSize<BombId>(version) + wire::size(robots_destroyed, version);
+        if (version == ProtocolVersion::V1) {
+            return res + wire::size(blocks_destroyed, version);
+        }
+        return res + wire::maxSize<Position>(version) + DIRECTIONS * wire::varintSize((uint64_t) UINT16_MAX << 1 | 1);
+    }
+
+private:
+    [[nodiscard]] bool endsOnBlock(size_t arm) const {
+        Position end = explosion.armEnd(arm);
+        return std::any_of(blocks_destroyed.begin(), blocks_destroyed.end(), [&](const Position &p) {
+            return p.x == end.x && p.y == end.y;
+        });
     }
 };
 
@@ -38,22 +101,20 @@ struct PlayerMoved {
     PlayerId id;
     Position position;
 
-    void write(TcpConnection &c) const {
-        c.write((uint8_t) PLAYER_MOVED);
-        id.write(c);
-        position.write(c);
-    }
+    using wire_layout = layout::PlayerMoved;
+    static constexpr auto wire_fields = std::tuple{&PlayerMoved::id, &PlayerMoved::position};
 };
 
 struct BlockPlaced {
     Position position;
 
-    void write(TcpConnection &c) const {
-        c.write((uint8_t) BLOCK_PLACED);
-        position.write(c);
-    }
+    using wire_layout = layout::BlockPlaced;
+    static constexpr auto wire_fields = std::tuple{&BlockPlaced::position};
 };
 
 using event_t = std::variant<BombPlaced, BombExploded, PlayerMoved, BlockPlaced>;
 
+/* Zdarzenia z jednej tury, zwykle w pamięci areny tury. */
+using event_list_t = std::pmr::vector<event_t>;
+
 #endif //ROBOTS_SERVER_EVENTS_H
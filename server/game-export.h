@@ -0,0 +1,220 @@
+#ifndef ROBOTS_SERVER_GAME_EXPORT_H
+#define ROBOTS_SERVER_GAME_EXPORT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../common/game-archive.h"
+#include "messages.h"
+#include "ring-queue.h"
+#include "stats.h"
+
+/* Domyślny rozmiar segmentu archiwum gier. */
+const uint32_t DEFAULT_EXPORT_SEGMENT_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Eksportuje rozgrywki jednego serwera do archiwum (format w game-archive.h).
+ *
+ * Serwer przekazuje gotowe bajty wiadomości V2, te same, które rozgłasza
+ * klientom, więc eksport niczego nie koduje ponownie. Wątek gry tylko
+ * wstawia wskaźnik na wiadomość do kolejki bez blokad i nigdy nie czeka:
+ * gdy kolejka jest pełna, wiadomość jest pomijana i liczona.
+ *
+ * Osobny wątek kopiuje wiadomości do odwzorowanego w pamięci segmentu,
+ * a gdy kolejny się nie mieści, zamyka segment i otwiera następny.
+ * Wpisy indeksu zapisuje do pliku, gdy kolejka się opróżni.
+ * Błąd zapisu wyłącza eksport, ale nie zatrzymuje serwera.
+ */
+class GameExporter {
+public:
+    GameExporter(string path, uint32_t segment_size)
+            : path(std::move(path)), segment_size(segment_size),
+              index(std::fopen(archiveIndexPath(this->path).c_str(), "wb")) {
+        if (index == nullptr) {
+            throw std::runtime_error{(boost::format("Failed to open game archive index %1%: %2%")
+                                      % archiveIndexPath(this->path) % std::strerror(errno)).str()};
+        }
+        index_buffer.insert(index_buffer.end(), GAME_ARCHIVE_MAGIC.begin(), GAME_ARCHIVE_MAGIC.end());
+        index_buffer.push_back(GAME_ARCHIVE_VERSION);
+        writer = std::jthread([this] { writeLoop(); });
+    }
+
+    GameExporter(const GameExporter &) = delete;
+    GameExporter &operator=(const GameExporter &) = delete;
+
+    ~GameExporter() {
+        // Pusta wiadomość kończy pracę wątku po zapisaniu wszystkich wcześniejszych.
+        while (!queue.tryPush(Exported{})) {
+            std::this_thread::yield();
+        }
+        writer.join();
+        std::fclose(index);
+    }
+
+    /**
+     * Rozpoczyna w archiwum nową grę. Jej parametry są w `hello`.
+     */
+    void exportGameStarted(encoded_mess_t hello, encoded_mess_t game_started) {
+        game = next_game++;
+        push(HELLO, 0, std::move(hello));
+        push(GAME_STARTED, 0, std::move(game_started));
+    }
+
+    void exportTurn(uint16_t turn, encoded_mess_t message) {
+        push(TURN, turn, std::move(message));
+    }
+
+    void exportGameEnded(encoded_mess_t message) {
+        push(GAME_ENDED, 0, std::move(message));
+    }
+
+private:
+    // Tyle wiadomości może czekać na zapis; to kilka gier z domyślną liczbą tur.
+    static const size_t QUEUE_CAPACITY = 16 * 1024;
+
+    struct Exported {
+        uint32_t game = 0;
+        uint16_t turn = 0;
+        ServerMessage type = HELLO;
+        encoded_mess_t bytes;
+    };
+
+    const string path;
+    const uint32_t segment_size;
+    std::FILE *index;
+
+    // Numer bieżącej gry; używa go tylko wątek gry.
+    uint32_t game = 0;
+    uint32_t next_game = 0;
+    RingQueue<Exported> queue{QUEUE_CAPACITY};
+
+    // Stan segmentu i indeksu; używa go tylko wątek zapisujący.
+    uint32_t next_segment = 0;
+    int segment_fd = -1;
+    uint8_t *segment = nullptr;
+    size_t segment_capacity = 0;
+    size_t segment_used = 0;
+    vector<uint8_t> index_buffer;
+    bool failed = false;
+
+    std::jthread writer;
+
+    void push(ServerMessage type, uint16_t turn, encoded_mess_t bytes) {
+        if (!queue.tryPush(Exported{game, turn, type, std::move(bytes)})) {
+            ++export_stats.dropped_messages;
+        }
+    }
+
+    void writeLoop() {
+        for (;;) {
+            auto next = queue.tryPop();
+            if (!next) {
+                flushIndex();
+                next = queue.pop();
+            }
+            if (!next->bytes) {
+                break;
+            }
+            if (failed) {
+                ++export_stats.dropped_messages;
+            } else {
+                write(*next);
+            }
+        }
+        flushIndex();
+        closeSegment();
+    }
+
+    void write(const Exported &message) {
+        size_t size = message.bytes->size();
+        if (segment == nullptr || segment_used + size > segment_capacity) {
+            closeSegment();
+            if (!openSegment(std::max<size_t>(segment_size, size))) {
+                return;
+            }
+        }
+        memcpy(segment + segment_used, message.bytes->data(), size);
+
+        ArchiveEntry entry{message.game, message.turn, message.type,
+                           next_segment - 1, (uint32_t) segment_used, (uint32_t) size};
+        index_buffer.resize(index_buffer.size() + ArchiveEntry::SIZE);
+        entry.store(index_buffer.data() + index_buffer.size() - ArchiveEntry::SIZE);
+        segment_used += size;
+
+        ++export_stats.exported_messages;
+        export_stats.exported_bytes += size;
+    }
+
+    /**
+     * Otwiera kolejny segment o pojemności `capacity` bajtów.
+     * Miejsce na dysku jest rezerwowane z góry, bo zapis do odwzorowania
+     * bez miejsca na dysku skończyłby się sygnałem SIGBUS, a nie błędem.
+     */
+    bool openSegment(size_t capacity) {
+        auto segment_path = archiveSegmentPath(path, next_segment);
+        segment_fd = ::open(segment_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (segment_fd < 0) {
+            return fail(segment_path, errno);
+        }
+        if (int err = posix_fallocate(segment_fd, 0, (off_t) capacity); err != 0) {
+            return fail(segment_path, err);
+        }
+        void *mapping = mmap(nullptr, capacity, PROT_WRITE, MAP_SHARED, segment_fd, 0);
+        if (mapping == MAP_FAILED) {
+            return fail(segment_path, errno);
+        }
+        segment = static_cast<uint8_t *>(mapping);
+        segment_capacity = capacity;
+        segment_used = 0;
+        ++next_segment;
+        ++export_stats.segments;
+        return true;
+    }
+
+    /**
+     * Zamyka segment, obcinając plik do zapisanych wiadomości.
+     */
+    void closeSegment() {
+        if (segment != nullptr) {
+            munmap(segment, segment_capacity);
+            segment = nullptr;
+            if (ftruncate(segment_fd, (off_t) segment_used) != 0) {
+                fail(archiveSegmentPath(path, next_segment - 1), errno);
+            }
+        }
+        if (segment_fd >= 0) {
+            ::close(segment_fd);
+            segment_fd = -1;
+        }
+    }
+
+    void flushIndex() {
+        if (failed || index_buffer.empty()) {
+            return;
+        }
+        if (std::fwrite(index_buffer.data(), 1, index_buffer.size(), index) != index_buffer.size()
+            || std::fflush(index) != 0) {
+            fail(archiveIndexPath(path), errno);
+            return;
+        }
+        index_buffer.clear();
+    }
+
+    bool fail(const string &file, int err) {
+        std::cerr << "Game export to " << file << " failed, export stopped: " << std::strerror(err) << "\n";
+        failed = true;
+        index_buffer.clear();
+        return false;
+    }
+};
+
+#endif //ROBOTS_SERVER_GAME_EXPORT_H
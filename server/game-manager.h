@@ -1,6 +1,7 @@
 #ifndef ROBOTS_SERVER_GAME_MANAGER_H
 #define ROBOTS_SERVER_GAME_MANAGER_H
 
+#include <algorithm>
 #include <set>
 #include <random>
 #include <utility>
@@ -9,7 +10,14 @@
 #include <optional>
 
 #include "types.h"
+#include "block-set.h"
+#include "replay-log.h"
+#include "robot-index.h"
 #include "server.h"
+#include "stats.h"
+#include "tick-pool.h"
+#include "turn-arena.h"
+#include "turn-scheduler.h"
 
 using std::set;
 
@@ -20,52 +28,189 @@ using std::set;
  * decyduje, czy ruchy są poprawne, liczy eksplozje bomb itp.
  */
 class GameManager {
+    // Mikrobenchmarki (bench/) wywołują bezpośrednio kroki tury.
+    friend class GameLogicBench;
+
+    /**
+     * Stan rozgrywki. Węzły słowników pochodzą z puli stanu,
+     * więc bomby i roboty usuwane w jednej turze zwalniają
+     * miejsce dla tych tworzonych w kolejnych.
+     *
+     * Pozycje robotów są też w indeksie wierszy i kolumn,
+     * więc zmienia się je tylko przez `placeRobot` i `removeRobot`.
+     */
     struct GameState {
-        map<BombId, Bomb> bombs;
-        set<Position> blocks;
-        map<PlayerId, Position> player_pos;
-        map<PlayerId, Score> scores;
+        explicit GameState(const ServerParams &params)
+                : blocks(params.size_x, params.size_y, params.board_memory_budget),
+                  robots(params.size_x, params.size_y) {}
+
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::map<BombId, Bomb> bombs{&pool};
+        BlockSet blocks;
+        std::pmr::map<PlayerId, Position> player_pos{&pool};
+        RobotIndex robots;
+        std::pmr::map<PlayerId, Score> scores{&pool};
         BombId next_bomb_id = {0};
+
+        void placeRobot(PlayerId id, Position pos) {
+            player_pos[id] = pos;
+            robots.place(id, pos);
+        }
+
+        void removeRobot(PlayerId id) {
+            player_pos.erase(id);
+            robots.erase(id);
+        }
     };
 
 public:
-    GameManager(ServerParams params, std::shared_ptr<Server> server)
+    /**
+     * `tick_pool` to wątki liczące wybuchy, np. wspólne dla wszystkich pokoi.
+     * Bez niej zarządca tworzy własne, według `params.tick_threads`.
+     */
+    GameManager(ServerParams params, std::shared_ptr<Server> server,
+                std::shared_ptr<ReplayRecorder> recorder = nullptr,
+                std::shared_ptr<TickPool> tick_pool = nullptr)
             : params(std::move(params)),
               server(std::move(server)),
-              random(params.seed) {}
+              recorder(std::move(recorder)),
+              random(this->params.seed),
+              tick(tick_pool ? std::move(tick_pool) : std::make_shared<TickPool>(this->params.tick_threads)),
+              tick_arenas(tick->threads()) {}
 
+    /**
+     * Rozgrywa kolejne gry na wątku wołającym,
+     * czekając między turami na termin kolejnej tury.
+     */
     [[noreturn]] void run() {
         for (;;) {
-            GameState state;
+            auto game_players = server->waitForPlayersToStartGame();
+            TurnScheduler scheduler{params.turn_duration, params.overrun_policy};
+            scheduler.start();
+
+            startGame(std::move(game_players));
+            do {
+                scheduler.waitForNextTurn();
+            } while (playNextTurn());
+        }
+    }
 
-            auto players = server->waitForPlayersToStartGame();
-            auto initial_events = initializeGame(players, state);
+    /**
+     * Rozpoczyna rozgrywkę z danymi graczami
+     * i rozgłasza początkową turę.
+     */
+    void startGame(map<PlayerId, Player> game_players) {
+        players = std::move(game_players);
+        if (recorder) {
+            recorder->recordGameStarted(players);
+        }
+        state.emplace(params);
+        turn = 0;
 
-            server->closeTurn(0, std::move(initial_events));
+        arena.reset();
 
-            for (uint16_t turn = 1; turn <= params.game_length; ++turn) {
-                vector<event_t> events;
+        server->closeTurn(0, initializeGame(players, *state));
+    }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(params.turn_duration));
-                auto client_messages = server->collectLastMessagesFromClients();
+    /**
+     * Rozgrywa kolejną turę, a po ostatniej turze kończy grę.
+     * Zwraca `true`, jeśli rozgrywka trwa dalej.
+     *
+     * Dane tymczasowe tury pochodzą z areny, odzyskiwanej
+     * na początku następnej tury.
+     */
+    bool playNextTurn() {
+        return playNextTurn([&](std::pmr::memory_resource *resource) {
+            return server->collectLastMessagesFromClients(resource);
+        });
+    }
 
-                updateBombs(state, events);
-                interpretAllClientMessages(client_messages, state, events);
-                placeMissingRobots(players, state, events);
+    /**
+     * Rozgrywa kolejną turę z ruchami graczy zwróconymi przez `collect`
+     * (np. odczytanymi z zapisu rozgrywki) zamiast ruchów od klientów.
+     * `collect` dostaje zasób pamięci, z którego ma przydzielić słownik ruchów.
+     */
+    template<typename Collect>
+    bool playNextTurn(Collect collect) {
+        resetArenas();
+        event_list_t events{arena.resource()};
+        ++turn;
+
+        std::pmr::map<PlayerId, client_mess_t> client_messages = collect(arena.resource());
+        if (recorder) {
+            recorder->recordTurn(client_messages);
+        }
 
-                server->closeTurn(turn, std::move(events));
-            }
-            server->endGame(state.scores);
+        {
+            ScopedTimer timer{latency_stats.turn_compute_us};
+            updateBombs(*state, events);
+            interpretAllClientMessages(client_messages, *state, events);
+            placeMissingRobots(players, *state, events);
         }
+
+        server->closeTurn(turn, std::move(events));
+        if (turn < params.game_length) {
+            return true;
+        }
+        endGame();
+        return false;
+    }
+
+    /**
+     * Wyniki ostatniej zakończonej gry.
+     */
+    [[nodiscard]] const map<PlayerId, Score> &lastScores() const {
+        return last_scores;
     }
 
 private:
+    // Mniej wybuchów w turze liczy sam wątek gry, bo budzenie puli kosztuje więcej.
+    static const size_t PARALLEL_EXPLOSIONS_MIN = 32;
+
     ServerParams params;
     std::shared_ptr<Server> server;
+    std::shared_ptr<ReplayRecorder> recorder;
     std::minstd_rand random;
 
-    vector<event_t> initializeGame(const map<PlayerId, Player> &players, GameState &state) {
-        vector<event_t> initial_events{};
+    // Stan trwającej rozgrywki.
+    std::optional<GameState> state;
+    map<PlayerId, Player> players;
+    uint16_t turn = 0;
+    TurnArena arena;
+    map<PlayerId, Score> last_scores;
+    // Wątki liczące równolegle wybuchy bomb w turze.
+    std::shared_ptr<TickPool> tick;
+    // Areny tury wątków `tick`, po jednej na numer wątku.
+    std::vector<TurnArena> tick_arenas;
+
+    void resetArenas() {
+        arena.reset();
+        for (auto &tick_arena: tick_arenas) {
+            tick_arena.reset();
+        }
+    }
+
+    void endGame() {
+        last_scores = map<PlayerId, Score>(state->scores.begin(), state->scores.end());
+        if (recorder) {
+            recorder->recordGameEnded(last_scores);
+        }
+        server->endGame(last_scores);
+        state.reset();
+
+        if (params.print_stats) {
+            codec_stats.print(std::cerr);
+            turn_stats.print(std::cerr);
+            queue_stats.print(std::cerr);
+            latency_stats.print(std::cerr);
+            connection_stats.print(std::cerr);
+            input_stats.print(std::cerr);
+            export_stats.print(std::cerr);
+        }
+    }
+
+    event_list_t initializeGame(const map<PlayerId, Player> &players, GameState &state) {
+        event_list_t initial_events{arena.resource()};
 
         resetScores(players, state);
         placeMissingRobots(players, state, initial_events);
@@ -87,14 +232,15 @@ private:
      */
     void placeMissingRobots(const map<PlayerId, Player> &players,
                             GameState &state,
-                            vector<event_t> &events) {
+                            event_list_t &events) {
         for (const auto &[player_id, player]: players) {
             if (!state.player_pos.contains(player_id)) {
-                state.player_pos[player_id] = Position{
+                auto pos = Position{
                         .x = (uint16_t) (random() % params.size_x),
                         .y = (uint16_t) (random() % params.size_y)
                 };
-                events.emplace_back(PlayerMoved{player_id, state.player_pos[player_id]});
+                state.placeRobot(player_id, pos);
+                events.emplace_back(PlayerMoved{player_id, pos});
             }
         }
     }
@@ -104,15 +250,14 @@ private:
      * dokładnie `params.initial_blocks`
      * bloków na planszy.
      */
-    void placeInitialBlocks(GameState &state, vector<event_t> &events) {
+    void placeInitialBlocks(GameState &state, event_list_t &events) {
         for (uint16_t i = 0; i < params.initial_blocks; ++i) {
             auto new_block_pos = Position{
                     .x = (uint16_t) (random() % params.size_x),
                     .y = (uint16_t) (random() % params.size_y)
             };
 
-            if (!state.blocks.contains(new_block_pos)) {
-                state.blocks.insert(new_block_pos);
+            if (state.blocks.insert(new_block_pos)) {
                 events.emplace_back(BlockPlaced{new_block_pos});
             }
         }
@@ -124,8 +269,8 @@ private:
      *
      * Zwraca listę wydarzeń utworzonych na podstawie odebranych wiadomości.
      */
-    void interpretAllClientMessages(map<PlayerId, client_mess_t> &messages, GameState &state,
-                      vector<event_t> &events) {
+    void interpretAllClientMessages(std::pmr::map<PlayerId, client_mess_t> &messages, GameState &state,
+                      event_list_t &events) {
         for (auto &[player_id, message]: messages) {
             if (state.player_pos.contains(player_id)) {
                 // Robot gracza nie został
@@ -134,6 +279,9 @@ private:
                         [&](const PlayerId &, const Join &) {
                             /* Ignoruj. */
                         },
+                        [&](const PlayerId &, const SelectProtocol &) {
+                            /* Ignoruj. */
+                        },
                         [&](const PlayerId &p_id, const PlaceBomb &m) {
                             interpret(p_id, m, state, events);
                         },
@@ -149,12 +297,12 @@ private:
     }
 
     void interpret(PlayerId p_id, const PlaceBomb &, GameState &state,
-                   vector<event_t> &events) {
+                   event_list_t &events) {
         placeBomb(state.player_pos[p_id], state, events);
     }
 
     void interpret(PlayerId p_id, const PlaceBlock &, GameState &state,
-                          vector<event_t> &events) {
+                          event_list_t &events) {
         Position pos = state.player_pos[p_id];
         if (state.blocks.contains(pos)) {
             // Ignoruj próbę postawienia bloku tam, gdzie już stoi blok.
@@ -165,7 +313,7 @@ private:
     }
 
     void interpret(PlayerId p_id, const Move &m, GameState &state,
-                   vector<event_t> &events) {
+                   event_list_t &events) {
         Position pos = state.player_pos[p_id];
         auto[delta_x, delta_y] = getDelta(m.direction); // Przesunięcie gracza.
         int new_x = pos.x + delta_x;
@@ -180,7 +328,7 @@ private:
         } // Wpp ignoruj ruch.
     }
 
-    void placeBomb(Position pos, GameState &state, vector<event_t> &events) {
+    void placeBomb(Position pos, GameState &state, event_list_t &events) {
         state.bombs[state.next_bomb_id] = Bomb{
                 .position = pos,
                 .timer = params.bomb_timer
@@ -189,15 +337,14 @@ private:
         state.next_bomb_id = BombId{state.next_bomb_id.value + 1};
     }
 
-    static void placeBlock(Position pos, GameState &state, vector<event_t> &events) {
-        if (!state.blocks.contains(pos)) {
-            state.blocks.insert(pos);
+    static void placeBlock(Position pos, GameState &state, event_list_t &events) {
+        if (state.blocks.insert(pos)) {
             events.emplace_back(BlockPlaced{pos});
         }
     }
 
     void movePlayer(PlayerId p_id, Position pos, GameState &state,
-                    vector<event_t> &events) const {
+                    event_list_t &events) const {
         if (pos.x >= params.size_x || pos.y >= params.size_y) {
             // Gracz próbuje wyjśc poza planszę.
             return;
@@ -208,39 +355,75 @@ private:
         }
 
         // Ruch jest poprawny.
-        state.player_pos[p_id] = pos;
+        state.placeRobot(p_id, pos);
         events.emplace_back(PlayerMoved{p_id, pos});
     }
 
-    void updateBombs(GameState &state, vector<event_t> &events) {
-        set<PlayerId> robots_destroyed_total;
-        set<Position> blocks_destroyed_total;
-        set<BombId> bombs_exploded;
+    void updateBombs(GameState &state, event_list_t &events) {
+        std::pmr::vector<std::pair<BombId, Position>> exploding{arena.resource()};
 
         for (auto &[bomb_id, bomb]: state.bombs) {
             if (bomb.timer > 1) {
                 --bomb.timer;
             } else {
                 // Bomba ma teraz wybuchnąć.
-                auto[robots_destroyed, blocks_destroyed] = calcExplosionResult(bomb_id, state);
+                exploding.emplace_back(bomb_id, bomb.position);
+            }
+        }
 
-                robots_destroyed_total.insert(robots_destroyed.begin(), robots_destroyed.end());
-                blocks_destroyed_total.insert(blocks_destroyed.begin(), blocks_destroyed.end());
-                bombs_exploded.insert(bomb_id);
+        if (!exploding.empty()) {
+            resolveExplosions(exploding, state, events);
+        }
+    }
 
-                events.emplace_back(BombExploded{
-                        .id = bomb_id,
-                        .robots_destroyed = toList<PlayerId>(robots_destroyed),
-                        .blocks_destroyed = toList<Position>(blocks_destroyed)
-                });
+    /**
+     * Rozstrzyga naraz wszystkie wybuchy bomb w turze.
+     *
+     * Każdy wybuch sprawdza tylko roboty w swoim wierszu i kolumnie,
+     * odczytane z indeksu robotów.
+     * Każda bomba dostaje własne zdarzenie `BombExploded`,
+     * wyliczone względem stanu planszy sprzed wybuchów.
+     *
+     * Plansza nie zmienia się, dopóki nie są wyliczone wszystkie zdarzenia,
+     * więc liczą je równolegle wątki `tick`. Zdarzenia trafiają na listę
+     * w kolejności identyfikatorów bomb, tak jak przy liczeniu na jednym wątku.
+     */
+    void resolveExplosions(const std::pmr::vector<std::pair<BombId, Position>> &exploding,
+                           GameState &state, event_list_t &events) {
+        std::array<bool, UINT8_MAX + 1> robots_destroyed_total{};
+        std::pmr::vector<Position> blocks_destroyed_total{arena.resource()};
+
+        std::pmr::vector<std::optional<BombExploded>> exploded{exploding.size(), arena.resource()};
+        tick->forEach(exploding.size(), PARALLEL_EXPLOSIONS_MIN, [&](size_t i, size_t worker) {
+            auto *resource = tick_arenas[worker].resource();
+            auto [bomb_id, position] = exploding[i];
+            auto &event = exploded[i].emplace(BombExploded{
+                    .id = bomb_id,
+                    .explosion = calcExplosion(position, state),
+                    .robots_destroyed = std::pmr::vector<PlayerId>{resource},
+                    .blocks_destroyed = std::pmr::vector<Position>{resource}});
+            calcDestroyedRobots(event.explosion, state.robots, event.robots_destroyed);
+            calcDestroyedBlocks(event.explosion, state, event.blocks_destroyed);
+        });
+
+        for (auto &event: exploded) {
+            for (const auto &id: event->robots_destroyed) {
+                robots_destroyed_total[id.value] = true;
             }
+            blocks_destroyed_total.insert(blocks_destroyed_total.end(),
+                                          event->blocks_destroyed.begin(),
+                                          event->blocks_destroyed.end());
+            events.emplace_back(std::move(*event));
         }
 
         // Wyczyść pozycje graczy, których roboty
         // zostały zniszczone w wyniku wybuchów.
-        for (const auto &id: robots_destroyed_total) {
-            state.scores[id] = {state.scores[id].value + 1};
-            state.player_pos.erase(id);
+        for (size_t id = 0; id < robots_destroyed_total.size(); ++id) {
+            if (robots_destroyed_total[id]) {
+                auto player_id = PlayerId{(uint8_t) id};
+                state.scores[player_id] = {state.scores[player_id].value + 1};
+                state.removeRobot(player_id);
+            }
         }
 
         // Usuń bloki zniszczone w wyniku wybuchów.
@@ -248,54 +431,47 @@ private:
             state.blocks.erase(pos);
         }
 
-        for (const auto &id : bombs_exploded) {
-            state.bombs.erase(id);
+        for (const auto &[bomb_id, position]: exploding) {
+            state.bombs.erase(bomb_id);
         }
     }
 
-    std::pair<set<PlayerId>, set<Position>>
-    calcExplosionResult(BombId id, const GameState &state) {
-        auto bomb = state.bombs.at(id);
-
-        set<Position> affected_positions = calcExplosion(bomb.position, state);
-        set<PlayerId> robots_destroyed = calcDestroyedRobots(affected_positions, state);
-        set<Position> blocks_destroyed = calcDestroyedBlocks(affected_positions, state);
-
-        return std::pair<set<PlayerId>, set<Position>>{robots_destroyed, blocks_destroyed};
-    }
-
     /**
-     * Zwraca zbiór identyfikatorów graczy,
+     * Wyznacza posortowaną listę identyfikatorów graczy,
      * których roboty zostały zniszczone w wyniku wybuchu.
      */
-    static set<PlayerId> calcDestroyedRobots(const set<Position> &positions_affected_by_explosion,
-                                             const GameState &state) {
-        set<PlayerId> robots_destroyed;
-
-        for (const auto &[player_id, position]: state.player_pos) {
-            if (positions_affected_by_explosion.contains(position)) {
-                robots_destroyed.insert(player_id);
-            }
-        }
-
-        return robots_destroyed;
+    static void calcDestroyedRobots(const Explosion &explosion, const RobotIndex &robots,
+                                    std::pmr::vector<PlayerId> &robots_destroyed) {
+        const Position c = explosion.center;
+        // Wiersz krzyża razem ze środkiem oraz kolumna bez środka.
+        robots.collectRow(c.y, c.x - explosion.arms[1], c.x + explosion.arms[0], robots_destroyed);
+        robots.collectColumn(c.x, c.y - explosion.arms[3], c.y - 1, robots_destroyed);
+        robots.collectColumn(c.x, c.y + 1, c.y + explosion.arms[2], robots_destroyed);
+        std::sort(robots_destroyed.begin(), robots_destroyed.end());
     }
 
     /**
-    * Zwraca zbiór pozycji bloków,
+     * Wyznacza posortowaną listę pozycji bloków,
      * które zostały zniszczone w wyniku eksplozji.
-    */
-    static set<Position> calcDestroyedBlocks(const set<Position> &positions_affected_by_explosion,
-                                             const GameState &state) {
-        set<Position> blocks_destroyed;
-
-        for (const Position &pos : positions_affected_by_explosion) {
-            if (state.blocks.contains(pos)) {
-                blocks_destroyed.insert(pos);
+     *
+     * Eksplozja zatrzymuje się na pierwszym napotkanym bloku,
+     * więc zniszczone mogą zostać tylko bloki na końcach ramion krzyża.
+     */
+    static void calcDestroyedBlocks(const Explosion &explosion, const GameState &state,
+                                    std::pmr::vector<Position> &blocks_destroyed) {
+        for (size_t i = 0; i < DIRECTIONS; ++i) {
+            Position end = explosion.armEnd(i);
+            if (state.blocks.contains(end)) {
+                blocks_destroyed.push_back(end);
             }
         }
-
-        return blocks_destroyed;
+        std::sort(blocks_destroyed.begin(), blocks_destroyed.end());
+        // Ramiona długości 0 kończą się na środku krzyża.
+        blocks_destroyed.erase(std::unique(blocks_destroyed.begin(), blocks_destroyed.end(),
+                                           [](const Position &a, const Position &b) {
+                                               return a.x == b.x && a.y == b.y;
+                                           }),
+                               blocks_destroyed.end());
     }
 
     /**
@@ -304,37 +480,34 @@ private:
      * Eksplozja zatrzymuje się na blokach, więc rzeczywiste
      * ramię krzyża może być krótsze.
      *
-     * Zwraca zbiór pozycji, na które eksplozja miała wpływ.
+     * Zwraca środek krzyża i rzeczywiste długości jego ramion.
      */
-    [[nodiscard]] set<Position>
+    [[nodiscard]] Explosion
     calcExplosion(Position bomb_pos, const GameState &state) const {
-        set<Position> affected_pos;
+        Explosion explosion{.center = bomb_pos, .arms = {0, 0, 0, 0}};
+        if (state.blocks.contains(bomb_pos)) {
+            // Blok na polu bomby zatrzymuje eksplozję we wszystkich kierunkach.
+            return explosion;
+        }
 
-        std::array<int, DIRECTIONS> dx = {1, -1, 0, 0};
-        std::array<int, DIRECTIONS> dy = {0, 0, 1, -1};
         for (size_t i = 0; i < DIRECTIONS; ++i) {
-            for (uint16_t r = 0; r <= params.explosion_radius; ++r) {
-                int x = (int) bomb_pos.x + dx[i] * (int) r;
-                int y = (int) bomb_pos.y + dy[i] * (int) r;
-
-                if (0 <= x && x < (int) params.size_x
-                    && 0 <= y && y < (int) params.size_y) {
-                    // 0 <= x, y < UINT16_MAX, więc można bezpiecznie rzutować.
-                    auto pos = Position{(uint16_t) x, (uint16_t) y};
-
-                    affected_pos.insert(pos);
-                    if (state.blocks.contains(pos)) {
-                        break;
-                    }
+            for (uint16_t r = 1; r <= params.explosion_radius; ++r) {
+                int x = (int) bomb_pos.x + Explosion::DX[i] * (int) r;
+                int y = (int) bomb_pos.y + Explosion::DY[i] * (int) r;
+
+                if (!(0 <= x && x < (int) params.size_x
+                      && 0 <= y && y < (int) params.size_y)) {
+                    break;
+                }
+
+                explosion.arms[i] = r;
+                // 0 <= x, y < UINT16_MAX, więc można bezpiecznie rzutować.
+                if (state.blocks.contains(Position{(uint16_t) x, (uint16_t) y})) {
+                    break;
                 }
             }
         }
-        return affected_pos;
-    }
-
-    template<typename T>
-    static vector<T> toList(const set<T> &s) {
-        return vector<T>{s.begin(), s.end()};
+        return explosion;
     }
 
 };
@@ -0,0 +1,102 @@
+#ifndef ROBOTS_SERVER_GAME_REPLAY_H
+#define ROBOTS_SERVER_GAME_REPLAY_H
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "game-manager.h"
+#include "replay-log.h"
+#include "server.h"
+#include "turn-scheduler.h"
+
+/**
+ * Odtwarza nagrane rozgrywki: zarządca gry liczy je od nowa,
+ * z ruchami graczy odczytanymi z zapisu zamiast od klientów.
+ *
+ * Bez tempa kolejne tury są liczone jedna po drugiej, bez czekania,
+ * więc odtworzenie mierzy przepustowość samej logiki gry. Z tempem
+ * tury są rozgrywane co `turn_duration`, żeby mogli je oglądać
+ * obserwatorzy podłączeni do serwera.
+ */
+class GameReplay {
+public:
+    struct Summary {
+        uint64_t games = 0;
+        uint64_t turns = 0;
+        double seconds = 0;
+        // Zapis kończył się niepełnym rekordem.
+        bool truncated = false;
+    };
+
+    GameReplay(ReplayLog log, const ServerParams &params, std::shared_ptr<Server> server)
+            : log(std::move(log)), params(params), server(server), game(params, std::move(server)) {}
+
+    /**
+     * Odtwarza cały zapis. Rzuca wyjątek, jeśli zapis jest niepoprawny
+     * albo odtworzona gra skończyła się z innymi wynikami niż nagrana.
+     */
+    Summary run(bool paced) {
+        Summary summary;
+        TurnScheduler scheduler{params.turn_duration, OverrunPolicy::CATCH_UP};
+        bool in_game = false;
+        auto start = std::chrono::steady_clock::now();
+
+        while (auto record = log.next()) {
+            std::visit(Overloaded{
+                    [&](const RecordedGame &g) {
+                        if (in_game) {
+                            throw std::invalid_argument("Replay log - game started before the previous one ended.");
+                        }
+                        server->startRecordedGame(g.players);
+                        if (paced) {
+                            scheduler.start();
+                        }
+                        game.startGame(g.players);
+                        in_game = true;
+                        ++summary.games;
+                    },
+                    [&](const RecordedTurn &t) {
+                        if (!in_game) {
+                            throw std::invalid_argument("Replay log - turn outside of a game.");
+                        }
+                        if (paced) {
+                            scheduler.waitForNextTurn();
+                        }
+                        in_game = game.playNextTurn([&](std::pmr::memory_resource *resource) {
+                            std::pmr::map<PlayerId, client_mess_t> messages{resource};
+                            messages.insert(t.messages.begin(), t.messages.end());
+                            return messages;
+                        });
+                        ++summary.turns;
+                    },
+                    [&](const RecordedGameEnd &e) {
+                        if (in_game || !sameScores(game.lastScores(), e.scores)) {
+                            throw std::runtime_error{(boost::format(
+                                    "Replay diverged from the recording in game %1%.") % summary.games).str()};
+                        }
+                    },
+            }, *record);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        summary.seconds = elapsed.count();
+        summary.truncated = log.isTruncated();
+        return summary;
+    }
+
+private:
+    ReplayLog log;
+    const ServerParams params;
+    std::shared_ptr<Server> server;
+    GameManager game;
+
+    static bool sameScores(const map<PlayerId, Score> &a, const map<PlayerId, Score> &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto &x, const auto &y) {
+            return x.first.value == y.first.value && x.second.value == y.second.value;
+        });
+    }
+};
+
+#endif //ROBOTS_SERVER_GAME_REPLAY_H
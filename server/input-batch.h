@@ -0,0 +1,74 @@
+#ifndef ROBOTS_SERVER_INPUT_BATCH_H
+#define ROBOTS_SERVER_INPUT_BATCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <utility>
+
+#include "messages.h"
+#include "stats.h"
+
+/**
+ * Ruchy klienta odebrane w jednej porcji danych z gniazda.
+ *
+ * Zarządca gry używa tylko ostatniego ruchu klienta w turze, więc wątek
+ * odbierający zapamiętuje u siebie ostatni ruch z porcji i przekazuje go
+ * serwerowi raz, po przetworzeniu całej porcji, zamiast przy każdym ruchu.
+ *
+ * Opcjonalny limit ruchów na sekundę działa jak wiadro żetonów
+ * o pojemności jednej sekundy ruchów: ruchy ponad limit są odrzucane.
+ */
+class InputBatch {
+public:
+    // Ruchów na sekundę; 0 oznacza brak limitu.
+    explicit InputBatch(uint32_t rate_limit)
+            : rate_limit(rate_limit), tokens(rate_limit), last_refill(std::chrono::steady_clock::now()) {}
+
+    /**
+     * Zapamiętuje ruch, o ile mieści się w limicie.
+     */
+    void add(const client_mess_t &message) {
+        ++input_stats.received;
+        if (rate_limit > 0) {
+            if (!refilled) {
+                refill();
+            }
+            if (tokens < 1) {
+                ++input_stats.rate_limited;
+                return;
+            }
+            tokens -= 1;
+        }
+        pending = message;
+    }
+
+    /**
+     * Zwraca ostatni zapamiętany ruch z porcji (o ile jest) i zaczyna nową porcję.
+     */
+    std::optional<client_mess_t> take() {
+        refilled = false;
+        if (pending) {
+            ++input_stats.published;
+        }
+        return std::exchange(pending, std::nullopt);
+    }
+
+private:
+    const uint32_t rate_limit;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+    // Żetony są uzupełniane raz na porcję, więc zegar nie jest czytany przy każdym ruchu.
+    bool refilled = false;
+    std::optional<client_mess_t> pending;
+
+    void refill() {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - last_refill;
+        last_refill = now;
+        tokens = std::min((double) rate_limit, tokens + elapsed.count() * rate_limit);
+        refilled = true;
+    }
+};
+
+#endif //ROBOTS_SERVER_INPUT_BATCH_H
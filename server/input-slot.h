@@ -0,0 +1,70 @@
+#ifndef ROBOTS_SERVER_INPUT_SLOT_H
+#define ROBOTS_SERVER_INPUT_SLOT_H
+
+#include <atomic>
+#include <optional>
+
+#include "messages.h"
+
+/**
+ * Ostatni ruch klienta w bieżącej turze.
+ *
+ * Każdy ruch w trakcie gry mieści się w dwóch bajtach (rodzaj
+ * wiadomości i kierunek), więc jest przechowywany w jednej liczbie
+ * atomowej. Wątek odbierający nadpisuje ją bez żadnej blokady,
+ * a zarządca gry na początku tury zabiera ją i zeruje.
+ */
+class InputSlot {
+public:
+    void store(const client_mess_t &message) {
+        if (auto packed = pack(message)) {
+            slot.store(packed, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Zwraca ostatni ruch (o ile klient coś przysłał) i opróżnia slot.
+     */
+    std::optional<client_mess_t> take() {
+        return unpack(slot.exchange(EMPTY, std::memory_order_acquire));
+    }
+
+    void clear() {
+        slot.store(EMPTY, std::memory_order_relaxed);
+    }
+
+private:
+    // Rodzaj wiadomości w slocie nigdy nie jest równy CLIENT_JOIN (0).
+    static const uint16_t EMPTY = 0;
+
+    std::atomic<uint16_t> slot{EMPTY};
+
+    /**
+     * Pakuje ruch do postaci (rodzaj << 8) | kierunek.
+     * JOIN i wybór protokołu nie są ruchami w grze, więc zwraca dla nich EMPTY.
+     */
+    static uint16_t pack(const client_mess_t &message) {
+        return std::visit(Overloaded{
+                [](const Join &) { return EMPTY; },
+                [](const SelectProtocol &) { return EMPTY; },
+                [](const PlaceBomb &) { return (uint16_t) (CLIENT_PLACE_BOMB << 8); },
+                [](const PlaceBlock &) { return (uint16_t) (CLIENT_PLACE_BLOCK << 8); },
+                [](const Move &m) { return (uint16_t) (CLIENT_MOVE << 8 | m.direction); }
+        }, message);
+    }
+
+    static std::optional<client_mess_t> unpack(uint16_t packed) {
+        switch (packed >> 8) {
+            case CLIENT_PLACE_BOMB:
+                return PlaceBomb{CLIENT_PLACE_BOMB};
+            case CLIENT_PLACE_BLOCK:
+                return PlaceBlock{CLIENT_PLACE_BLOCK};
+            case CLIENT_MOVE:
+                return Move{CLIENT_MOVE, (Direction) (packed & 0xFF)};
+            default:
+                return std::nullopt;
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_INPUT_SLOT_H
@@ -0,0 +1,41 @@
+#ifndef ROBOTS_SERVER_LISTENER_H
+#define ROBOTS_SERVER_LISTENER_H
+
+#include <boost/asio.hpp>
+
+namespace asio = boost::asio;
+
+/* Domyślna długość kolejki połączeń czekających na akceptację. */
+const int DEFAULT_LISTEN_BACKLOG = asio::socket_base::max_listen_connections;
+
+/**
+ * Parametry gniazda nasłuchującego.
+ */
+struct ListenParams {
+    uint16_t port;
+    int backlog = DEFAULT_LISTEN_BACKLOG;
+    // Kilka gniazd nasłuchuje na tym samym porcie (SO_REUSEPORT),
+    // a jądro rozdziela między nie nowe połączenia.
+    bool shared = false;
+};
+
+/**
+ * Otwiera gniazdo nasłuchujące na porcie `listen.port`.
+ */
+inline asio::ip::tcp::acceptor openListener(asio::io_context &context, const ListenParams &listen) {
+    using tcp = asio::ip::tcp;
+    using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+    tcp::endpoint endpoint(tcp::v6(), listen.port);
+    tcp::acceptor acceptor(context);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+    if (listen.shared) {
+        acceptor.set_option(reuse_port(true));
+    }
+    acceptor.bind(endpoint);
+    acceptor.listen(listen.backlog);
+    return acceptor;
+}
+
+#endif //ROBOTS_SERVER_LISTENER_H
@@ -0,0 +1,206 @@
+#ifndef ROBOTS_SERVER_LOBBY_H
+#define ROBOTS_SERVER_LOBBY_H
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#include "server.h"
+#include "game-manager.h"
+#include "turn-scheduler.h"
+
+/**
+ * Pokój, czyli niezależna rozgrywka z własnym stanem serwera
+ * i zarządcą gry.
+ *
+ * Pokój nie ma własnego wątku: tury są liczone przez procedury
+ * obsługi zegara, wykonywane na `strand` pokoju przez wspólną
+ * dla wszystkich pokoi pulę wątków. Wspólne są też wątki
+ * liczące wybuchy (`tick_pool`).
+ */
+class Room : public std::enable_shared_from_this<Room> {
+public:
+    Room(const ServerParams &params, asio::io_context &context,
+         std::shared_ptr<ReplayRecorder> recorder = nullptr,
+         std::shared_ptr<TickPool> tick_pool = nullptr)
+            : server(std::make_shared<Server>(params)),
+              game(params, server, std::move(recorder), std::move(tick_pool)),
+              scheduler(params.turn_duration, params.overrun_policy),
+              strand(asio::make_strand(context)),
+              timer(strand) {}
+
+    /**
+     * Rozpoczyna oczekiwanie na graczy.
+     */
+    void start() {
+        std::weak_ptr<Room> weak_self = shared_from_this();
+        server->setPlayersReadyListener([weak_self] {
+            if (auto self = weak_self.lock()) {
+                asio::post(self->strand, [self] { self->tryStartGame(); });
+            }
+        });
+        asio::post(strand, [self = shared_from_this()] { self->tryStartGame(); });
+    }
+
+    [[nodiscard]] const std::shared_ptr<Server> &getServer() const {
+        return server;
+    }
+
+private:
+    const std::shared_ptr<Server> server;
+    GameManager game;
+    TurnScheduler scheduler;
+    asio::strand<asio::io_context::executor_type> strand;
+    asio::steady_timer timer;
+    bool is_playing = false;
+
+    void tryStartGame() {
+        if (is_playing) {
+            return;
+        }
+        auto players = server->tryStartGame();
+        if (!players) {
+            return;
+        }
+
+        is_playing = true;
+        scheduler.start();
+        game.startGame(std::move(*players));
+        scheduleNextTurn();
+    }
+
+    void scheduleNextTurn() {
+        timer.expires_at(scheduler.nextDeadline());
+        timer.async_wait([self = shared_from_this()](const boost::system::error_code &error) {
+            if (error) {
+                return;
+            }
+
+            self->scheduler.markTurnStarted();
+            if (self->game.playNextTurn()) {
+                self->scheduleNextTurn();
+            } else {
+                // Gra się skończyła, być może w lobby czekają już nowi gracze.
+                self->is_playing = false;
+                self->tryStartGame();
+            }
+        });
+    }
+};
+
+/**
+ * Rozdziela klientów między pokoje.
+ *
+ * Nowy klient obserwuje pokój, który właśnie zbiera graczy.
+ * Jeśli klient zgłosi chęć gry (Join) w pokoju, w którym nie ma
+ * już miejsca, to zostaje przeniesiony do pokoju z wolnym miejscem w lobby.
+ *
+ * Obsłudze połączeń udostępnia ten sam interfejs, co `Server`.
+ */
+class Lobby {
+public:
+    explicit Lobby(vector<std::shared_ptr<Server>> servers) : servers(std::move(servers)) {
+        assert(!this->servers.empty());
+    }
+
+    client_id_t acceptClient() {
+        std::unique_lock lock(mutex);
+
+        ++connection_stats.accepted;
+        return next_client_id++;
+    }
+
+    std::shared_ptr<server_mess_queue_t> createMessageQueue(client_id_t client_id,
+                                                            std::function<void()> push_listener = {}) {
+        std::unique_lock lock(mutex);
+
+        auto server = openServer();
+        client_servers[client_id] = server;
+        return server->createMessageQueue(client_id, std::move(push_listener));
+    }
+
+    void eraseClient(client_id_t client_id) {
+        std::shared_ptr<Server> server;
+        {
+            std::unique_lock lock(mutex);
+
+            auto it = client_servers.find(client_id);
+            if (it == client_servers.end()) {
+                return;
+            }
+            server = it->second;
+            client_servers.erase(it);
+        }
+        ++connection_stats.dropped;
+        server->eraseClient(client_id);
+    }
+
+    void setLastMessage(client_id_t client_id, const client_mess_t &message) {
+        if (auto server = serverOf(client_id)) {
+            server->setLastMessage(client_id, message);
+        }
+    }
+
+    void tryAcceptPlayer(client_id_t client_id, const string &name, const string &address) {
+        std::unique_lock lock(mutex);
+
+        auto it = client_servers.find(client_id);
+        if (it == client_servers.end()) {
+            return;
+        }
+
+        auto &current = it->second;
+        if (!current->canAcceptPlayer() && !current->isPlayer(client_id)) {
+            // Przenieś klienta do pokoju, w którym można jeszcze dołączyć do gry.
+            auto target = openServer();
+            if (target != current && target->canAcceptPlayer()) {
+                auto encoding = current->encodingOf(client_id);
+                if (auto message_queue = current->detachClient(client_id)) {
+                    target->attachMessageQueue(client_id, message_queue, encoding);
+                    current = target;
+                }
+            }
+        }
+        current->tryAcceptPlayer(client_id, name, address);
+    }
+
+    void selectProtocol(client_id_t client_id, const SelectProtocol &request) {
+        // Blokada współdzielona wystarcza, żeby klient nie zmienił w tym czasie pokoju.
+        std::shared_lock lock(mutex);
+
+        if (auto it = client_servers.find(client_id); it != client_servers.end()) {
+            it->second->selectProtocol(client_id, request);
+        }
+    }
+
+private:
+    std::shared_mutex mutex;
+    const vector<std::shared_ptr<Server>> servers;
+    map<client_id_t, std::shared_ptr<Server>> client_servers;
+    client_id_t next_client_id = 0;
+
+    std::shared_ptr<Server> serverOf(client_id_t client_id) {
+        std::shared_lock lock(mutex);
+
+        auto it = client_servers.find(client_id);
+        return it == client_servers.end() ? nullptr : it->second;
+    }
+
+    /**
+     * Wybiera pierwszy pokój, w którym można jeszcze dołączyć do gry.
+     * Jeśli takiego nie ma, wybiera pierwszy pokój.
+     */
+    std::shared_ptr<Server> openServer() {
+        for (const auto &server: servers) {
+            if (server->canAcceptPlayer()) {
+                return server;
+            }
+        }
+        return servers.front();
+    }
+};
+
+#endif //ROBOTS_SERVER_LOBBY_H
@@ -1,15 +1,25 @@
 #ifndef ROBOTS_SERVER_MESSAGES_H
 #define ROBOTS_SERVER_MESSAGES_H
 
+#include <array>
+#include <cassert>
+#include <concepts>
 #include <optional>
 #include <thread>
+#include <tuple>
 #include <variant>
 
+#ifdef ROBOTS_WITH_ZLIB
+#include <zlib.h>
+#endif
+
 #include "types.h"
 #include "events.h"
-#include "blocking-queue.h"
+#include "ring-queue.h"
+#include "output-buffer.h"
+#include "stats.h"
 
-const int CLIENT_MESSAGE_TYPE_MAX = 3;
+const int CLIENT_MESSAGE_TYPE_MAX = 4;
 
 /**
  * Pomocniczy typ dla std::visit.
@@ -21,11 +31,6 @@ struct Overloaded : Ts ... {
     using Ts::operator()...;
 };
 
-/* To są obsługiwane rodzaje wiadomości od klientów. */
-enum ClientMessageType : uint8_t {
-    CLIENT_JOIN, CLIENT_PLACE_BOMB, CLIENT_PLACE_BLOCK, CLIENT_MOVE
-};
-
 ClientMessageType readClientMessageType(TcpConnection &c) {
     uint8_t t = c.readU8();
     if (!(t <= CLIENT_MESSAGE_TYPE_MAX)) {
@@ -56,13 +61,69 @@ struct Move {
     Direction direction;
 };
 
-using client_mess_t = std::variant<Join, PlaceBomb, PlaceBlock, Move>;
-
-/* To są rodzaje wiadomości wysyłanych przez serwer. */
-enum ServerMessage : uint8_t {
-    HELLO, ACCEPTED_PLAYER, GAME_STARTED, TURN, GAME_ENDED
+/**
+ * Klient prosi o wersję protokołu `version` z dodatkami `features`.
+ * Wysyła ją zaraz po połączeniu, bo HELLO przychodzi, zanim klient
+ * cokolwiek wyśle, a obserwatorzy nigdy nie wysyłają Join.
+ */
+struct SelectProtocol {
+    ClientMessageType type;
+    uint8_t version;
+    uint8_t features;
 };
 
+using client_mess_t = std::variant<Join, PlaceBomb, PlaceBlock, Move, SelectProtocol>;
+
+/**
+ * Próbuje zdekodować jedną wiadomość klienta
+ * z ciągu `len` bajtów wskazywanego przez `data`.
+ *
+ * Jeśli ciąg zawiera całą wiadomość, to ją zwraca i ustawia
+ * `consumed` na liczbę przeczytanych bajtów. Wpp zwraca std::nullopt.
+ * Rzuca wyjątek, jeśli wiadomość jest niepoprawna.
+ */
+std::optional<client_mess_t> parseClientMessage(const uint8_t *data, size_t len, size_t &consumed) {
+    if (len == 0) {
+        return std::nullopt;
+    }
+    if (data[0] > CLIENT_MESSAGE_TYPE_MAX) {
+        throw std::invalid_argument("Client message type not recognised!");
+    }
+
+    auto t = (ClientMessageType) data[0];
+    switch (t) {
+        case CLIENT_JOIN: {
+            if (len < 2 || len < 2 + (size_t) data[1]) {
+                return std::nullopt;
+            }
+            consumed = 2 + (size_t) data[1];
+            return Join{t, string((const char *) data + 2, data[1])};
+        }
+        case CLIENT_PLACE_BOMB:
+            consumed = 1;
+            return PlaceBomb{t};
+        case CLIENT_PLACE_BLOCK:
+            consumed = 1;
+            return PlaceBlock{t};
+        case CLIENT_MOVE:
+            if (len < 2) {
+                return std::nullopt;
+            }
+            if (data[1] >= DIRECTIONS) {
+                throw std::invalid_argument("Invalid move direction!");
+            }
+            consumed = 2;
+            return Move{t, (Direction) data[1]};
+        case CLIENT_SELECT_PROTOCOL:
+            if (len < 3) {
+                return std::nullopt;
+            }
+            consumed = 3;
+            return SelectProtocol{t, data[1], data[2]};
+    }
+    return std::nullopt;
+}
+
 /**
  * Parametry serwera wysyłane klientowi
  * od razu po akceptacji połączenia.
@@ -76,16 +137,10 @@ struct Hello {
     uint16_t explosion_radius;
     uint16_t bomb_timer;
 
-    void write(TcpConnection &c) const {
-        c.write((uint8_t) HELLO);
-        c.write(server_name);
-        c.write(players_count);
-        c.write(size_x);
-        c.write(size_y);
-        c.write(game_length);
-        c.write(explosion_radius);
-        c.write(bomb_timer);
-    }
+    using wire_layout = layout::Hello;
+    static constexpr auto wire_fields = std::tuple{
+            &Hello::server_name, &Hello::players_count, &Hello::size_x, &Hello::size_y,
+            &Hello::game_length, &Hello::explosion_radius, &Hello::bomb_timer};
 };
 
 /* Serwer zaakceptował chęć klienta do gry. */
@@ -93,21 +148,16 @@ struct AcceptedPlayer {
     PlayerId id;
     Player player;
 
-    void write(TcpConnection &c) const {
-        c.write(ACCEPTED_PLAYER);
-        id.write(c);
-        player.write(c);
-    }
+    using wire_layout = layout::AcceptedPlayer;
+    static constexpr auto wire_fields = std::tuple{&AcceptedPlayer::id, &AcceptedPlayer::player};
 };
 
 /* Rozgrywka się rozpoczęła. */
 struct GameStarted {
     map<PlayerId, Player> players;
 
-    void write(TcpConnection &c) const {
-        c.write(GAME_STARTED);
-        c.writeMap<PlayerId, Player>(players);
-    }
+    using wire_layout = layout::GameStarted;
+    static constexpr auto wire_fields = std::tuple{&GameStarted::players};
 };
 
 /* Rozgrywka została zakończona. */
@@ -115,49 +165,304 @@ struct GameEnded {
     // Wyniki poszczególnych graczy.
     map<PlayerId, Score> scores;
 
-    void write(TcpConnection &c) const {
-        c.write(GAME_ENDED);
-        c.writeMap<PlayerId, Score>(scores);
-    }
+    using wire_layout = layout::GameEnded;
+    static constexpr auto wire_fields = std::tuple{&GameEnded::scores};
 };
 
+/**
+ * Górne ograniczenie liczby bajtów listy zdarzeń zapisanej w wersji `version`.
+ * Zdarzenia nie są przy tym kodowane, więc liczenie jest dużo
+ * tańsze od zapisu, a bufor tej wielkości nie musi rosnąć.
+ */
+size_t eventListMaxSize(const event_list_t &events, ProtocolVersion version) {
+    size_t res = wire::lengthSize(events.size(), version);
+    for (auto &e: events) {
+        res += std::visit(Overloaded{
+                [&](const BombExploded &event) { return event.maxSize(version); },
+                [&]<typename E>(const E &) { return wire::maxSize<E>(version); }
+        }, e);
+    }
+    return res;
+}
+
+void writeEventList(OutputBuffer &c, const event_list_t &events) {
+    c.writeLength(events.size());
+    for (auto &e: events) {
+        std::visit(Overloaded{
+                [&](const BombExploded &event) { event.write(c); },
+                [&](const auto &event) { wire::write(c, event); }
+        }, e);
+    }
+}
+
 /* Jedna tura rozgrywki. */
 struct Turn {
     uint16_t turn;
-    vector<event_t> events;
+    event_list_t events;
 
-    void write(TcpConnection &c) const {
+    void write(OutputBuffer &c) const {
         c.write(TURN);
         c.write(turn);
-        writeEventList(c);
+        writeEventList(c, events);
     }
 
-private:
-    void writeEventList(TcpConnection &c) const {
-        c.write((uint32_t) events.size());
-        for (auto &e: events) {
-            std::visit(Overloaded{
-                    [&](const BombPlaced &event) { event.write(c); },
-                    [&](const BombExploded &event) { event.write(c); },
-                    [&](const PlayerMoved &event) { event.write(c); },
-                    [&](const BlockPlaced &event) { event.write(c); }
-            }, e);
+    /**
+     * Górne ograniczenie liczby bajtów tury zapisanej w wersji `version`.
+     */
+    [[nodiscard]] size_t maxSize(ProtocolVersion version) const {
+        return 1 + sizeof(turn) + eventListMaxSize(events, version);
+    }
+};
+
+/* Bomba z obrazu gry i tura, w której ją podłożono. */
+struct PlacedBomb {
+    BombId id;
+    uint16_t turn;
+
+    using wire_layout = layout::PlacedBomb;
+    static constexpr auto wire_fields = std::tuple{&PlacedBomb::id, &PlacedBomb::turn};
+};
+
+/**
+ * Obraz gry po turze `turn` dla klienta dołączającego w trakcie gry:
+ * zdarzenia odtwarzające roboty, bloki i bomby, a do tego wyniki graczy
+ * i tury podłożenia bomb, żeby nowy klient widział te same wyniki
+ * i liczniki bomb co pozostali.
+ *
+ * V1 nie ma takiej wiadomości, więc w V1 obraz jest zapisywany jako zwykła
+ * tura z samymi zdarzeniami, a wyniki i liczniki bomb przepadają.
+ */
+struct Snapshot {
+    uint16_t turn;
+    // Wyniki graczy, których roboty zostały już zniszczone.
+    map<PlayerId, Score> scores;
+    vector<PlacedBomb> bombs;
+    event_list_t events;
+
+    using wire_layout = layout::Snapshot;
+    static constexpr auto wire_fields = std::tuple{&Snapshot::turn, &Snapshot::scores, &Snapshot::bombs};
+
+    void write(OutputBuffer &c) const {
+        if (c.version() == ProtocolVersion::V1) {
+            c.write(TURN);
+            c.write(turn);
+        } else {
+            wire::write(c, *this);
         }
+        writeEventList(c, events);
+    }
+
+    [[nodiscard]] size_t maxSize(ProtocolVersion version) const {
+        size_t header = version == ProtocolVersion::V1 ? 1 + sizeof(turn) : wire::size(*this, version);
+        return header + eventListMaxSize(events, version);
     }
 };
 
-using server_mess_t = std::variant<Hello, AcceptedPlayer, GameStarted, Turn, GameEnded>;
-using server_mess_queue_t = BlockingQueue<std::shared_ptr<server_mess_t>>;
+/**
+ * Serwer potwierdza wersję protokołu i dodatki, których będzie używał.
+ * Wiadomość jest zawsze kodowana w V1, a wszystkie następne
+ * są już w potwierdzonej wersji, poczynając od ponownego HELLO.
+ */
+struct ProtocolSelected {
+    uint8_t version;
+    uint8_t features;
+
+    using wire_layout = layout::ProtocolSelected;
+    static constexpr auto wire_fields = std::tuple{&ProtocolSelected::version, &ProtocolSelected::features};
+};
+
+using server_mess_t = std::variant<Hello, AcceptedPlayer, GameStarted, Turn, GameEnded, ProtocolSelected, Snapshot>;
+
+/**
+ * Tura albo obraz gry, czyli wiadomość, którą w V2 można skompresować.
+ */
+bool isCompressible(const server_mess_t &message) {
+    return std::holds_alternative<Turn>(message) || std::holds_alternative<Snapshot>(message);
+}
+
+/**
+ * Sposoby kodowania wiadomości serwera, uzgadniane z każdym klientem osobno.
+ */
+enum class Encoding : uint8_t {
+    V1,
+    V2,
+    // V2, a duże tury skompresowane deflate.
+    V2_DEFLATE
+};
+
+const size_t ENCODINGS = 3;
+
+/**
+ * Wybiera kodowanie dla prośby klienta: najwyższą wersję protokołu
+ * nie nowszą od żądanej i te z żądanych dodatków, które serwer obsługuje.
+ */
+Encoding negotiateEncoding(const SelectProtocol &request) {
+    if (request.version < (uint8_t) ProtocolVersion::V2) {
+        return Encoding::V1;
+    }
+#ifdef ROBOTS_WITH_ZLIB
+    if (request.features & PROTOCOL_FEATURE_DEFLATE) {
+        return Encoding::V2_DEFLATE;
+    }
+#endif
+    return Encoding::V2;
+}
+
+ProtocolVersion protocolVersion(Encoding encoding) {
+    return encoding == Encoding::V1 ? ProtocolVersion::V1 : ProtocolVersion::V2;
+}
+
+ProtocolSelected protocolSelected(Encoding encoding) {
+    return ProtocolSelected{
+            .version = (uint8_t) protocolVersion(encoding),
+            .features = encoding == Encoding::V2_DEFLATE ? PROTOCOL_FEATURE_DEFLATE : (uint8_t) 0
+    };
+}
+
+/**
+ * Zakodowana wiadomość serwera.
+ *
+ * Bajty wiadomości są wyliczane tylko raz, a następnie
+ * niezmienny bufor jest współdzielony przez kolejki wszystkich klientów.
+ */
+using encoded_mess_t = std::shared_ptr<const OutputBuffer>;
+using server_mess_queue_t = RingQueue<encoded_mess_t>;
+
+/* Tyle wiadomości z kolejki klienta można wysłać jednym wywołaniem systemowym. */
+const size_t MAX_GATHERED_MESSAGES = 64;
+
+/* Mniejszych tur nie opłaca się kompresować. */
+const size_t MIN_COMPRESSED_TURN_SIZE = 256;
+
+#ifdef ROBOTS_WITH_ZLIB
+
+/**
+ * Kompresuje zakodowaną turę do wiadomości COMPRESSED_TURN:
+ * varint długości tury, varint długości danych i strumień zlib,
+ * który po rozpakowaniu jest zwykłą wiadomością TURN albo SNAPSHOT w V2.
+ * Zwraca nullptr, jeśli kompresja nie zmniejszyła tury.
+ */
+std::shared_ptr<OutputBuffer> compressTurn(const OutputBuffer &turn) {
+    uLongf len = compressBound((uLong) turn.size());
+    vector<uint8_t> compressed(len);
+    if (compress2(compressed.data(), &len, turn.data(), (uLong) turn.size(), Z_BEST_SPEED) != Z_OK
+        || 1 + 2 * MAX_VARINT_SIZE + len >= turn.size()) {
+        return nullptr;
+    }
+
+    auto buffer = std::make_shared<OutputBuffer>(ProtocolVersion::V2);
+    buffer->reserve(1 + 2 * MAX_VARINT_SIZE + len);
+    buffer->write((uint8_t) COMPRESSED_TURN);
+    buffer->writeVarint(turn.size());
+    buffer->writeVarint(len);
+    buffer->writeBytes({compressed.data(), len});
+
+    ++codec_stats.compressed_turns;
+    codec_stats.compression_saved_bytes += turn.size() - buffer->size();
+    return buffer;
+}
+
+#endif
+
+/**
+ * Rozmiar bufora, w którym zmieści się cała wiadomość zakodowana
+ * w wersji `version` (bez kompresji): dokładny dla wiadomości
+ * poza turą, a dla tury jej górne ograniczenie.
+ */
+size_t encodedSizeBound(const server_mess_t &message, ProtocolVersion version) {
+    return std::visit(Overloaded{
+            [&](const Turn &m) { return m.maxSize(version); },
+            [&](const Snapshot &m) { return m.maxSize(version); },
+            [&](const auto &m) { return wire::size(m, version); }
+    }, message);
+}
+
+encoded_mess_t encodeServerMessage(const server_mess_t &message, Encoding encoding = Encoding::V1) {
+    ScopedTimer timer{codec_stats.encode_time_ns, latency_stats.encode_us};
 
-void writeServerMessage(TcpConnection &c, const std::shared_ptr<server_mess_t>& message_ptr) {
-    server_mess_t mess = *message_ptr;
+    auto buffer = std::make_shared<OutputBuffer>(protocolVersion(encoding));
+    // Bufor od razu ma rozmiar całej wiadomości, więc nie rośnie w trakcie kodowania.
+    [[maybe_unused]] size_t bound = encodedSizeBound(message, buffer->version());
+    buffer->reserve(bound);
     std::visit(Overloaded{
-            [&](const Hello &m) { m.write(c); },
-            [&](const AcceptedPlayer &m) { m.write(c); },
-            [&](const GameStarted &m) { m.write(c); },
-            [&](const Turn &m) { m.write(c); },
-            [&](const GameEnded &m) { m.write(c); }
-    }, mess);
+            [&](const Turn &m) { m.write(*buffer); },
+            [&](const Snapshot &m) { m.write(*buffer); },
+            [&](const auto &m) { wire::write(*buffer, m); }
+    }, message);
+    assert(buffer->size() <= bound);
+
+#ifdef ROBOTS_WITH_ZLIB
+    if (encoding == Encoding::V2_DEFLATE && isCompressible(message)
+        && buffer->size() >= MIN_COMPRESSED_TURN_SIZE) {
+        if (auto compressed = compressTurn(*buffer)) {
+            buffer = std::move(compressed);
+        }
+    }
+#endif
+
+    ++codec_stats.encoded_messages;
+    codec_stats.encoded_bytes += buffer->size();
+    return buffer;
 }
 
+/**
+ * Wiadomość serwera razem z jej postaciami w kolejnych kodowaniach.
+ *
+ * Każde kodowanie jest wyliczane co najwyżej raz i dopiero wtedy,
+ * gdy potrzebuje go któryś klient, a wynik współdzielą kolejki
+ * wszystkich klientów z tym kodowaniem. Obiekt nie jest synchronizowany.
+ */
+class EncodedMessage {
+public:
+    /**
+     * Wiadomość jest tworzona od razu w obiekcie, bez przenoszenia wariantu.
+     */
+    template<typename M>
+    requires std::constructible_from<server_mess_t, M>
+    explicit EncodedMessage(M &&message) : value(std::forward<M>(message)) {}
+
+    /**
+     * Wiadomość, której postać w kodowaniu `encoding` już jest,
+     * np. odebrana w tym kodowaniu od innego serwera.
+     */
+    template<typename M>
+    requires std::constructible_from<server_mess_t, M>
+    EncodedMessage(M &&message, Encoding encoding, encoded_mess_t bytes) : value(std::forward<M>(message)) {
+        encoded[(size_t) encoding] = std::move(bytes);
+    }
+
+    const encoded_mess_t &get(Encoding encoding) {
+        auto &buffer = encoded[(size_t) encoding];
+        if (!buffer) {
+            buffer = encoded[(size_t) Encoding::V2] && encoding == Encoding::V2_DEFLATE
+                     ? deflateV2() : encodeServerMessage(value, encoding);
+        }
+        return buffer;
+    }
+
+    [[nodiscard]] const server_mess_t &message() const {
+        return value;
+    }
+
+private:
+    server_mess_t value;
+    std::array<encoded_mess_t, ENCODINGS> encoded{};
+
+    /**
+     * V2_DEFLATE różni się od V2 tylko kompresją dużych tur,
+     * więc powstaje z gotowej postaci V2 bez ponownego kodowania.
+     */
+    encoded_mess_t deflateV2() const {
+        const auto &v2 = encoded[(size_t) Encoding::V2];
+#ifdef ROBOTS_WITH_ZLIB
+        if (isCompressible(value) && v2->size() >= MIN_COMPRESSED_TURN_SIZE) {
+            if (auto compressed = compressTurn(*v2)) {
+                return compressed;
+            }
+        }
+#endif
+        return v2;
+    }
+};
+
 #endif //ROBOTS_SERVER_MESSAGES_H
@@ -0,0 +1,268 @@
+#ifndef ROBOTS_SERVER_METRICS_H
+#define ROBOTS_SERVER_METRICS_H
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#include "stats.h"
+
+/**
+ * Formatuje liczniki i histogramy serwera
+ * w tekstowym formacie Prometheusa.
+ */
+class MetricsWriter {
+public:
+    explicit MetricsWriter(std::ostream &os) : os(os) {}
+
+    void counter(const std::string &name, const std::string &help, uint64_t value) {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " counter\n";
+        os << name << " " << value << "\n";
+    }
+
+    /**
+     * Licznik z osobną wartością dla graczy i dla obserwatorów.
+     */
+    void counterByClass(const std::string &name, const std::string &help,
+                        uint64_t players, uint64_t spectators) {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " counter\n";
+        os << name << "{class=\"player\"} " << players << "\n";
+        os << name << "{class=\"spectator\"} " << spectators << "\n";
+    }
+
+    void gauge(const std::string &name, const std::string &help, uint64_t value) {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " gauge\n";
+        os << name << " " << value << "\n";
+    }
+
+    /**
+     * Wypisuje skumulowane kubełki histogramu aż do ostatniego niepustego.
+     */
+    void histogram(const std::string &name, const std::string &help, const Histogram &h) {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " histogram\n";
+
+        size_t last = 0;
+        for (size_t i = 0; i < Histogram::BUCKETS; ++i) {
+            if (h.count(i) > 0) {
+                last = i;
+            }
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= last; ++i) {
+            cumulative += h.count(i);
+            os << name << "_bucket{le=\"" << Histogram::upperBound(i) << "\"} " << cumulative << "\n";
+        }
+        os << name << "_bucket{le=\"+Inf\"} " << h.getCount() << "\n";
+        os << name << "_sum " << h.getSum() << "\n";
+        os << name << "_count " << h.getCount() << "\n";
+    }
+
+private:
+    std::ostream &os;
+};
+
+/**
+ * Zapisuje wszystkie statystyki serwera w formacie Prometheusa.
+ */
+void writeMetrics(std::ostream &os) {
+    MetricsWriter w{os};
+
+    w.histogram("robots_turn_compute_microseconds",
+                "Time spent computing a turn, without broadcasting it.",
+                latency_stats.turn_compute_us);
+    w.histogram("robots_collect_lock_wait_microseconds",
+                "Time the game manager waited for the server lock to collect player moves.",
+                latency_stats.collect_lock_wait_us);
+    w.histogram("robots_broadcast_microseconds",
+                "Time spent pushing one message to the queues of all clients.",
+                latency_stats.broadcast_us);
+    w.histogram("robots_encode_microseconds",
+                "Time spent encoding one server message.",
+                latency_stats.encode_us);
+    w.histogram("robots_send_microseconds",
+                "Time spent writing a batch of messages to one client socket.",
+                latency_stats.send_us);
+    w.histogram("robots_client_queue_depth",
+                "Messages waiting in a client queue when a new message is broadcast.",
+                latency_stats.queue_depth);
+    w.histogram("robots_connection_hello_microseconds",
+                "Time from accepting a connection to sending its first messages, starting with HELLO.",
+                latency_stats.hello_us);
+
+    w.counter("robots_encoded_messages_total", "Encoded server messages.",
+              codec_stats.encoded_messages);
+    w.counter("robots_encoded_bytes_total", "Bytes of encoded server messages.",
+              codec_stats.encoded_bytes);
+    w.counter("robots_compressed_turns_total", "Turns sent compressed to protocol v2 clients.",
+              codec_stats.compressed_turns);
+    w.counter("robots_compression_saved_bytes_total", "Bytes saved by compressing turns.",
+              codec_stats.compression_saved_bytes);
+    w.counter("robots_sent_messages_total", "Messages sent to clients.",
+              codec_stats.sent_messages);
+    w.counter("robots_sent_bytes_total", "Bytes sent to clients.",
+              codec_stats.sent_bytes);
+    w.counter("robots_coalesced_sends_total", "Sends flagged MSG_MORE because more messages were queued.",
+              codec_stats.coalesced_sends);
+
+    w.counter("robots_turns_total", "Scheduled turns.", turn_stats.turns);
+    w.counter("robots_turn_overruns_total", "Turns that started after their deadline.",
+              turn_stats.overruns);
+    w.gauge("robots_turn_lateness_max_microseconds", "Largest turn start lateness.",
+            turn_stats.max_lateness_us);
+
+    w.counterByClass("robots_queue_overflows_total", "Client queues found full.",
+                     queue_stats.players.overflows, queue_stats.spectators.overflows);
+    w.counterByClass("robots_queue_resyncs_total", "Client queues rebuilt after an overflow.",
+                     queue_stats.players.resyncs, queue_stats.spectators.resyncs);
+    w.counterByClass("robots_queue_disconnects_total", "Clients dropped after a queue overflow.",
+                     queue_stats.players.disconnects, queue_stats.spectators.disconnects);
+    w.counter("robots_queue_bytes_limit_overflows_total",
+              "Overflows caused by the queued bytes limit rather than the message count.",
+              queue_stats.bytes_limit_overflows);
+
+    w.counter("robots_connections_accepted_total", "Accepted client connections.",
+              connection_stats.accepted);
+    w.counter("robots_connections_dropped_total", "Closed client connections.",
+              connection_stats.dropped);
+    w.counter("robots_connections_pooled_total", "Connections served by a preallocated pooled object.",
+              connection_stats.pooled);
+
+    w.counter("robots_inputs_received_total", "Game inputs received from clients.",
+              input_stats.received);
+    w.counter("robots_inputs_rate_limited_total", "Game inputs dropped by the per-client rate limit.",
+              input_stats.rate_limited);
+    w.counter("robots_inputs_published_total",
+              "Latest inputs of a read batch handed over to the game.",
+              input_stats.published);
+
+    w.counter("robots_export_messages_total", "Messages written to the game archive.",
+              export_stats.exported_messages);
+    w.counter("robots_export_bytes_total", "Bytes written to the game archive.",
+              export_stats.exported_bytes);
+    w.counter("robots_export_dropped_total",
+              "Messages left out of the game archive because its queue was full or writing failed.",
+              export_stats.dropped_messages);
+    w.counter("robots_export_segments_total", "Opened game archive segments.",
+              export_stats.segments);
+}
+
+/**
+ * Minimalny punkt dostępowy HTTP z metrykami serwera.
+ *
+ * Na każde połączenie odpowiada bieżącymi metrykami
+ * i je zamyka, niezależnie od treści żądania. Działa na własnym
+ * wątku, więc gdy nikt nie odpytuje serwera, nic nie kosztuje.
+ *
+ * Połączenia są obsługiwane asynchronicznie, każde z limitem czasu
+ * i rozmiaru żądania, więc klient, który nie kończy żądania,
+ * nie wstrzymuje odpytywania przez innych.
+ */
+class MetricsEndpoint {
+    using tcp = boost::asio::ip::tcp;
+public:
+    explicit MetricsEndpoint(uint16_t port)
+            : acceptor(context, tcp::endpoint(tcp::v6(), port)) {}
+
+    [[noreturn]] void run() {
+        doAccept();
+        for (;;) {
+            context.run();
+            context.restart();
+        }
+    }
+
+private:
+    // Limit rozmiaru nagłówków żądania.
+    static const size_t MAX_REQUEST_SIZE = 8192;
+    // Czas na przesłanie żądania i odebranie odpowiedzi.
+    static constexpr std::chrono::seconds REQUEST_TIMEOUT{5};
+
+    /**
+     * Jedno połączenie: odbiór żądania, wysłanie odpowiedzi i zamknięcie.
+     * Po upływie limitu czasu gniazdo jest zamykane, co przerywa
+     * trwającą operację.
+     */
+    class Session : public std::enable_shared_from_this<Session> {
+    public:
+        explicit Session(tcp::socket socket)
+                : socket(std::move(socket)), request(MAX_REQUEST_SIZE), deadline(this->socket.get_executor()) {}
+
+        void start() {
+            deadline.expires_after(REQUEST_TIMEOUT);
+            deadline.async_wait([self = shared_from_this()](const boost::system::error_code &error) {
+                if (!error) {
+                    boost::system::error_code ignored;
+                    self->socket.close(ignored);
+                }
+            });
+            // Treść żądania nie ma znaczenia, ale trzeba ją odebrać,
+            // żeby zamknięcie gniazda nie zerwało połączenia.
+            boost::asio::async_read_until(
+                    socket, request, "\r\n\r\n",
+                    [self = shared_from_this()](const boost::system::error_code &error, size_t) {
+                        if (error) {
+                            // Klient zerwał połączenie, przekroczył limit
+                            // rozmiaru albo czasu.
+                            self->close();
+                            return;
+                        }
+                        self->respond();
+                    });
+        }
+
+    private:
+        tcp::socket socket;
+        boost::asio::streambuf request;
+        boost::asio::steady_timer deadline;
+        std::string response;
+
+        void respond() {
+            std::stringstream body;
+            writeMetrics(body);
+            auto content = body.str();
+
+            std::stringstream out;
+            out << "HTTP/1.1 200 OK\r\n"
+                << "Content-Type: text/plain; version=0.0.4\r\n"
+                << "Content-Length: " << content.size() << "\r\n"
+                << "Connection: close\r\n\r\n"
+                << content;
+            response = out.str();
+            boost::asio::async_write(
+                    socket, boost::asio::buffer(response),
+                    [self = shared_from_this()](const boost::system::error_code &, size_t) {
+                        self->close();
+                    });
+        }
+
+        void close() {
+            deadline.cancel();
+            boost::system::error_code ignored;
+            socket.shutdown(tcp::socket::shutdown_both, ignored);
+            socket.close(ignored);
+        }
+    };
+
+    boost::asio::io_context context;
+    tcp::acceptor acceptor;
+
+    void doAccept() {
+        acceptor.async_accept([this](const boost::system::error_code &error, tcp::socket socket) {
+            if (!error) {
+                std::make_shared<Session>(std::move(socket))->start();
+            }
+            doAccept();
+        });
+    }
+};
+
+#endif //ROBOTS_SERVER_METRICS_H
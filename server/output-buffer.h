@@ -0,0 +1,105 @@
+#ifndef ROBOTS_SERVER_OUTPUT_BUFFER_H
+#define ROBOTS_SERVER_OUTPUT_BUFFER_H
+
+#include <cstring>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <endian.h>
+
+#include "../common/wire.h"
+
+using std::vector;
+using std::map;
+using std::string;
+
+/**
+ * Bufor, do którego serializowane są wiadomości serwera.
+ *
+ * Wiadomość jest kodowana do bufora tylko raz,
+ * a gotowe bajty mogą zostać wysłane dowolnie wielu klientom.
+ * Bufor zna wersję protokołu, w której koduje wiadomość.
+ */
+class OutputBuffer {
+public:
+    explicit OutputBuffer(ProtocolVersion version = ProtocolVersion::V1) : protocol(version) {}
+
+    void write(uint8_t val) {
+        bytes.push_back(val);
+    }
+
+    void write(uint16_t val) {
+        val = htobe16(val);
+        writeBytes({(uint8_t *) &val, sizeof(val)});
+    }
+
+    void write(uint32_t val) {
+        val = htobe32(val);
+        writeBytes({(uint8_t *) &val, sizeof(val)});
+    }
+
+    void write(uint64_t val) {
+        val = htobe64(val);
+        writeBytes({(uint8_t *) &val, sizeof(val)});
+    }
+
+    /**
+     * Zapisuje liczbę po 7 bitów na bajt, od najmłodszych.
+     * Najstarszy bit bajtu mówi, czy liczba ma kolejne bajty.
+     */
+    void writeVarint(uint64_t val) {
+        while (val >= 0x80) {
+            write((uint8_t) (val | 0x80));
+            val >>= 7;
+        }
+        write((uint8_t) val);
+    }
+
+    /**
+     * Długość listy lub słownika: w V1 liczba 32-bitowa, w V2 varint.
+     */
+    void writeLength(size_t len) {
+        if (protocol == ProtocolVersion::V2) {
+            writeVarint(len);
+        } else {
+            write((uint32_t) len);
+        }
+    }
+
+    void write(const string &s) {
+        write((uint8_t) s.length());
+        writeBytes({(const uint8_t *) s.data(), s.length()});
+    }
+
+    void writeBytes(std::span<const uint8_t> src) {
+        bytes.insert(bytes.end(), src.begin(), src.end());
+    }
+
+    void clear() {
+        bytes.clear();
+    }
+
+    void reserve(size_t capacity) {
+        bytes.reserve(capacity);
+    }
+
+    [[nodiscard]] ProtocolVersion version() const {
+        return protocol;
+    }
+
+    [[nodiscard]] const uint8_t *data() const {
+        return bytes.data();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return bytes.size();
+    }
+
+private:
+    ProtocolVersion protocol;
+    vector<uint8_t> bytes;
+};
+
+#endif //ROBOTS_SERVER_OUTPUT_BUFFER_H
@@ -0,0 +1,385 @@
+#ifndef ROBOTS_SERVER_REPLAY_LOG_H
+#define ROBOTS_SERVER_REPLAY_LOG_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <variant>
+
+#include "messages.h"
+#include "server.h"
+
+/**
+ * Zapis rozgrywek do odtworzenia.
+ *
+ * Zarządca gry jest deterministyczny: przy tych samych parametrach
+ * (w tym ziarnie) i tych samych ruchach graczy w kolejnych turach
+ * wylicza te same zdarzenia. Zapis zawiera więc tylko parametry gry
+ * i wejście zarządcy, a nie wysyłane wiadomości.
+ *
+ * Format (liczby w kolejności bajtów sieci, długości słowników jako varinty):
+ * - nagłówek: "RBTL", wersja formatu, parametry gry,
+ * - rekordy, każdy poprzedzony rodzajem:
+ *   - GAME_STARTED: słownik graczy,
+ *   - TURN: liczba ruchów i kolejne ruchy jako identyfikator gracza
+ *     i wiadomość klienta w postaci z protokołu (tury numerowane od 1),
+ *   - GAME_ENDED: słownik wyników, do sprawdzenia zgodności odtworzenia.
+ * Zapis tylko dopisuje rekordy na końcu pliku.
+ */
+
+const std::array<uint8_t, 4> REPLAY_LOG_MAGIC = {'R', 'B', 'T', 'L'};
+const uint8_t REPLAY_LOG_VERSION = 1;
+
+enum ReplayRecordType : uint8_t {
+    RECORD_GAME_STARTED, RECORD_TURN, RECORD_GAME_ENDED
+};
+
+/**
+ * Zapisuje rekordy rozgrywek jednego zarządcy gry.
+ *
+ * Wątek tury tylko koduje rekord do bufora w pamięci; do pliku
+ * zapisuje go osobny wątek, gdy zbierze się dość danych, na końcu
+ * gry, a poza tym co sekundę. Błąd zapisu wyłącza nagrywanie,
+ * ale nie zatrzymuje serwera.
+ */
+class ReplayRecorder {
+public:
+    ReplayRecorder(const string &path, const ServerParams &params)
+            : file(std::fopen(path.c_str(), "wb")) {
+        if (file == nullptr) {
+            throw std::runtime_error{(boost::format("Failed to open replay log %1%: %2%")
+                                      % path % std::strerror(errno)).str()};
+        }
+        writeHeader(params);
+        writer = std::jthread([this](const std::stop_token &stop) { writeLoop(stop); });
+    }
+
+    ReplayRecorder(const ReplayRecorder &) = delete;
+    ReplayRecorder &operator=(const ReplayRecorder &) = delete;
+
+    ~ReplayRecorder() {
+        writer.request_stop();
+        pending_ready.notify_all();
+        writer.join();
+        std::fclose(file);
+    }
+
+    void recordGameStarted(const map<PlayerId, Player> &players) {
+        record.clear();
+        record.write((uint8_t) RECORD_GAME_STARTED);
+        wire::write(record, players);
+        append(false);
+    }
+
+    void recordTurn(const std::pmr::map<PlayerId, client_mess_t> &messages) {
+        record.clear();
+        record.write((uint8_t) RECORD_TURN);
+        record.writeVarint((uint64_t) std::count_if(messages.begin(), messages.end(), [](const auto &m) {
+            return isGameInput(m.second);
+        }));
+        for (const auto &[player_id, message]: messages) {
+            if (isGameInput(message)) {
+                wire::write(record, player_id);
+                writeInput(message);
+            }
+        }
+        append(false);
+    }
+
+    void recordGameEnded(const map<PlayerId, Score> &scores) {
+        record.clear();
+        record.write((uint8_t) RECORD_GAME_ENDED);
+        wire::write(record, scores);
+        append(true);
+    }
+
+private:
+    // Tyle bajtów w buforze budzi wątek zapisujący przed upływem sekundy.
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    std::FILE *file;
+    // Bufor kodowanego rekordu; używa go tylko wątek tury.
+    OutputBuffer record{ProtocolVersion::V2};
+
+    std::mutex mutex;
+    std::condition_variable_any pending_ready;
+    vector<uint8_t> pending;
+    bool flush_requested = false;
+    bool failed = false;
+    std::jthread writer;
+
+    /**
+     * Do zapisu trafiają tylko ruchy w grze. Join i wybór
+     * protokołu nigdy nie docierają do zarządcy gry.
+     */
+    static bool isGameInput(const client_mess_t &message) {
+        return !std::holds_alternative<Join>(message) && !std::holds_alternative<SelectProtocol>(message);
+    }
+
+    void writeInput(const client_mess_t &message) {
+        std::visit(Overloaded{
+                [&](const Move &m) {
+                    record.write((uint8_t) CLIENT_MOVE);
+                    record.write((uint8_t) m.direction);
+                },
+                [&](const auto &m) { record.write((uint8_t) m.type); }
+        }, message);
+    }
+
+    void writeHeader(const ServerParams &params) {
+        record.writeBytes(REPLAY_LOG_MAGIC);
+        record.write(REPLAY_LOG_VERSION);
+        record.write(params.bomb_timer);
+        record.write(params.players_count);
+        record.write(params.turn_duration);
+        record.write(params.explosion_radius);
+        record.write(params.initial_blocks);
+        record.write(params.game_length);
+        record.write(params.server_name);
+        record.write(params.seed);
+        record.write(params.size_x);
+        record.write(params.size_y);
+        append(false);
+    }
+
+    void append(bool flush) {
+        {
+            std::scoped_lock lock(mutex);
+            if (failed) {
+                return;
+            }
+            pending.insert(pending.end(), record.data(), record.data() + record.size());
+            flush_requested |= flush || pending.size() >= FLUSH_THRESHOLD;
+            if (!flush_requested) {
+                return;
+            }
+        }
+        pending_ready.notify_one();
+    }
+
+    void writeLoop(const std::stop_token &stop) {
+        vector<uint8_t> writing;
+        for (bool stopping = false; !stopping;) {
+            {
+                std::unique_lock lock(mutex);
+                pending_ready.wait_for(lock, stop, std::chrono::seconds(1), [&] { return flush_requested; });
+                stopping = stop.stop_requested();
+                std::swap(writing, pending);
+                flush_requested = false;
+            }
+            if (writing.empty()) {
+                continue;
+            }
+            if (std::fwrite(writing.data(), 1, writing.size(), file) != writing.size()
+                || std::fflush(file) != 0) {
+                std::cerr << "Replay log write failed, recording stopped: " << std::strerror(errno) << "\n";
+                std::scoped_lock lock(mutex);
+                failed = true;
+                pending.clear();
+                return;
+            }
+            writing.clear();
+        }
+    }
+};
+
+/* Gra rozpoczęta z zapisanymi graczami. */
+struct RecordedGame {
+    map<PlayerId, Player> players;
+};
+
+/* Ruchy graczy zebrane przez zarządcę gry w kolejnej turze. */
+struct RecordedTurn {
+    vector<std::pair<PlayerId, client_mess_t>> messages;
+};
+
+/* Wyniki, z którymi zakończyła się nagrana gra. */
+struct RecordedGameEnd {
+    map<PlayerId, Score> scores;
+};
+
+using replay_record_t = std::variant<RecordedGame, RecordedTurn, RecordedGameEnd>;
+
+/**
+ * Odczytuje zapis rozgrywek z pliku.
+ *
+ * Nagrywanie mogło zostać przerwane w połowie rekordu (np. przez zabicie
+ * serwera), więc niepełny ostatni rekord kończy zapis tak jak koniec pliku,
+ * a `isTruncated()` mówi, czy tak się stało.
+ */
+class ReplayLog {
+public:
+    explicit ReplayLog(const string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error{(boost::format("Failed to open replay log %1%") % path).str()};
+        }
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        readHeader();
+    }
+
+    /**
+     * Parametry nagranych gier. Pozostałe pola (np. port)
+     * mają wartości domyślne.
+     */
+    [[nodiscard]] const ServerParams &params() const {
+        return game_params;
+    }
+
+    /**
+     * Zwraca kolejny rekord albo std::nullopt na końcu zapisu.
+     */
+    std::optional<replay_record_t> next() {
+        if (pos == bytes.size()) {
+            return std::nullopt;
+        }
+        size_t record_begin = pos;
+        try {
+            return readRecord();
+        } catch (Truncated &) {
+            pos = record_begin;
+            truncated = true;
+            return std::nullopt;
+        }
+    }
+
+    [[nodiscard]] bool isTruncated() const {
+        return truncated;
+    }
+
+private:
+    struct Truncated {};
+
+    vector<uint8_t> bytes;
+    size_t pos = 0;
+    bool truncated = false;
+    ServerParams game_params{};
+
+    void need(size_t len) const {
+        if (bytes.size() - pos < len) {
+            throw Truncated{};
+        }
+    }
+
+    uint8_t readU8() {
+        need(1);
+        return bytes[pos++];
+    }
+
+    template<typename T>
+    T readFixed() {
+        need(sizeof(T));
+        T res;
+        memcpy(&res, bytes.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return res;
+    }
+
+    uint16_t readU16() {
+        return be16toh(readFixed<uint16_t>());
+    }
+
+    uint32_t readU32() {
+        return be32toh(readFixed<uint32_t>());
+    }
+
+    uint64_t readU64() {
+        return be64toh(readFixed<uint64_t>());
+    }
+
+    uint64_t readVarint() {
+        uint64_t res = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readU8();
+            res |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return res;
+            }
+        }
+        throw std::invalid_argument("Replay log - varint too long.");
+    }
+
+    string readString() {
+        size_t len = readU8();
+        need(len);
+        string res((const char *) bytes.data() + pos, len);
+        pos += len;
+        return res;
+    }
+
+    void readHeader() {
+        try {
+            need(REPLAY_LOG_MAGIC.size());
+            if (!std::equal(REPLAY_LOG_MAGIC.begin(), REPLAY_LOG_MAGIC.end(), bytes.begin())) {
+                throw std::invalid_argument("Replay log - not a replay log.");
+            }
+            pos += REPLAY_LOG_MAGIC.size();
+            if (readU8() != REPLAY_LOG_VERSION) {
+                throw std::invalid_argument("Replay log - unsupported format version.");
+            }
+            game_params.bomb_timer = readU16();
+            game_params.players_count = readU8();
+            game_params.turn_duration = readU64();
+            game_params.explosion_radius = readU16();
+            game_params.initial_blocks = readU16();
+            game_params.game_length = readU16();
+            game_params.server_name = readString();
+            game_params.seed = readU32();
+            game_params.size_x = readU16();
+            game_params.size_y = readU16();
+        } catch (Truncated &) {
+            throw std::invalid_argument("Replay log - truncated header.");
+        }
+    }
+
+    replay_record_t readRecord() {
+        uint8_t type = readU8();
+        switch (type) {
+            case RECORD_GAME_STARTED: {
+                RecordedGame game;
+                for (uint64_t i = readVarint(); i > 0; --i) {
+                    PlayerId id{readU8()};
+                    auto name = readString();
+                    game.players[id] = Player{name, readString()};
+                }
+                return game;
+            }
+            case RECORD_TURN: {
+                RecordedTurn turn;
+                for (uint64_t i = readVarint(); i > 0; --i) {
+                    PlayerId id{readU8()};
+                    size_t consumed = 0;
+                    auto message = parseClientMessage(bytes.data() + pos, bytes.size() - pos, consumed);
+                    if (!message) {
+                        throw Truncated{};
+                    }
+                    pos += consumed;
+                    turn.messages.emplace_back(id, *message);
+                }
+                return turn;
+            }
+            case RECORD_GAME_ENDED: {
+                RecordedGameEnd end;
+                for (uint64_t i = readVarint(); i > 0; --i) {
+                    PlayerId id{readU8()};
+                    end.scores[id] = Score{readU32()};
+                }
+                return end;
+            }
+            default:
+                throw std::invalid_argument((boost::format(
+                        "Replay log - Unrecognised record type: %1%.") % (int) type).str());
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_REPLAY_LOG_H
@@ -0,0 +1,234 @@
+#ifndef ROBOTS_SERVER_RING_QUEUE_H
+#define ROBOTS_SERVER_RING_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+/**
+ * Ograniczona kolejka bez blokad (bufor cykliczny) dla wielu
+ * producentów i jednego konsumenta.
+ *
+ * Wstawianie i zdejmowanie elementów nie wymaga żadnego muteksu,
+ * a `pop()` usypia konsumenta na atomowym liczniku (futeksie),
+ * który producent podbija po każdym wstawieniu.
+ *
+ * Gdy kolejka jest pełna, `tryPush` zwraca `false`, a o dalszym
+ * losie konsumenta decyduje producent: może zamknąć kolejkę
+ * albo zażądać resynchronizacji (`requestResync`). Przy
+ * resynchronizacji konsument, zamiast zaległych elementów,
+ * woła ustawioną funkcję, która odbudowuje zawartość kolejki.
+ *
+ * Każdy element może mieć wagę (np. rozmiar wiadomości w bajtach);
+ * `weight()` zwraca łączną wagę elementów w kolejce.
+ */
+template<typename T>
+class RingQueue {
+public:
+    explicit RingQueue(size_t capacity, std::function<void()> push_listener = {})
+            : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+              cells(std::make_unique<Cell[]>(mask + 1)),
+              push_listener(std::move(push_listener)) {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Wstawia element o wadze `weight` na koniec kolejki.
+     * Zwraca `false`, jeśli kolejka jest pełna.
+     */
+    bool tryPush(T val, size_t weight = 0) {
+        Cell *cell;
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(val);
+        cell->weight = weight;
+        queued_weight.fetch_add(weight, std::memory_order_relaxed);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wakeConsumer();
+        return true;
+    }
+
+    /**
+     * Zdejmuje element z kolejki, o ile kolejka nie jest pusta.
+     * Operacja nieblokująca. Tylko dla konsumenta.
+     */
+    std::optional<T> tryPop() {
+        if (!isOpen()) {
+            throw std::runtime_error{"Client connection closed."};
+        }
+        if (resync_pending.load(std::memory_order_acquire)) {
+            resync();
+        }
+
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t) seq - (intptr_t) (pos + 1) < 0) {
+            return std::nullopt;
+        }
+
+        T first = std::move(cell->value);
+        cell->value = T{};
+        queued_weight.fetch_sub(cell->weight, std::memory_order_relaxed);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        return first;
+    }
+
+    /**
+     * Zdejmuje element z kolejki.
+     * Jeśli kolejka jest pusta, to wywołujący wątek
+     * zostaje uśpiony do czasu wstawienia elementu. Tylko dla konsumenta.
+     */
+    T pop() {
+        for (;;) {
+            uint32_t seen = signal.load(std::memory_order_acquire);
+            if (auto first = tryPop()) {
+                return std::move(*first);
+            }
+            signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * Usuwa wszystkie elementy z kolejki. Tylko dla konsumenta.
+     */
+    void clear() {
+        while (tryPopRaw()) {}
+    }
+
+    void close() {
+        is_open.store(false, std::memory_order_release);
+        wakeConsumer();
+    }
+
+    /**
+     * Przybliżona liczba elementów w kolejce, np. do statystyk.
+     * Przy równoległych operacjach wynik może być nieaktualny.
+     */
+    [[nodiscard]] size_t size() const {
+        size_t head = dequeue_pos.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    /**
+     * Przybliżona łączna waga elementów w kolejce.
+     */
+    [[nodiscard]] size_t weight() const {
+        return queued_weight.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool isOpen() const {
+        return is_open.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Zgłasza konsumentowi, że zaległe elementy należy
+     * porzucić i odbudować zawartość kolejki.
+     */
+    void requestResync() {
+        resync_pending.store(true, std::memory_order_release);
+        wakeConsumer();
+    }
+
+    [[nodiscard]] bool isResyncPending() const {
+        return resync_pending.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Kończy resynchronizację. Tylko dla konsumenta.
+     */
+    void finishResync() {
+        resync_pending.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Ustawia funkcję, którą konsument woła przy resynchronizacji.
+     * Funkcja powinna wyczyścić kolejkę, wstawić do niej
+     * nową zawartość i zakończyć resynchronizację.
+     */
+    void setResyncHandler(std::function<void(RingQueue &)> handler) {
+        std::unique_lock lock(resync_mutex);
+        resync_handler = std::move(handler);
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+        size_t weight = 0;
+    };
+
+    const size_t mask;
+    const std::unique_ptr<Cell[]> cells;
+    const std::function<void()> push_listener;
+
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    alignas(64) std::atomic<uint32_t> signal{0};
+    std::atomic<size_t> queued_weight{0};
+
+    std::atomic<bool> is_open{true};
+    std::atomic<bool> resync_pending{false};
+    std::mutex resync_mutex;
+    std::function<void(RingQueue &)> resync_handler;
+
+    bool tryPopRaw() {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t) seq - (intptr_t) (pos + 1) < 0) {
+            return false;
+        }
+        cell->value = T{};
+        queued_weight.fetch_sub(cell->weight, std::memory_order_relaxed);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void resync() {
+        std::function<void(RingQueue &)> handler;
+        {
+            std::unique_lock lock(resync_mutex);
+            handler = resync_handler;
+        }
+        if (handler) {
+            handler(*this);
+        } else {
+            clear();
+            finishResync();
+        }
+    }
+
+    void wakeConsumer() {
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+        if (push_listener) {
+            push_listener();
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_RING_QUEUE_H
@@ -0,0 +1,112 @@
+#ifndef ROBOTS_SERVER_ROBOT_INDEX_H
+#define ROBOTS_SERVER_ROBOT_INDEX_H
+
+#include <array>
+#include <memory_resource>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * Roboty na planszy pogrupowane według wierszy i kolumn.
+ *
+ * Każdy wiersz i każda kolumna ma listę stojących w niej robotów, połączoną
+ * przez węzły robotów (po jednym na identyfikator gracza). Postawienie,
+ * przesunięcie i usunięcie robota to więc stała liczba operacji, a wybuch
+ * przegląda tylko roboty ze swojego wiersza i swojej kolumny.
+ * Listy nie są uporządkowane.
+ */
+class RobotIndex {
+public:
+    RobotIndex(uint16_t size_x, uint16_t size_y)
+            : row_heads(size_y, NONE), column_heads(size_x, NONE) {}
+
+    /**
+     * Stawia robota gracza na polu `pos`, usuwając go z poprzedniego pola.
+     */
+    void place(PlayerId id, Position pos) {
+        auto &node = nodes[id.value];
+        if (node.present) {
+            unlink(node.row, &Node::row, row_heads[node.pos.y]);
+            unlink(node.column, &Node::column, column_heads[node.pos.x]);
+        }
+        node.pos = pos;
+        node.present = true;
+        link(id.value, node.row, &Node::row, row_heads[pos.y]);
+        link(id.value, node.column, &Node::column, column_heads[pos.x]);
+    }
+
+    void erase(PlayerId id) {
+        auto &node = nodes[id.value];
+        if (!node.present) {
+            return;
+        }
+        unlink(node.row, &Node::row, row_heads[node.pos.y]);
+        unlink(node.column, &Node::column, column_heads[node.pos.x]);
+        node.present = false;
+    }
+
+    /**
+     * Dopisuje do `out` roboty z wiersza `y` o współrzędnej x z [from, to].
+     */
+    void collectRow(uint16_t y, int from, int to, std::pmr::vector<PlayerId> &out) const {
+        for (uint16_t i = row_heads[y]; i != NONE; i = nodes[i].row.next) {
+            if (from <= nodes[i].pos.x && nodes[i].pos.x <= to) {
+                out.push_back(PlayerId{(uint8_t) i});
+            }
+        }
+    }
+
+    /**
+     * Dopisuje do `out` roboty z kolumny `x` o współrzędnej y z [from, to].
+     */
+    void collectColumn(uint16_t x, int from, int to, std::pmr::vector<PlayerId> &out) const {
+        for (uint16_t i = column_heads[x]; i != NONE; i = nodes[i].column.next) {
+            if (from <= nodes[i].pos.y && nodes[i].pos.y <= to) {
+                out.push_back(PlayerId{(uint8_t) i});
+            }
+        }
+    }
+
+private:
+    // Koniec listy; identyfikatory graczy są mniejsze.
+    static const uint16_t NONE = UINT8_MAX + 1;
+
+    struct Links {
+        uint16_t prev = NONE;
+        uint16_t next = NONE;
+    };
+
+    struct Node {
+        Position pos{0, 0};
+        bool present = false;
+        Links row;
+        Links column;
+    };
+
+    std::array<Node, UINT8_MAX + 1> nodes{};
+    std::vector<uint16_t> row_heads;
+    std::vector<uint16_t> column_heads;
+
+    void link(uint16_t i, Links &links, Links Node::*list, uint16_t &head) {
+        links = {NONE, head};
+        if (head != NONE) {
+            (nodes[head].*list).prev = i;
+        }
+        head = i;
+    }
+
+    void unlink(Links &links, Links Node::*list, uint16_t &head) {
+        if (links.prev != NONE) {
+            (nodes[links.prev].*list).next = links.next;
+        } else {
+            head = links.next;
+        }
+        if (links.next != NONE) {
+            (nodes[links.next].*list).prev = links.prev;
+        }
+        links = {};
+    }
+};
+
+#endif //ROBOTS_SERVER_ROBOT_INDEX_H
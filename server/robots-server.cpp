@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <tuple>
 
@@ -13,8 +14,12 @@
 
 #include <boost/program_options.hpp>
 
+#include "async-client-acceptor.h"
 #include "client-acceptor.h"
 #include "game-manager.h"
+#include "game-replay.h"
+#include "lobby.h"
+#include "metrics.h"
 
 using std::string;
 using std::vector;
@@ -37,6 +42,13 @@ namespace {
      * opcje programu zostały podane.
      */
     void checkOptions(const variables_map &vm) {
+        // Odtwarzane gry mają parametry z zapisu.
+        if (vm.count("replay")) {
+            if (vm.count("record")) {
+                throw std::invalid_argument("Options record and replay are exclusive");
+            }
+            return;
+        }
         for (const string &s: SERVER_PARAMS) {
             if (!vm.count(s)) {
                 throw std::invalid_argument(
@@ -77,6 +89,13 @@ namespace {
         throw std::invalid_argument{"Program option out of range.\n"};
     }
 
+    uint32_t parse(int64_t val) {
+        if (0 <= val && val <= UINT32_MAX) {
+            return (uint32_t) val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
     uint32_t parsePositive(int64_t val) {
         if (0 < val && val <= UINT32_MAX) {
             return (uint32_t) val;
@@ -102,6 +121,67 @@ namespace {
         throw std::invalid_argument{"Program option out of range.\n"};
     }
 
+    int parseBacklog(int32_t val) {
+        if (0 < val) {
+            return val;
+        }
+        throw std::invalid_argument{"Program option out of range.\n"};
+    }
+
+    OverrunPolicy parseOverrunPolicy(const string &val) {
+        if (val == "catch-up") {
+            return OverrunPolicy::CATCH_UP;
+        } else if (val == "skip") {
+            return OverrunPolicy::SKIP;
+        }
+        throw std::invalid_argument{"Program option invalid.\n"};
+    }
+
+    OverflowPolicy parseOverflowPolicy(const string &val) {
+        if (val == "resync") {
+            return OverflowPolicy::RESYNC;
+        } else if (val == "disconnect") {
+            return OverflowPolicy::DISCONNECT;
+        }
+        throw std::invalid_argument{"Program option invalid.\n"};
+    }
+
+    /**
+     * Parametry pracy serwera, które nie wpływają na przebieg gry.
+     */
+    void parseRuntimeParams(const variables_map &vm, ServerParams &p) {
+        p.board_memory_budget = parse(vm["board-memory-budget"].as<string>());
+        p.overrun_policy = parseOverrunPolicy(vm["overrun-policy"].as<string>());
+        p.print_stats = vm["print-stats"].as<bool>();
+        p.async_io = vm["async"].as<bool>();
+        p.io_threads = parse(vm["io-threads"].as<int32_t>());
+        p.rooms = parsePositive(vm["rooms"].as<int32_t>());
+        p.game_threads = parse(vm["game-threads"].as<int32_t>());
+        p.tick_threads = parsePositive(vm["tick-threads"].as<int32_t>());
+        p.queue_capacity = parsePositive(vm["queue-capacity"].as<string>());
+        p.queue_bytes_limit = parse(vm["queue-bytes-limit"].as<string>());
+        // Polityki klas klientów domyślnie są równe wspólnej --overflow-policy.
+        auto overflow_policy = parseOverflowPolicy(vm["overflow-policy"].as<string>());
+        p.player_overflow_policy = vm.count("player-overflow-policy")
+                                   ? parseOverflowPolicy(vm["player-overflow-policy"].as<string>())
+                                   : overflow_policy;
+        p.spectator_overflow_policy = vm.count("spectator-overflow-policy")
+                                      ? parseOverflowPolicy(vm["spectator-overflow-policy"].as<string>())
+                                      : overflow_policy;
+        p.input_rate_limit = parse(vm["input-rate-limit"].as<int64_t>());
+        p.metrics_port = parse(vm["metrics-port"].as<int32_t>());
+        p.listen_backlog = parseBacklog(vm["listen-backlog"].as<int32_t>());
+        p.accept_threads = parsePositive(vm["accept-threads"].as<int32_t>());
+        p.connection_pool_size = parse(vm["connection-pool"].as<string>());
+        if (vm.count("record")) {
+            p.record_path = vm["record"].as<string>();
+        }
+        if (vm.count("export")) {
+            p.export_path = vm["export"].as<string>();
+        }
+        p.export_segment_size = parsePositive(vm["export-segment-size"].as<int64_t>());
+    }
+
     ServerParams parseParams(const variables_map &vm) {
         ServerParams p;
 
@@ -116,10 +196,109 @@ namespace {
         p.seed = parsePositive(vm["seed"].as<int64_t>());
         p.size_x = parsePositive(vm["size-x"].as<int32_t>());
         p.size_y = parsePositive(vm["size-y"].as<int32_t>());
+        parseRuntimeParams(vm, p);
 
         return p;
     }
 
+    /**
+     * Parametry odtwarzania: gra przebiega według parametrów z zapisu.
+     * Bez --port tury są liczone bez przerw i bez sieci, a z --port
+     * obserwatorzy oglądają je w tempie nagrania (albo --turn-duration).
+     */
+    ServerParams parseReplayParams(const variables_map &vm, const ServerParams &recorded) {
+        ServerParams p = recorded;
+
+        p.port = vm.count("port") ? parsePositive(vm["port"].as<int32_t>()) : 0;
+        if (vm.count("turn-duration")) {
+            p.turn_duration = parsePositive(vm["turn-duration"].as<string>());
+        }
+        parseRuntimeParams(vm, p);
+        p.rooms = 1;
+        p.spectators_only = true;
+
+        return p;
+    }
+
+    /**
+     * Parametry pokoju o numerze `room`. Każdy pokój ma własne ziarno
+     * losowania, żeby gry w pokojach nie przebiegały tak samo.
+     */
+    ServerParams roomParams(const ServerParams &params, uint16_t room) {
+        ServerParams p = params;
+        p.seed = params.seed + room;
+        return p;
+    }
+
+    /**
+     * Nagrywarki rozgrywek kolejnych pokoi. Przy wielu pokojach
+     * każdy pokój nagrywa do pliku z dopisanym numerem pokoju.
+     */
+    vector<std::shared_ptr<ReplayRecorder>> createRecorders(const ServerParams &params) {
+        vector<std::shared_ptr<ReplayRecorder>> recorders(params.rooms);
+        if (params.record_path.empty()) {
+            return recorders;
+        }
+        for (uint16_t i = 0; i < params.rooms; ++i) {
+            auto path = params.rooms == 1 ? params.record_path
+                                          : params.record_path + "." + std::to_string(i);
+            recorders[i] = std::make_shared<ReplayRecorder>(path, roomParams(params, i));
+        }
+        return recorders;
+    }
+
+    /**
+     * Eksport rozgrywek kolejnych pokoi. Przy wielu pokojach
+     * każdy pokój ma własne archiwum z dopisanym numerem pokoju.
+     */
+    vector<std::shared_ptr<GameExporter>> createExporters(const ServerParams &params) {
+        vector<std::shared_ptr<GameExporter>> exporters(params.rooms);
+        if (params.export_path.empty()) {
+            return exporters;
+        }
+        for (uint16_t i = 0; i < params.rooms; ++i) {
+            auto path = params.rooms == 1 ? params.export_path
+                                          : params.export_path + "." + std::to_string(i);
+            exporters[i] = std::make_shared<GameExporter>(path, params.export_segment_size);
+        }
+        return exporters;
+    }
+
+    void runReplay(ReplayLog log, const ServerParams &params, const std::shared_ptr<Server> &server) {
+        bool paced = params.port != 0;
+        if (paced) {
+            // Odtwarzanie dla obserwatorów zaczyna się, gdy jest już ktoś, kto je ogląda.
+            server->waitForClient();
+        }
+        auto summary = GameReplay{std::move(log), params, server}.run(paced);
+        std::cout << boost::format("Replayed %1% games, %2% turns in %3$.3f s (%4$.0f turns/s).\n")
+                     % summary.games % summary.turns % summary.seconds
+                     % ((double) summary.turns / std::max(summary.seconds, 1e-9));
+        if (summary.truncated) {
+            std::cerr << "Warning: the replay log ends with an incomplete record.\n";
+        }
+    }
+
+    /**
+     * Zwraca `requested` lub liczbę rdzeni procesora, gdy `requested` = 0.
+     */
+    size_t threadsOrCores(uint16_t requested) {
+        if (requested > 0) {
+            return requested;
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void runContext(boost::asio::io_context &context) {
+        try {
+            context.run();
+        } catch (std::exception &e) {
+            std::cerr << "Worker thread failed. Reason:\n";
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
     void printHelp(const options_description &desc) {
         std::cout << "Usage: " << program_invocation_name << "\n";
         std::cout << desc;
@@ -151,7 +330,72 @@ int main(int ac, char *av[]) {
             ("size-x,x", value<int32_t>(),
              "Size of board in X direction. In (0, UINT16_MAX].")
             ("size-y,y", value<int32_t>(),
-             "Size of board in Y direction. In (0, UINT16_MAX].");
+             "Size of board in Y direction. In (0, UINT16_MAX].")
+            ("board-memory-budget", value<string>()->default_value(
+                    std::to_string(DEFAULT_BOARD_MEMORY_BUDGET)),
+             "Boards whose block bitmap fits in this many bytes use a dense grid, "
+             "larger ones a sorted set. In [0, UINT64_MAX].")
+            ("overrun-policy", value<string>()->default_value("catch-up"),
+             "What to do when a turn takes longer than turn-duration: "
+             "'catch-up' plays late turns immediately, 'skip' waits for the next turn slot.")
+            ("print-stats", bool_switch(),
+             "Print message encode/send counters and turn lateness to stderr after every game.")
+            ("async", bool_switch(),
+             "Serve all connections asynchronously on a few I/O threads "
+             "instead of two threads per client.")
+            ("io-threads", value<int32_t>()->default_value(0),
+             "Number of I/O threads in --async mode. 0 means one per CPU core. In [0, UINT16_MAX].")
+            ("rooms", value<int32_t>()->default_value(1),
+             "Number of independent games hosted by this process; room i uses seed + i. In (0, UINT16_MAX].")
+            ("game-threads", value<int32_t>()->default_value(0),
+             "Number of threads computing turns of all rooms when --rooms > 1. "
+             "0 means one per CPU core. In [0, UINT16_MAX].")
+            ("tick-threads", value<int32_t>()->default_value(1),
+             "Number of threads computing the bomb explosions of one turn, including the game "
+             "thread. Helps on huge boards with many bombs; with --rooms the rooms share the threads. "
+             "In (0, UINT16_MAX].")
+            ("queue-capacity", value<string>()->default_value(std::to_string(DEFAULT_QUEUE_CAPACITY)),
+             "Maximum number of messages waiting to be sent to one client. "
+             "Values below 512 are raised to 512.")
+            ("overflow-policy", value<string>()->default_value("resync"),
+             "What to do with a client whose message queue is full: "
+             "'resync' drops the backlog and sends the current game state, 'disconnect' drops the client.")
+            ("player-overflow-policy", value<string>(),
+             "Overrides --overflow-policy for clients playing in the current game.")
+            ("spectator-overflow-policy", value<string>(),
+             "Overrides --overflow-policy for clients only watching the game.")
+            ("queue-bytes-limit", value<string>()->default_value("0"),
+             "Maximum number of bytes waiting to be sent to one client; exceeding it "
+             "is handled like a full queue. 0 means no limit. In [0, UINT64_MAX].")
+            ("input-rate-limit", value<int64_t>()->default_value(0),
+             "Maximum number of moves per second accepted from one client; moves over "
+             "the limit are dropped and counted. 0 means no limit. In [0, UINT32_MAX].")
+            ("metrics-port", value<int32_t>()->default_value(0),
+             "Serve Prometheus metrics over HTTP on this port. 0 disables the endpoint. In [0, UINT16_MAX].")
+            ("listen-backlog", value<int32_t>()->default_value(DEFAULT_LISTEN_BACKLOG),
+             "Length of the queue of connections waiting to be accepted. "
+             "The kernel caps it at net.core.somaxconn. In (0, INT32_MAX].")
+            ("accept-threads", value<int32_t>()->default_value(1),
+             "Number of threads accepting connections, each with its own listening socket "
+             "on the same port (SO_REUSEPORT). In (0, UINT16_MAX].")
+            ("connection-pool", value<string>()->default_value(std::to_string(DEFAULT_CONNECTION_POOL_SIZE)),
+             "Number of connection objects with receive buffers allocated at startup and "
+             "reused after clients disconnect. Without --async only. In [0, UINT64_MAX].")
+            ("record", value<string>(),
+             "Record the parameters and player moves of every game to this file (overwriting it), "
+             "so that the games can be replayed. With --rooms, room i records to <file>.i.")
+            ("export", value<string>(),
+             "Export the messages of every game to an archive for analytics: segment files "
+             "<path>.NNNNNN.seg and the index <path>.idx, read with robots-export-reader. "
+             "With --rooms, room i exports to <path>.i.")
+            ("export-segment-size", value<int64_t>()->default_value(DEFAULT_EXPORT_SEGMENT_SIZE),
+             "Size in bytes after which the export starts a new segment file. In (0, UINT32_MAX].")
+            ("replay", value<string>(),
+             "Replay the games recorded in this file instead of hosting new ones; the game "
+             "options are taken from the recording. Without --port the turns are computed "
+             "back to back without networking and the throughput is printed. With --port "
+             "clients can watch the replay at the recorded pace (or --turn-duration); it starts "
+             "when the first client connects and the server keeps running after it ends.");
 
     variables_map vm;
     ServerParams params;
@@ -160,7 +404,9 @@ int main(int ac, char *av[]) {
         notify(vm);
 
         checkOptions(vm);
-        params = parseParams(vm);
+        if (!vm.count("replay")) {
+            params = parseParams(vm);
+        }
     } catch (std::exception &e) {
         printHelp(desc);
         exit(EXIT_FAILURE);
@@ -171,24 +417,140 @@ int main(int ac, char *av[]) {
         exit(EXIT_SUCCESS);
     }
 
-    auto thread_pool = std::make_shared<boost::asio::thread_pool>(MAX_THREADS);
+    std::optional<ReplayLog> replay_log;
+    vector<std::shared_ptr<ReplayRecorder>> recorders;
+    vector<std::shared_ptr<GameExporter>> exporters;
+    try {
+        if (vm.count("replay")) {
+            replay_log.emplace(vm["replay"].as<string>());
+            params = parseReplayParams(vm, replay_log->params());
+        }
+        recorders = createRecorders(params);
+        exporters = createExporters(params);
+    } catch (std::invalid_argument &e) {
+        std::cerr << e.what() << "\n";
+        printHelp(desc);
+        exit(EXIT_FAILURE);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (params.metrics_port != 0) {
+        // Metryki są obsługiwane przez osobny wątek,
+        // niezależny od obsługi klientów i liczenia tur.
+        try {
+            auto endpoint = std::make_shared<MetricsEndpoint>(params.metrics_port);
+            std::thread([endpoint] { endpoint->run(); }).detach();
+        } catch (std::exception &e) {
+            std::cerr << "Metrics endpoint failed. Reason:\n";
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
     auto context = std::make_shared<boost::asio::io_context>();
-    auto server = std::make_shared<Server>(params);
+    std::shared_ptr<boost::asio::thread_pool> thread_pool;
+    vector<std::unique_ptr<AsyncClientAcceptor>> async_acceptors;
+    // Przy kilku akceptorach każdy ma własne gniazdo nasłuchujące na tym samym porcie.
+    ListenParams listen{params.port, params.listen_backlog, params.accept_threads > 1};
+
+    // Przy wielu pokojach tury wszystkich gier liczy wspólna pula wątków.
+    boost::asio::io_context game_context;
+    vector<std::shared_ptr<Room>> rooms;
+    vector<std::shared_ptr<Server>> servers;
+    if (params.rooms == 1) {
+        servers.push_back(std::make_shared<Server>(params));
+    } else {
+        auto tick_pool = std::make_shared<TickPool>(params.tick_threads);
+        for (uint16_t i = 0; i < params.rooms; ++i) {
+            rooms.push_back(std::make_shared<Room>(roomParams(params, i), game_context, recorders[i], tick_pool));
+            servers.push_back(rooms.back()->getServer());
+        }
+    }
+    for (size_t i = 0; i < servers.size(); ++i) {
+        servers[i]->setExporter(exporters[i]);
+    }
+    auto lobby = std::make_shared<Lobby>(servers);
 
-    boost::asio::post(*thread_pool, [=] {
+    if (params.port == 0) {
+        // Odtwarzanie bez obserwatorów nie przyjmuje połączeń.
+    } else if (params.async_io) {
+        // Wszystkie połączenia są obsługiwane asynchronicznie
+        // przez kilka wątków wykonujących `io_context::run()`.
+        size_t io_threads = threadsOrCores(params.io_threads);
+        thread_pool = std::make_shared<boost::asio::thread_pool>(io_threads);
         try {
-            ClientAcceptor{params.port, server, context, thread_pool}.run();
+            for (uint16_t i = 0; i < params.accept_threads; ++i) {
+                async_acceptors.push_back(std::make_unique<AsyncClientAcceptor>(listen, lobby, *context,
+                                                                                params.input_rate_limit));
+                async_acceptors.back()->start();
+            }
         } catch (std::exception &e) {
             std::cerr << "Client acceptor failed. Reason:\n";
             std::cerr << e.what() << "\n";
             std::exit(EXIT_FAILURE);
         }
-    });
 
-    try {
-        GameManager{params, server}.run();
-    } catch (std::exception &e) {
-        std::cerr << e.what() << "\n";
-        std::exit(EXIT_FAILURE);
+        for (size_t i = 0; i < io_threads; ++i) {
+            boost::asio::post(*thread_pool, [=] {
+                runContext(*context);
+            });
+        }
+    } else {
+        thread_pool = std::make_shared<boost::asio::thread_pool>(MAX_THREADS);
+        auto connections = std::make_shared<ConnectionPool>(*context, params.connection_pool_size);
+        for (uint16_t i = 0; i < params.accept_threads; ++i) {
+            boost::asio::post(*thread_pool, [=] {
+                try {
+                    ClientAcceptor{listen, lobby, context, thread_pool, connections, params.input_rate_limit}.run();
+                } catch (std::exception &e) {
+                    std::cerr << "Client acceptor failed. Reason:\n";
+                    std::cerr << e.what() << "\n";
+                    std::exit(EXIT_FAILURE);
+                }
+            });
+        }
+    }
+
+    if (replay_log) {
+        try {
+            runReplay(std::move(*replay_log), params, servers.front());
+        } catch (std::exception &e) {
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        if (params.port == 0) {
+            // Eksport odtworzonych gier musi trafić do archiwum przed wyjściem z programu.
+            servers.front()->setExporter(nullptr);
+            exporters.clear();
+            std::exit(EXIT_SUCCESS);
+        }
+        // Obserwatorzy dostają zaległe tury i zostają w lobby, aż serwer zostanie zatrzymany.
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+
+    if (rooms.empty()) {
+        try {
+            GameManager{params, servers.front(), recorders.front()}.run();
+        } catch (std::exception &e) {
+            std::cerr << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    for (const auto &room: rooms) {
+        room->start();
+    }
+    auto work = boost::asio::make_work_guard(game_context);
+    size_t game_threads = threadsOrCores(params.game_threads);
+    boost::asio::thread_pool game_pool(game_threads - 1);
+    for (size_t i = 1; i < game_threads; ++i) {
+        boost::asio::post(game_pool, [&] {
+            runContext(game_context);
+        });
     }
+    runContext(game_context);
 }
@@ -1,16 +1,46 @@
 #ifndef ROBOTS_SERVER_SERVER_H
 #define ROBOTS_SERVER_SERVER_H
 
+#include <memory_resource>
 #include <optional>
 #include <utility>
 #include <semaphore>
+#include <shared_mutex>
 #include <queue>
 
-#include "blocking-queue.h"
+#include "board-snapshot.h"
+#include "connection-pool.h"
+#include "game-export.h"
+#include "input-slot.h"
+#include "listener.h"
 #include "messages.h"
+#include "stats.h"
+#include "turn-scheduler.h"
 
 using std::queue;
 
+/* Domyślny budżet pamięci (w bajtach) na gęstą reprezentację planszy. */
+const uint64_t DEFAULT_BOARD_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+/* Domyślna pojemność (w wiadomościach) kolejki do klienta. */
+const size_t DEFAULT_QUEUE_CAPACITY = 4096;
+/*
+ * Najmniejsza pojemność kolejki, w której mieści się historia
+ * wiadomości: HELLO, komplet ACCEPTED_PLAYER i obraz gry.
+ */
+const size_t MIN_QUEUE_CAPACITY = 512;
+
+/**
+ * Co zrobić z klientem, który nie nadąża odbierać wiadomości
+ * i którego kolejka się zapełniła.
+ */
+enum class OverflowPolicy {
+    // Porzuć zaległe wiadomości i wyślij klientowi aktualny stan gry.
+    RESYNC,
+    // Rozłącz klienta.
+    DISCONNECT
+};
+
 struct ServerParams {
     uint16_t bomb_timer;
     uint8_t players_count;
@@ -23,6 +53,36 @@ struct ServerParams {
     uint32_t seed;
     uint16_t size_x;
     uint16_t size_y;
+    uint64_t board_memory_budget = DEFAULT_BOARD_MEMORY_BUDGET;
+    OverrunPolicy overrun_policy = OverrunPolicy::CATCH_UP;
+    bool print_stats = false;
+    bool async_io = false;
+    uint16_t io_threads = 0;
+    uint16_t rooms = 1;
+    uint16_t game_threads = 0;
+    // Liczba wątków liczących wybuchy bomb jednej tury (razem z wątkiem gry).
+    uint16_t tick_threads = 1;
+    size_t queue_capacity = DEFAULT_QUEUE_CAPACITY;
+    // Limit bajtów czekających w kolejce klienta; 0 oznacza brak limitu.
+    uint64_t queue_bytes_limit = 0;
+    OverflowPolicy player_overflow_policy = OverflowPolicy::RESYNC;
+    OverflowPolicy spectator_overflow_policy = OverflowPolicy::RESYNC;
+    // Limit ruchów na sekundę od jednego klienta; 0 oznacza brak limitu.
+    uint32_t input_rate_limit = 0;
+    // Port punktu dostępowego z metrykami; 0 oznacza, że jest wyłączony.
+    uint16_t metrics_port = 0;
+    int listen_backlog = DEFAULT_LISTEN_BACKLOG;
+    // Liczba wątków (akceptorów z SO_REUSEPORT) przyjmujących połączenia.
+    uint16_t accept_threads = 1;
+    // Liczba połączeń przygotowanych zawczasu w trybie synchronicznym.
+    size_t connection_pool_size = DEFAULT_CONNECTION_POOL_SIZE;
+    // Plik, do którego zarządca gry nagrywa rozgrywki; pusty oznacza brak nagrywania.
+    string record_path{};
+    // Serwer odtwarza nagrane gry, więc klienci mogą je tylko obserwować.
+    bool spectators_only = false;
+    // Ścieżka archiwum gier do analizy; pusta oznacza brak eksportu.
+    string export_path{};
+    uint32_t export_segment_size = DEFAULT_EXPORT_SEGMENT_SIZE;
 };
 
 /**
@@ -33,10 +93,22 @@ struct ServerParams {
  * udostępniają ostatnią przeczytaną
  * wiadomość zarządcy gry, a zarządca może
  * rozgłosić komunikat do wszystkich połączonych klientów.
+ *
+ * Stan lobby i gry chroni `mutex`, a rejestr klientów (ich kolejki
+ * i sloty na ruchy) osobny `registry_mutex`, zajmowany na wyłączność
+ * tylko przy dołączaniu i odłączaniu klienta oraz zmianie jego protokołu. Zapis ruchu i rozgłaszanie
+ * wiadomości tylko czytają rejestr, więc nie czekają na siebie nawzajem.
+ * Blokady są zawsze zajmowane w kolejności: `mutex`, `registry_mutex`.
+ *
+ * Każdy klient ma własne kodowanie wiadomości (wersję protokołu),
+ * a każda wiadomość jest kodowana raz dla wszystkich klientów z tym samym kodowaniem.
  */
-class Server {
+class Server : public std::enable_shared_from_this<Server> {
 public:
-    explicit Server(ServerParams params) : params(std::move(params)) {
+    explicit Server(ServerParams params)
+            : params(std::move(params)),
+              hello_message(std::make_shared<EncodedMessage>(helloMessage(this->params))),
+              protocol_selected_messages(encodeProtocolSelected()) {
         initializeMessageHistory();
     }
 
@@ -52,13 +124,53 @@ public:
     /**
      * Tworzy kolejkę do przesyłania danemu
      * klientowi wiadomości.
+     * `push_listener` jest wołany po każdym wstawieniu do kolejki.
+     */
+    std::shared_ptr<server_mess_queue_t> createMessageQueue(client_id_t client_id,
+                                                            std::function<void()> push_listener = {}) {
+        auto message_queue = std::make_shared<server_mess_queue_t>(
+                std::max(params.queue_capacity, MIN_QUEUE_CAPACITY), std::move(push_listener));
+        attachMessageQueue(client_id, message_queue);
+        return message_queue;
+    }
+
+    /**
+     * Podłącza do serwera istniejącą kolejkę klienta,
+     * np. przeniesionego z innego pokoju razem z uzgodnionym wcześniej kodowaniem.
+     * Klient otrzymuje najpierw całą historię wiadomości.
      */
-    std::shared_ptr<server_mess_queue_t> createMessageQueue(client_id_t client_id) {
+    void attachMessageQueue(client_id_t client_id,
+                            const std::shared_ptr<server_mess_queue_t> &message_queue,
+                            Encoding encoding = Encoding::V1) {
         std::unique_lock lock(mutex);
+        std::unique_lock registry_lock(registry_mutex);
 
-        assert(!client_message_queues.contains(client_id));
-        client_message_queues[client_id] = std::make_shared<server_mess_queue_t>(message_history);
-        return client_message_queues[client_id];
+        assert(!clients.contains(client_id));
+        std::weak_ptr<Server> weak_self = weak_from_this();
+        message_queue->setResyncHandler([weak_self, client_id](server_mess_queue_t &q) {
+            if (auto self = weak_self.lock()) {
+                self->resyncClient(client_id, q);
+            }
+        });
+        if (message_queue->isResyncPending() || !pushHistory(*message_queue, encoding)) {
+            // Historię wstawi do kolejki dopiero konsument, przy resynchronizacji.
+            message_queue->requestResync();
+        }
+        auto &client = clients[client_id];
+        client.message_queue = message_queue;
+        client.encoding = encoding;
+        ++encoding_users[(size_t) encoding];
+        players_joined.notify_all();
+    }
+
+    /**
+     * Czeka, aż do serwera podłączy się jakikolwiek klient.
+     */
+    void waitForClient() {
+        std::unique_lock lock(mutex);
+
+        // Rejestr klientów zmienia się tylko pod obiema blokadami, więc `mutex` wystarcza do odczytu.
+        players_joined.wait(lock, [&] { return !clients.empty(); });
     }
 
     /**
@@ -66,40 +178,115 @@ public:
      * struktury danych.
      */
     void eraseClient(client_id_t client_id) {
+        if (auto message_queue = detachClient(client_id)) {
+            message_queue->close();
+        }
+    }
+
+    /**
+     * Odłącza klienta od serwera, nie zamykając jego kolejki.
+     * Zwraca kolejkę klienta (o ile istniała).
+     */
+    std::shared_ptr<server_mess_queue_t> detachClient(client_id_t client_id) {
         std::unique_lock lock(mutex);
 
-        players.erase(player_ids[client_id]);
-        player_ids.erase(client_id);
+        if (auto it = player_ids.find(client_id); it != player_ids.end()) {
+            players.erase(it->second);
+            player_ids.erase(it);
+        }
+
+        std::unique_lock registry_lock(registry_mutex);
+        std::shared_ptr<server_mess_queue_t> message_queue;
+        if (auto it = clients.find(client_id); it != clients.end()) {
+            message_queue = it->second.message_queue;
+            --encoding_users[(size_t) it->second.encoding];
+            clients.erase(it);
+        }
+        return message_queue;
+    }
+
+    /**
+     * Przełącza klienta na kodowanie uzgodnione z jego prośbą.
+     *
+     * Zaległe wiadomości w starym kodowaniu są porzucane, a klient dostaje
+     * potwierdzenie protokołu i całą historię od nowa, jak przy resynchronizacji.
+     */
+    void selectProtocol(client_id_t client_id, const SelectProtocol &request) {
+        std::unique_lock lock(mutex);
+        std::unique_lock registry_lock(registry_mutex);
 
-        if (client_message_queues.contains(client_id)) {
-            client_message_queues[client_id]->close();
-            client_message_queues.erase(client_id);
+        auto it = clients.find(client_id);
+        if (it == clients.end() || !it->second.message_queue->isOpen()) {
+            return;
         }
+        auto &client = it->second;
+        auto encoding = negotiateEncoding(request);
+        --encoding_users[(size_t) client.encoding];
+        ++encoding_users[(size_t) encoding];
+        client.encoding = encoding;
+        client.protocol_switch_pending = true;
+        client.message_queue->requestResync();
+    }
+
+    /**
+     * Kodowanie wiadomości uzgodnione z klientem.
+     */
+    Encoding encodingOf(client_id_t client_id) {
+        std::shared_lock registry_lock(registry_mutex);
+
+        auto it = clients.find(client_id);
+        return it == clients.end() ? Encoding::V1 : it->second.encoding;
+    }
+
+    /**
+     * Sprawdza, czy w lobby jest jeszcze wolne miejsce dla gracza.
+     */
+    bool canAcceptPlayer() {
+        std::unique_lock lock(mutex);
 
-        last_messages_from_clients.erase(client_id);
+        return is_lobby && player_ids.size() < params.players_count;
+    }
+
+    bool isPlayer(client_id_t client_id) {
+        std::unique_lock lock(mutex);
+
+        return player_ids.contains(client_id);
     }
 
     /**
      * Aktualizuje ostatnio odebraną wiadomość od danego klienta.
+     * Nie czeka na rozgłaszanie wiadomości ani na zarządcę gry.
      */
     void setLastMessage(client_id_t id, const client_mess_t &message) {
-        std::unique_lock lock(mutex);
+        std::shared_lock registry_lock(registry_mutex);
 
-        last_messages_from_clients[id] = message;
+        if (auto it = clients.find(id); it != clients.end()) {
+            it->second.last_message.store(message);
+        }
     }
 
     /**
-     * Tworzy mapę najnowszych wiadomości od klientów,
+     * Tworzy mapę najnowszych wiadomości od graczy,
      * przysłanych w czasie trwania aktualnej tury.
+     * Wiadomości od klientów, którzy nie są graczami, są pomijane.
      */
-    map<PlayerId, client_mess_t> collectLastMessagesFromClients() {
-        std::unique_lock lock(mutex);
-
-        map<PlayerId, client_mess_t> messages;
-        for (const auto &[client_id, last_message] : last_messages_from_clients) {
-            messages[player_ids[client_id]] = last_message;
+    std::pmr::map<PlayerId, client_mess_t>
+    collectLastMessagesFromClients(std::pmr::memory_resource *resource) {
+        std::unique_lock lock(mutex, std::defer_lock);
+        {
+            ScopedTimer timer{latency_stats.collect_lock_wait_us};
+            lock.lock();
+        }
+        std::shared_lock registry_lock(registry_mutex);
+
+        std::pmr::map<PlayerId, client_mess_t> messages{resource};
+        for (const auto &[client_id, player_id]: player_ids) {
+            if (auto it = clients.find(client_id); it != clients.end()) {
+                if (auto message = it->second.last_message.take()) {
+                    messages.emplace(player_id, *message);
+                }
+            }
         }
-        last_messages_from_clients.clear();
 
         return messages;
     }
@@ -107,7 +294,7 @@ public:
     void tryAcceptPlayer(client_id_t client_id, const string &name, const string &address) {
         std::unique_lock lock(mutex);
 
-        if (is_lobby) {
+        if (is_lobby && !params.spectators_only) {
             if (!player_ids.contains(client_id) && player_ids.size() < params.players_count) {
                 // Zaakceptuj nowego gracza.
                 auto player_id = PlayerId{(uint8_t) (player_ids.size())};
@@ -117,8 +304,13 @@ public:
                 players[player_id] = player;
 
                 // Powiadamiom wszystkich klientów, że nowy gracz dołączył do Lobby.
-                broadcast(server_mess_t{AcceptedPlayer{player_id, player}});
+                auto message = std::make_shared<EncodedMessage>(AcceptedPlayer{player_id, player});
+                message_history.push_back(message);
+                broadcast(*message);
                 players_joined.notify_all();
+                if (players_ready_listener && players.size() == params.players_count) {
+                    players_ready_listener();
+                }
             }
         } // Wpp ignoruj wiadomość.
     }
@@ -137,88 +329,391 @@ public:
         return players;
     }
 
+    /**
+     * Nieblokujący odpowiednik `waitForPlayersToStartGame`.
+     * Rozpoczyna grę, o ile zebrało się już params.players_count graczy.
+     */
+    std::optional<map<PlayerId, Player>> tryStartGame() {
+        std::unique_lock lock(mutex);
+
+        if (!is_lobby || players.size() != params.players_count) {
+            return std::nullopt;
+        }
+        startGame();
+        return players;
+    }
+
+    /**
+     * Rozpoczyna odtwarzaną grę z graczami z zapisu, z pominięciem lobby.
+     */
+    void startRecordedGame(const map<PlayerId, Player> &recorded_players) {
+        std::unique_lock lock(mutex);
+
+        players = recorded_players;
+        player_ids.clear();
+        startGame();
+    }
+
+    // --- Przekaźnik: stan lobby i gry pochodzi od serwera źródłowego. ---
+
+    /**
+     * Dopisuje do lobby gracza zaakceptowanego przez serwer źródłowy.
+     */
+    void relayAcceptedPlayer(const std::shared_ptr<EncodedMessage> &message) {
+        encodeForClients(*message);
+        const auto &accepted = std::get<AcceptedPlayer>(message->message());
+
+        std::unique_lock lock(mutex);
+        players[accepted.id] = accepted.player;
+        message_history.push_back(message);
+        broadcast(*message);
+    }
+
+    /**
+     * Rozpoczyna grę rozpoczętą przez serwer źródłowy.
+     */
+    void relayGameStarted(const std::shared_ptr<EncodedMessage> &message) {
+        encodeForClients(*message);
+
+        std::unique_lock lock(mutex);
+        players = std::get<GameStarted>(message->message()).players;
+        player_ids.clear();
+        startGame(message);
+    }
+
+    /**
+     * Rozgłasza obraz gry, od którego serwer źródłowy zaczął przesyłać
+     * trwającą grę, i przyjmuje go jako obraz planszy dla kolejnych klientów.
+     */
+    void relaySnapshot(EncodedMessage message) {
+        encodeForClients(message);
+
+        std::unique_lock lock(mutex);
+        snapshot.restore(std::get<Snapshot>(message.message()));
+        snapshot_message.reset();
+        has_snapshot = true;
+        broadcast(message);
+    }
+
+    /**
+     * Zaczyna historię wiadomości od nowa, bo serwer źródłowy przysłał
+     * ponownie HELLO (np. po resynchronizacji przekaźnika, który nie nadążał).
+     * Klienci mogli nie dostać części wiadomości, więc każdy dostanie
+     * odbudowaną historię, jak przy resynchronizacji.
+     */
+    void restartHistory() {
+        std::unique_lock lock(mutex);
+        startLobby();
+
+        std::shared_lock registry_lock(registry_mutex);
+        for (auto &[client_id, client]: clients) {
+            if (client.message_queue->isOpen()) {
+                client.message_queue->requestResync();
+            }
+        }
+    }
+
+    /**
+     * Ustawia eksport rozgrywek do archiwum. Woła się ją przed rozpoczęciem gier.
+     */
+    void setExporter(std::shared_ptr<GameExporter> game_exporter) {
+        exporter = std::move(game_exporter);
+    }
+
+    /**
+     * Ustawia funkcję wołaną, gdy w lobby zbierze się komplet graczy.
+     * Funkcja jest wołana pod blokadą serwera, więc nie może
+     * sama z niego korzystać.
+     */
+    void setPlayersReadyListener(std::function<void()> listener) {
+        std::unique_lock lock(mutex);
+        players_ready_listener = std::move(listener);
+    }
+
     /**
      * Rozgłasza do podłączonych klientów komunikat TURN.
+     * Wiadomość jest kodowana raz w każdym kodowaniu, jeszcze przed zajęciem blokady.
+     */
+    void closeTurn(uint16_t turn_id, event_list_t events) {
+        closeTurn(encodeForClients(Turn{turn_id, std::move(events)}));
+    }
+
+    /**
+     * Rozgłasza gotową wiadomość TURN, np. odebraną przez przekaźnik
+     * od serwera źródłowego. Brakujące kodowania są wyliczane przed zajęciem blokady.
      */
-    void closeTurn(uint16_t turn_id, vector<event_t> events) {
+    void closeTurn(EncodedMessage message) {
+        encodeForClients(message);
+        const auto &turn = std::get<Turn>(message.message());
+        if (exporter) {
+            exporter->exportTurn(turn.turn, message.get(Encoding::V2));
+        }
+
         std::unique_lock lock(mutex);
+        snapshot.apply(turn.turn, turn.events);
+        snapshot_message.reset();
+        has_snapshot = true;
+        broadcast(message);
+    }
+
+    /**
+     * Odbudowuje kolejkę klienta, który nie nadążał odbierać wiadomości.
+     * Zaległe wiadomości zastępuje historia i obraz gry.
+     * Woła ją wątek odbierający wiadomości z kolejki.
+     */
+    void resyncClient(client_id_t client_id, server_mess_queue_t &message_queue) {
+        std::unique_lock lock(mutex);
+        std::shared_lock registry_lock(registry_mutex);
+
+        auto it = clients.find(client_id);
+        if (it == clients.end() || it->second.message_queue.get() != &message_queue) {
+            // Klient jest właśnie przenoszony; kolejkę odbuduje jego nowy pokój.
+            return;
+        }
 
-        broadcast(server_mess_t{Turn{turn_id, std::move(events)}});
+        auto &client = it->second;
+        auto &class_stats = queue_stats.of(player_ids.contains(client_id));
+        // Zmiana protokołu korzysta z resynchronizacji, ale nie jest skutkiem przepełnienia.
+        bool protocol_switch = std::exchange(client.protocol_switch_pending, false);
+        message_queue.clear();
+        if (pushHistory(message_queue, client.encoding)) {
+            if (!protocol_switch) {
+                ++class_stats.resyncs;
+            }
+            message_queue.finishResync();
+        } else {
+            ++class_stats.disconnects;
+            message_queue.close();
+        }
     }
 
     void endGame(const map<PlayerId, Score> &scores) {
-        std::unique_lock lock(mutex);
+        endGame(encodeForClients(GameEnded{scores}));
+    }
 
+    void endGame(EncodedMessage message) {
+        encodeForClients(message);
+        if (exporter) {
+            exporter->exportGameEnded(message.get(Encoding::V2));
+        }
+
+        std::unique_lock lock(mutex);
         // Powiadamiom wszystkich klientów, że gra zakończyła się.
-        broadcast(server_mess_t{GameEnded{scores}});
+        broadcast(message);
         startLobby();
     }
 
 private:
     std::mutex mutex;
     std::condition_variable players_joined;
+    std::function<void()> players_ready_listener;
 
     map<PlayerId, Player> players{};
     map<client_id_t, PlayerId> player_ids{};
-    map<client_id_t, std::shared_ptr<server_mess_queue_t>> client_message_queues{};
-    map<client_id_t, client_mess_t> last_messages_from_clients{};
     client_id_t next_client_id = 0;
 
+    struct Client {
+        std::shared_ptr<server_mess_queue_t> message_queue;
+        InputSlot last_message;
+        Encoding encoding = Encoding::V1;
+        // Kolejka czeka na odbudowę po zmianie protokołu; chronione przez `mutex`.
+        bool protocol_switch_pending = false;
+    };
+
+    std::shared_mutex registry_mutex;
+    map<client_id_t, Client> clients{};
+    // Liczba klientów z danym kodowaniem; zmieniana pod `registry_mutex`.
+    std::array<std::atomic<size_t>, ENCODINGS> encoding_users{};
+
     bool is_lobby = true;
     const ServerParams params;
 
-    queue<std::shared_ptr<server_mess_t>> message_history{};
+    const std::shared_ptr<EncodedMessage> hello_message;
+    // HELLO, a następnie ACCEPTED_PLAYER z lobby albo GAME_STARTED.
+    // Nowy klient dostaje ją bez kopiowania, prosto z wektora.
+    vector<std::shared_ptr<EncodedMessage>> message_history{};
+    // Potwierdzenie protokołu, od którego zaczyna się historia klientów V2.
+    const std::array<encoded_mess_t, ENCODINGS> protocol_selected_messages;
+
+    // Archiwum, do którego trafiają wiadomości V2 rozgrywek; puste oznacza brak eksportu.
+    std::shared_ptr<GameExporter> exporter;
+
+    // Obraz planszy trwającej gry i jego zakodowana (leniwie) postać.
+    BoardSnapshot snapshot;
+    std::optional<EncodedMessage> snapshot_message;
+    bool has_snapshot = false;
+
+    /**
+     * Wstawia do kolejki nowego klienta historię wiadomości w jego kodowaniu.
+     * Zwraca `false`, jeśli historia nie zmieściła się w kolejce.
+     */
+    bool pushHistory(server_mess_queue_t &message_queue, Encoding encoding) {
+        if (const auto &ack = protocol_selected_messages[(size_t) encoding]) {
+            if (!message_queue.tryPush(ack, ack->size())) {
+                return false;
+            }
+        }
+        for (const auto &history_message: message_history) {
+            const auto &message = history_message->get(encoding);
+            if (!message_queue.tryPush(message, message->size())) {
+                return false;
+            }
+        }
+        if (has_snapshot) {
+            // Zamiast wszystkich dotychczasowych tur klient dostaje obraz gry.
+            if (!snapshot_message) {
+                snapshot_message.emplace(snapshot.toSnapshot());
+            }
+            const auto &message = snapshot_message->get(encoding);
+            return message_queue.tryPush(message, message->size());
+        }
+        return true;
+    }
+
+    /**
+     * Koduje wiadomość, jeszcze bez blokady, we wszystkich kodowaniach
+     * używanych przez klientów. Kodowanie klienta, który w międzyczasie
+     * zmienił protokół, zostanie dokodowane przy rozgłaszaniu.
+     */
+    template<typename M>
+    EncodedMessage encodeForClients(M &&message) const {
+        EncodedMessage encoded{std::forward<M>(message)};
+        encodeForClients(encoded);
+        return encoded;
+    }
+
+    void encodeForClients(EncodedMessage &message) const {
+        for (size_t e = 0; e < ENCODINGS; ++e) {
+            if (encoding_users[e].load(std::memory_order_relaxed) > 0) {
+                message.get((Encoding) e);
+            }
+        }
+    }
+
+    /**
+     * Klienci V1 nie dostają potwierdzenia protokołu.
+     */
+    static std::array<encoded_mess_t, ENCODINGS> encodeProtocolSelected() {
+        std::array<encoded_mess_t, ENCODINGS> messages{};
+        for (auto encoding: {Encoding::V2, Encoding::V2_DEFLATE}) {
+            messages[(size_t) encoding] = encodeServerMessage(protocolSelected(encoding));
+        }
+        return messages;
+    }
+
+    static Hello helloMessage(const ServerParams &params) {
+        return Hello{
+                .server_name = params.server_name,
+                .players_count = params.players_count,
+                .size_x = params.size_x,
+                .size_y = params.size_y,
+                .game_length = params.game_length,
+                .explosion_radius = params.explosion_radius,
+                .bomb_timer = params.bomb_timer
+        };
+    }
 
     /**
      * Wyczyszczona historia wiadomości zawiera
      * tylko komunikat HELLO.
      */
     void initializeMessageHistory() {
-        message_history = queue<std::shared_ptr<server_mess_t>>{};
-        message_history.push(std::make_shared<server_mess_t>(
-                Hello{
-                        .server_name = params.server_name,
-                        .players_count = params.players_count,
-                        .size_x = params.size_x,
-                        .size_y = params.size_y,
-                        .game_length = params.game_length,
-                        .explosion_radius = params.explosion_radius,
-                        .bomb_timer = params.bomb_timer
-                })
-        );
+        message_history.clear();
+        message_history.push_back(hello_message);
+        snapshot.reset();
+        snapshot_message.reset();
+        has_snapshot = false;
+    }
+
+    void clearLastMessages() {
+        std::shared_lock registry_lock(registry_mutex);
+
+        for (auto &[client_id, client]: clients) {
+            client.last_message.clear();
+        }
     }
 
     void startLobby() {
         is_lobby = true;
         players.clear();
         player_ids.clear();
-        last_messages_from_clients.clear();
+        clearLastMessages();
         initializeMessageHistory();
     }
 
     void startGame() {
+        startGame(std::make_shared<EncodedMessage>(GameStarted{players}));
+    }
+
+    void startGame(const std::shared_ptr<EncodedMessage> &message) {
         is_lobby = false;
-        last_messages_from_clients.clear();
+        clearLastMessages();
         initializeMessageHistory();
         // Powiadamiom wszystkich klientów, że gra się rozpoczęła.
-        broadcast(server_mess_t{GameStarted{players}});
+        message_history.push_back(message);
+        broadcast(*message);
+        if (exporter) {
+            exporter->exportGameStarted(hello_message->get(Encoding::V2), message->get(Encoding::V2));
+        }
     }
 
     /**
      * Rozsyła wiadomość do wszystkich podłączonych klientów
-     * poprzez umieszczenie wskaźnika na nią
+     * poprzez umieszczenie wskaźnika na jej postać w kodowaniu klienta
      * w kolejce każdego z nich.
+     *
+     * Klienci oczekujący na resynchronizację nie dostają
+     * nowych wiadomości, bo i tak otrzymają aktualny stan gry.
      */
-    void broadcast(const server_mess_t &message) {
-        auto message_ptr = std::make_shared<server_mess_t>(message);
-        message_history.push(message_ptr);
-        for (auto &[client_id, message_queue_ptr]: client_message_queues) {
-            if (message_queue_ptr->isOpen()) {
-                message_queue_ptr->push(message_ptr);
+    void broadcast(EncodedMessage &message) {
+        ScopedTimer timer{latency_stats.broadcast_us};
+        std::shared_lock registry_lock(registry_mutex);
+
+        for (auto &[client_id, client]: clients) {
+            auto &message_queue = *client.message_queue;
+            latency_stats.queue_depth.record(message_queue.size());
+            if (!message_queue.isOpen() || message_queue.isResyncPending()) {
+                continue;
+            }
+            const auto &message_ptr = message.get(client.encoding);
+            if (exceedsBytesLimit(message_queue, message_ptr->size())) {
+                ++queue_stats.bytes_limit_overflows;
+                handleOverflow(client_id, message_queue);
+            } else if (!message_queue.tryPush(message_ptr, message_ptr->size())) {
+                handleOverflow(client_id, message_queue);
             }
         }
     }
 
+    /**
+     * Sprawdza, czy po dołożeniu `size` bajtów kolejka przekroczy limit.
+     * Do pustej kolejki wiadomość trafia zawsze, nawet większa niż limit.
+     */
+    [[nodiscard]] bool exceedsBytesLimit(const server_mess_queue_t &message_queue, size_t size) const {
+        size_t queued = message_queue.weight();
+        return params.queue_bytes_limit > 0 && queued > 0
+               && queued + size > params.queue_bytes_limit;
+    }
+
+    /**
+     * Stosuje do klienta, którego kolejka się zapełniła, politykę
+     * jego klasy: graczy albo obserwatorów.
+     */
+    void handleOverflow(client_id_t client_id, server_mess_queue_t &message_queue) {
+        bool is_player = player_ids.contains(client_id);
+        auto &class_stats = queue_stats.of(is_player);
+        ++class_stats.overflows;
+        switch (is_player ? params.player_overflow_policy : params.spectator_overflow_policy) {
+            case OverflowPolicy::RESYNC:
+                message_queue.requestResync();
+                break;
+            case OverflowPolicy::DISCONNECT:
+                ++class_stats.disconnects;
+                message_queue.close();
+                break;
+        }
+    }
+
 };
 
 #endif //ROBOTS_SERVER_SERVER_H
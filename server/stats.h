@@ -0,0 +1,331 @@
+#ifndef ROBOTS_SERVER_STATS_H
+#define ROBOTS_SERVER_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+#include <boost/format.hpp>
+
+/**
+ * Histogram o wykładniczych kubełkach (w stylu HDR): każdy przedział
+ * [2^k, 2^(k+1)) jest podzielony na SUB_BUCKETS równych kubełków,
+ * więc błąd względny odczytu nie przekracza 1 / SUB_BUCKETS.
+ *
+ * Zapis to kilka atomowych dodawań bez blokad, więc histogramy
+ * można uzupełniać na gorących ścieżkach serwera.
+ */
+class Histogram {
+public:
+    static constexpr size_t SUB_BUCKETS = 4;
+    // Wartości 0..3 mają własne kubełki, a dalej po SUB_BUCKETS na przedziały [2^2, 2^3), ..., [2^63, 2^64).
+    static constexpr size_t BUCKETS = 63 * SUB_BUCKETS;
+
+    void record(uint64_t value) {
+        counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    /**
+     * Największa wartość, która trafia do kubełka `bucket`.
+     */
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        auto magnitude = (unsigned) (bucket / SUB_BUCKETS + 1);
+        uint64_t sub = bucket % SUB_BUCKETS;
+        // Górna granica ostatniego kubełka nie mieści się w 64 bitach.
+        if (magnitude == 63 && sub == SUB_BUCKETS - 1) {
+            return UINT64_MAX;
+        }
+        return ((SUB_BUCKETS + sub + 1) << (magnitude - 2)) - 1;
+    }
+
+    [[nodiscard]] uint64_t count(size_t bucket) const {
+        return counts[bucket].load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t getCount() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t getSum() const {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t getMax() const {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Zwraca (z dokładnością do kubełka) wartość, której
+     * nie przekracza ułamek `q` zapisanych wartości.
+     */
+    [[nodiscard]] uint64_t quantile(double q) const {
+        auto rank = (uint64_t) ((double) getCount() * q);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += count(i);
+            if (seen > rank) {
+                return std::min(upperBound(i), getMax());
+            }
+        }
+        return getMax();
+    }
+
+    void print(std::ostream &os, const std::string &name) const {
+        os << boost::format("%1%: %2% samples, p50 %3%, p99 %4%, max %5%\n")
+              % name % getCount() % quantile(0.5) % quantile(0.99) % getMax();
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max{0};
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        auto magnitude = (unsigned) std::bit_width(value) - 1;
+        auto sub = (size_t) ((value >> (magnitude - 2)) & (SUB_BUCKETS - 1));
+        return (magnitude - 1) * SUB_BUCKETS + sub;
+    }
+};
+
+/**
+ * Liczniki wydajności kodowania i wysyłki wiadomości.
+ *
+ * Pozwalają porównać czas spędzony na jednorazowym
+ * kodowaniu wiadomości z czasem jej wysyłki do wszystkich klientów.
+ */
+struct CodecStats {
+    std::atomic<uint64_t> encoded_messages{0};
+    std::atomic<uint64_t> encoded_bytes{0};
+    std::atomic<uint64_t> encode_time_ns{0};
+    // Tury wysłane w postaci skompresowanej i zaoszczędzone na tym bajty.
+    std::atomic<uint64_t> compressed_turns{0};
+    std::atomic<uint64_t> compression_saved_bytes{0};
+
+    std::atomic<uint64_t> sent_messages{0};
+    std::atomic<uint64_t> sent_bytes{0};
+    std::atomic<uint64_t> send_time_ns{0};
+    // Wysyłki z MSG_MORE, bo w kolejce klienta czekały kolejne wiadomości.
+    std::atomic<uint64_t> coalesced_sends{0};
+
+    void print(std::ostream &os) const {
+        os << boost::format("encode: %1% messages, %2% bytes, %3% us\n")
+              % encoded_messages.load() % encoded_bytes.load() % (encode_time_ns.load() / 1000);
+        os << boost::format("compression: %1% turns, %2% bytes saved\n")
+              % compressed_turns.load() % compression_saved_bytes.load();
+        os << boost::format("send: %1% messages, %2% bytes, %3% us, %4% coalesced sends\n")
+              % sent_messages.load() % sent_bytes.load() % (send_time_ns.load() / 1000)
+              % coalesced_sends.load();
+    }
+};
+
+inline CodecStats codec_stats;
+
+/**
+ * Statystyki punktualności tur.
+ *
+ * Tura jest spóźniona, jeśli jej termin minął,
+ * zanim zarządca gry skończył liczyć poprzednią turę.
+ */
+struct TurnStats {
+    std::atomic<uint64_t> turns{0};
+    std::atomic<uint64_t> overruns{0};
+    std::atomic<uint64_t> total_lateness_us{0};
+    std::atomic<uint64_t> max_lateness_us{0};
+
+    void record(uint64_t lateness_us, bool overrun) {
+        ++turns;
+        if (overrun) {
+            ++overruns;
+        }
+        total_lateness_us += lateness_us;
+        uint64_t max = max_lateness_us;
+        while (lateness_us > max && !max_lateness_us.compare_exchange_weak(max, lateness_us)) {}
+    }
+
+    void print(std::ostream &os) const {
+        uint64_t n = std::max<uint64_t>(turns, 1);
+        os << boost::format("turns: %1% scheduled, %2% overrun, lateness avg %3% us, max %4% us\n")
+              % turns.load() % overruns.load() % (total_lateness_us.load() / n)
+              % max_lateness_us.load();
+    }
+};
+
+inline TurnStats turn_stats;
+
+/**
+ * Liczniki przepełnień kolejek wiadomości do klientów,
+ * osobno dla graczy i obserwatorów.
+ */
+struct QueueStats {
+    struct ClassStats {
+        std::atomic<uint64_t> overflows{0};
+        std::atomic<uint64_t> resyncs{0};
+        std::atomic<uint64_t> disconnects{0};
+    };
+
+    ClassStats players;
+    ClassStats spectators;
+    // Przepełnienia z powodu limitu bajtów, a nie liczby wiadomości.
+    std::atomic<uint64_t> bytes_limit_overflows{0};
+
+    ClassStats &of(bool is_player) {
+        return is_player ? players : spectators;
+    }
+
+    void print(std::ostream &os) const {
+        os << boost::format("queues: players %1% overflows, %2% resyncs, %3% disconnects; "
+                            "spectators %4% overflows, %5% resyncs, %6% disconnects; "
+                            "%7% over bytes limit\n")
+              % players.overflows.load() % players.resyncs.load() % players.disconnects.load()
+              % spectators.overflows.load() % spectators.resyncs.load() % spectators.disconnects.load()
+              % bytes_limit_overflows.load();
+    }
+};
+
+inline QueueStats queue_stats;
+
+/**
+ * Rozkłady czasów (w mikrosekundach) na gorących ścieżkach serwera
+ * oraz długości kolejek wiadomości do klientów.
+ */
+struct LatencyStats {
+    // Liczenie tury przez zarządcę gry, bez rozgłaszania.
+    Histogram turn_compute_us;
+    // Oczekiwanie zarządcy gry na blokadę serwera przy zbieraniu ruchów.
+    Histogram collect_lock_wait_us;
+    // Umieszczenie wiadomości w kolejkach wszystkich klientów.
+    Histogram broadcast_us;
+    Histogram encode_us;
+    // Wysłanie porcji wiadomości do jednego klienta.
+    Histogram send_us;
+    // Długość kolejki klienta w chwili rozgłaszania wiadomości.
+    Histogram queue_depth;
+    // Od przyjęcia połączenia do wysłania klientowi pierwszej porcji wiadomości, z HELLO.
+    Histogram hello_us;
+
+    void print(std::ostream &os) const {
+        turn_compute_us.print(os, "turn compute us");
+        collect_lock_wait_us.print(os, "collect lock wait us");
+        broadcast_us.print(os, "broadcast us");
+        encode_us.print(os, "encode us");
+        send_us.print(os, "send us");
+        queue_depth.print(os, "queue depth");
+        hello_us.print(os, "connection to hello us");
+    }
+};
+
+inline LatencyStats latency_stats;
+
+/**
+ * Liczniki połączeń klientów.
+ */
+struct ConnectionStats {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> dropped{0};
+    // Połączenia obsłużone gotowym obiektem z puli.
+    std::atomic<uint64_t> pooled{0};
+
+    void print(std::ostream &os) const {
+        os << boost::format("connections: %1% accepted, %2% dropped, %3% from pool\n")
+              % accepted.load() % dropped.load() % pooled.load();
+    }
+};
+
+inline ConnectionStats connection_stats;
+
+/**
+ * Liczniki ruchów odebranych od klientów.
+ */
+struct InputStats {
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> rate_limited{0};
+    // Ruchy przekazane serwerowi, po jednym na porcję danych.
+    std::atomic<uint64_t> published{0};
+
+    void print(std::ostream &os) const {
+        os << boost::format("inputs: %1% received, %2% rate limited, %3% published\n")
+              % received.load() % rate_limited.load() % published.load();
+    }
+};
+
+inline InputStats input_stats;
+
+/**
+ * Liczniki eksportu rozgrywek do archiwum.
+ */
+struct ExportStats {
+    std::atomic<uint64_t> exported_messages{0};
+    std::atomic<uint64_t> exported_bytes{0};
+    // Wiadomości pominięte przy pełnej kolejce eksportu albo po błędzie zapisu.
+    std::atomic<uint64_t> dropped_messages{0};
+    std::atomic<uint64_t> segments{0};
+
+    void print(std::ostream &os) const {
+        os << boost::format("export: %1% messages, %2% bytes, %3% segments, %4% dropped\n")
+              % exported_messages.load() % exported_bytes.load() % segments.load()
+              % dropped_messages.load();
+    }
+};
+
+inline ExportStats export_stats;
+
+/**
+ * Zapisuje czas od przyjęcia połączenia do wysłania HELLO.
+ */
+inline void recordHelloLatency(std::chrono::steady_clock::time_point accepted_at) {
+    auto elapsed = std::chrono::steady_clock::now() - accepted_at;
+    latency_stats.hello_us.record(
+            (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+/**
+ * Mierzy czas życia obiektu i dolicza go (w nanosekundach)
+ * do wskazanego licznika lub zapisuje (w mikrosekundach) w histogramie.
+ */
+class ScopedTimer {
+    using clock = std::chrono::steady_clock;
+public:
+    explicit ScopedTimer(std::atomic<uint64_t> &counter)
+            : counter(&counter), start(clock::now()) {}
+
+    explicit ScopedTimer(Histogram &histogram)
+            : histogram(&histogram), start(clock::now()) {}
+
+    ScopedTimer(std::atomic<uint64_t> &counter, Histogram &histogram)
+            : counter(&counter), histogram(&histogram), start(clock::now()) {}
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+        if (counter) {
+            *counter += (uint64_t) elapsed.count();
+        }
+        if (histogram) {
+            histogram->record((uint64_t) elapsed.count() / 1000);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    std::atomic<uint64_t> *counter = nullptr;
+    Histogram *histogram = nullptr;
+    clock::time_point start;
+};
+
+#endif //ROBOTS_SERVER_STATS_H
@@ -1,6 +1,8 @@
 #ifndef ROBOTS_SERVER_TCPCONNECTION_H
 #define ROBOTS_SERVER_TCPCONNECTION_H
 
+#include <cstring>
+#include <span>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -9,24 +11,14 @@
 #include <boost/array.hpp>
 #include <boost/format.hpp>
 
+#include "output-buffer.h"
+
 using std::vector;
 using std::map;
 using std::string;
 
 const size_t BUFFER_SIZE = 10000;
 
-class TcpConnection;
-
-template<typename T>
-concept Readable = requires(T, TcpConnection &c) {
-    { T::read(c) } -> std::convertible_to<T>;
-};
-
-template<typename T>
-concept Writable = requires(T t, TcpConnection &s) {
-    t.write(s);
-};
-
 namespace asio = boost::asio;
 
 /**
@@ -37,8 +29,30 @@ class TcpConnection {
     using resolver = tcp::resolver;
     using socket_t = tcp::socket;
 public:
-    explicit TcpConnection(socket_t socket)
-            : socket(std::move(socket)) {}
+    /**
+     * Bufor odbiorczy ma `buffer_size` bajtów; tyle może mieć najdłuższa
+     * odbierana wiadomość.
+     */
+    explicit TcpConnection(socket_t socket, size_t buffer_size = BUFFER_SIZE)
+            : socket(std::move(socket)), input_buffer(buffer_size) {}
+
+    /**
+     * Przejmuje nowe gniazdo, np. gdy połączenie jest brane z puli.
+     * Bufor odbiorczy zostaje ten sam, tylko bez starych danych.
+     */
+    void reset(socket_t new_socket) {
+        socket = std::move(new_socket);
+        input_beg = 0;
+        input_end = 0;
+    }
+
+    /**
+     * Zamyka gniazdo, np. przed oddaniem połączenia do puli.
+     */
+    void release() {
+        boost::system::error_code ignored;
+        socket.close(ignored);
+    }
 
     // --- Czytanie przysyłanych danych ---
 
@@ -50,139 +64,112 @@ public:
     }
 
     uint16_t readU16() {
-        uint16_t res;
-        ((uint8_t *) &res)[0] = readU8();
-        ((uint8_t *) &res)[1] = readU8();
-        return be16toh(res);
+        return be16toh(readFixed<uint16_t>());
     }
 
     uint32_t readU32() {
-        uint32_t res;
-        ((uint8_t *) &res)[0] = readU8();
-        ((uint8_t *) &res)[1] = readU8();
-        ((uint8_t *) &res)[2] = readU8();
-        ((uint8_t *) &res)[3] = readU8();
-        return be32toh(res);
+        return be32toh(readFixed<uint32_t>());
     }
 
-    string readString() {
-        uint8_t len = readU8();
-        string res;
-        for (uint8_t i = 0; i < len; ++i) {
-            res += (char) readU8();
-        }
-        return res;
-    }
-
-    template<Readable T>
-    vector<T> readList() {
-        uint32_t len = readU32();
-        vector<T> res;
-        for (uint32_t i = 0; i < len; ++i) {
-            res.push_back(T::read(*this));
+    /**
+     * Wypełnia `dst` kolejnymi odebranymi bajtami.
+     * Dane są kopiowane z bufora całymi porcjami.
+     */
+    void readBytes(std::span<uint8_t> dst) {
+        while (!dst.empty()) {
+            if (input_beg == input_end) {
+                receive();
+            }
+            size_t len = std::min(dst.size(), input_end - input_beg);
+            memcpy(dst.data(), input_buffer.data() + input_beg, len);
+            input_beg += len;
+            dst = dst.subspan(len);
         }
-        return res;
     }
 
-    template<Readable K, Readable V>
-    map<K, V> readMap() {
-        uint32_t len = readU32();
-        map<K, V> res;
-        for (uint32_t i = 0; i < len; ++i) {
-            K key = K::read(*this);
-            V value = V::read(*this);
-            res[key] = value;
-        }
-        return res;
+    /**
+     * Odebrane, jeszcze nieprzeczytane bajty.
+     */
+    [[nodiscard]] std::span<const uint8_t> buffered() const {
+        return {input_buffer.data() + input_beg, input_end - input_beg};
     }
 
-    // --- Zapis danych do bufora `output_buffer` ---
-
     /**
-     * Zapisuje do bufora wyjściowego jeden bajt danych.
-     * Jeśli w buforze brakuje miejsca, to jego zawartość zostaje
-     * wysłana i dopiero wtedy są zapisywane nowe dane.
+     * Pomija `len` bajtów z `buffered()`.
      */
-    void write(uint8_t val) {
-        if (output_size == output_buffer.size()) {
-            send();
-            output_size = 0;
-        }
-
-        memcpy(output_buffer.data() + output_size, (uint8_t *) &val, sizeof(val));
-        ++output_size;
+    void consume(size_t len) {
+        input_beg += len;
     }
 
-    void write(uint16_t val) {
-        val = htobe16(val);
-        for (size_t i = 0; i < sizeof(val); ++i) {
-            write(((uint8_t *) &val)[i]);
+    /**
+     * Odbiera kolejną porcję danych i dopisuje ją do nieprzeczytanych bajtów
+     * (np. początku niepełnej wiadomości). Operacja blokująca.
+     */
+    void receiveMore() {
+        memmove(input_buffer.data(), input_buffer.data() + input_beg, input_end - input_beg);
+        input_end -= input_beg;
+        input_beg = 0;
+        if (input_end == input_buffer.size()) {
+            throw std::runtime_error("Message does not fit in the input buffer");
         }
+        input_end += readSome(asio::buffer(input_buffer.data() + input_end, input_buffer.size() - input_end));
     }
 
-    void write(uint32_t val) {
-        val = htobe32(val);
-        for (size_t i = 0; i < sizeof(val); ++i) {
-            write(((uint8_t *) &val)[i]);
-        }
+    string readString() {
+        uint8_t len = readU8();
+        string res(len, '\0');
+        readBytes({(uint8_t *) res.data(), res.size()});
+        return res;
     }
 
-    void write(uint64_t val) {
-        val = htobe64(val);
-        for (size_t i = 0; i < sizeof(val); ++i) {
-            write(((uint8_t *) &val)[i]);
-        }
-    }
+    // --- Wysyłanie danych ---
 
-    void write(const string &s) {
-        write((uint8_t) s.length());
-        for (char c: s) {
-            write((uint8_t) c);
-        }
-    }
-
-    template<Writable T>
-    void writeList(const std::vector<T> &v) {
-        write((uint32_t) v.size());
-        for (const T &t: v) {
-            t.write(*this);
+    /**
+     * Wysyła zakodowaną wcześniej wiadomość.
+     * Bajty wiadomości są przekazywane do gniazda bez kopiowania.
+     */
+    void send(const OutputBuffer &message) {
+        if (message.size() == 0) {
+            return;
         }
+        send(asio::buffer(message.data(), message.size()));
     }
 
-    template<Writable K, Writable V>
-    void writeMap(const std::map<K, V> m) {
-        write((uint32_t) m.size());
-        for (const auto &[k, v]: m) {
-            k.write(*this);
-            v.write(*this);
-        }
+    /**
+     * Wysyła ciąg buforów (np. kilku wiadomości naraz)
+     * jednym wywołaniem systemowym, o ile gniazdo przyjmie wszystkie bajty.
+     */
+    template<typename ConstBufferSequence>
+    void send(const ConstBufferSequence &buffers) {
+        boost::system::error_code error;
+        asio::write(socket, buffers, asio::transfer_all(), error);
+        checkSendError(error);
     }
 
     /**
-     * Wysyła `output_size` bajtów
-     * danych zapisanych w buforze `output_buffer`.
+     * Wysyła ciąg buforów z flagą MSG_MORE: jądro nie wysyła niepełnego
+     * segmentu, tylko dokleja do niego dane z następnego wywołania `send`.
+     * Kolejne wywołanie musi nastąpić od razu, bo wstrzymany segment
+     * wychodzi sam dopiero po ok. 200 ms.
      */
-    void send() {
-        if (output_size == 0) {
-            return;
-        }
-
+    void sendMore(const vector<asio::const_buffer> &buffers) {
         boost::system::error_code error;
-        asio::write(socket, asio::buffer(output_buffer, output_size),
-                    asio::transfer_all(), error);
-
-        if (error == boost::asio::error::eof) {
-            throw std::runtime_error("Server connection closed");
-        } else if (error) {
-            throw std::runtime_error{
-                    "Failed to send message to server. Error: " +
-                    std::to_string(error.value())};
+        size_t sent = socket.send(buffers, MSG_MORE, error);
+        checkSendError(error);
+
+        // Gniazdo przyjęło tylko część bajtów: resztę wysyła zwykłe `send`.
+        vector<asio::const_buffer> rest;
+        for (const auto &buffer: buffers) {
+            if (sent >= buffer.size()) {
+                sent -= buffer.size();
+            } else {
+                rest.push_back(buffer + sent);
+                sent = 0;
+            }
+        }
+        if (!rest.empty()) {
+            send(rest);
         }
-        output_size = 0;
-    }
-
-    void clearOutput() {
-        output_size = 0;
     }
 
     void close() {
@@ -203,11 +190,25 @@ public:
 
 private:
     socket_t socket;
-    std::array<uint8_t, BUFFER_SIZE> input_buffer{};
-    std::array<uint8_t, BUFFER_SIZE> output_buffer{};
+    vector<uint8_t> input_buffer;
     size_t input_beg = 0;
     size_t input_end = 0;
-    size_t output_size = 0;
+
+    /**
+     * Czyta liczbę o stałej szerokości (w kolejności bajtów sieci).
+     * Jeśli cała liczba jest już w buforze, to wystarcza jedno kopiowanie.
+     */
+    template<typename T>
+    T readFixed() {
+        T res;
+        if (input_end - input_beg >= sizeof(T)) {
+            memcpy(&res, input_buffer.data() + input_beg, sizeof(T));
+            input_beg += sizeof(T);
+        } else {
+            readBytes({(uint8_t *) &res, sizeof(T)});
+        }
+        return res;
+    }
 
     /**
      * Odbiera porcję danych i przechowuje ją w buforze `input_buffer`
@@ -215,8 +216,23 @@ private:
      */
     void receive() {
         assert(input_beg == input_end);
+        input_end = readSome(asio::buffer(input_buffer));
+        input_beg = 0;
+    }
+
+    static void checkSendError(const boost::system::error_code &error) {
+        if (error == boost::asio::error::eof) {
+            throw std::runtime_error("Server connection closed");
+        } else if (error) {
+            throw std::runtime_error{
+                    "Failed to send message to server. Error: " +
+                    std::to_string(error.value())};
+        }
+    }
+
+    size_t readSome(asio::mutable_buffer buffer) {
         boost::system::error_code error;
-        size_t len = socket.read_some(asio::buffer(input_buffer), error);
+        size_t len = socket.read_some(buffer, error);
 
         if (error == boost::asio::error::eof) {
             throw std::runtime_error("Server connection closed");
@@ -225,9 +241,7 @@ private:
                     "Failed to receive message from server. Error: " +
                     std::to_string(error.value())};
         }
-
-        input_beg = 0;
-        input_end = len;
+        return len;
     }
 };
 
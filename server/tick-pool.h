@@ -0,0 +1,131 @@
+#ifndef ROBOTS_SERVER_TICK_POOL_H
+#define ROBOTS_SERVER_TICK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Wątki pomocnicze zarządcy gry do równoległego liczenia części tury.
+ *
+ * `forEach` rozdziela indeksy zadań między wątek wołający i wątki puli:
+ * każdy wątek pobiera kolejny wolny indeks ze wspólnego licznika, więc
+ * wątek, który skończył swoje zadania, przejmuje pozostałe. Wynik zadania
+ * zapisywany pod jego indeksem nie zależy więc od tego, który wątek je wykonał.
+ *
+ * Pula może być wspólna dla zarządców gier wielu pokoi. Naraz korzysta
+ * z niej jeden zarządca; pozostali w tym czasie liczą swoje zadania sami,
+ * zamiast czekać. Pula nie ma więc aren tury: zarządca przydziela
+ * każdemu wątkowi własną (zob. `threads()`), bo arena nie jest synchronizowana.
+ */
+class TickPool {
+public:
+    /**
+     * Pula z `threads` - 1 wątkami pomocniczymi; wątkiem
+     * o numerze 0 jest zawsze wątek wołający `forEach`.
+     */
+    explicit TickPool(size_t threads) : thread_count(std::max<size_t>(threads, 1)) {
+        for (size_t worker = 1; worker < thread_count; ++worker) {
+            workers.emplace_back([this, worker](const std::stop_token &stop) { work(stop, worker); });
+        }
+    }
+
+    TickPool(const TickPool &) = delete;
+    TickPool &operator=(const TickPool &) = delete;
+
+    /**
+     * Liczba wątków razem z wołającym; numery wątków w `forEach` są mniejsze.
+     */
+    [[nodiscard]] size_t threads() const {
+        return thread_count;
+    }
+
+    /**
+     * Wykonuje `task(i, worker)` dla każdego i z [0, count) i czeka na
+     * zakończenie wszystkich zadań. Mniej niż `min_parallel` zadań,
+     * tak jak zadania wołającego w czasie, gdy pulą zajmuje się inny
+     * wątek, wykonuje sam wątek wołający. Zadania nie mogą rzucać wyjątków.
+     */
+    template<typename Task>
+    void forEach(size_t count, size_t min_parallel, Task &&task) {
+        std::unique_lock in_use(use_mutex, std::defer_lock);
+        if (workers.empty() || count < std::max<size_t>(min_parallel, 2) || !in_use.try_lock()) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i, (size_t) 0);
+            }
+            return;
+        }
+
+        {
+            std::scoped_lock lock(mutex);
+            context = &task;
+            invoke = [](void *context, size_t i, size_t worker) {
+                (*static_cast<std::remove_reference_t<Task> *>(context))(i, worker);
+            };
+            task_count = count;
+            next_task.store(0, std::memory_order_relaxed);
+            busy_workers = workers.size();
+            ++generation;
+        }
+        work_ready.notify_all();
+
+        runTasks(0);
+        std::unique_lock lock(mutex);
+        work_done.wait(lock, [&] { return busy_workers == 0; });
+    }
+
+private:
+    const size_t thread_count;
+
+    // Zajęty przez wątek, którego zadania wykonuje właśnie pula.
+    std::mutex use_mutex;
+    std::mutex mutex;
+    std::condition_variable_any work_ready;
+    std::condition_variable work_done;
+    // Numer kolejnego wywołania `forEach`; budzi wątki puli.
+    uint64_t generation = 0;
+    size_t busy_workers = 0;
+
+    void *context = nullptr;
+    void (*invoke)(void *, size_t, size_t) = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next_task{0};
+
+    // Ostatnie pole, więc wątki kończą się przed zniszczeniem pozostałych.
+    std::vector<std::jthread> workers;
+
+    void runTasks(size_t worker) {
+        for (size_t i = next_task.fetch_add(1, std::memory_order_relaxed); i < task_count;
+             i = next_task.fetch_add(1, std::memory_order_relaxed)) {
+            invoke(context, i, worker);
+        }
+    }
+
+    void work(const std::stop_token &stop, size_t worker) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock lock(mutex);
+                if (!work_ready.wait(lock, stop, [&] { return generation != seen; })) {
+                    return;
+                }
+                seen = generation;
+            }
+            runTasks(worker);
+            {
+                std::scoped_lock lock(mutex);
+                if (--busy_workers == 0) {
+                    work_done.notify_one();
+                }
+            }
+        }
+    }
+};
+
+#endif //ROBOTS_SERVER_TICK_POOL_H
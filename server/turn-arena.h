@@ -0,0 +1,77 @@
+#ifndef ROBOTS_SERVER_TURN_ARENA_H
+#define ROBOTS_SERVER_TURN_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+/* Początkowy rozmiar (w bajtach) areny jednej tury. */
+const size_t DEFAULT_TURN_ARENA_SIZE = 64 * 1024;
+
+/**
+ * Arena na dane tymczasowe jednej tury: listę zdarzeń,
+ * wiadomości od klientów i struktury pomocnicze wybuchów.
+ *
+ * Przydział pamięci z areny to przesunięcie wskaźnika, a zwolnienie
+ * jest pomijane. Cała pamięć jest odzyskiwana naraz w `reset()`.
+ * Jeśli w turze zabrakło miejsca w buforze areny, to kolejna tura
+ * dostaje bufor mieszczący całe zużycie tamtej, więc w stanie
+ * ustalonym tura nie przydziela pamięci ze sterty.
+ */
+class TurnArena {
+public:
+    explicit TurnArena(size_t initial_size = DEFAULT_TURN_ARENA_SIZE)
+            : buffer(initial_size) {
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+
+    TurnArena(const TurnArena &) = delete;
+    TurnArena &operator=(const TurnArena &) = delete;
+
+    [[nodiscard]] std::pmr::memory_resource *resource() {
+        return &*arena;
+    }
+
+    /**
+     * Odzyskuje całą pamięć przydzieloną od ostatniego `reset()`.
+     * Wszystkie obiekty korzystające z areny muszą już nie istnieć.
+     */
+    void reset() {
+        size_t overflowed = overflow.allocated;
+        arena.reset();
+        if (overflowed > 0) {
+            buffer = std::vector<std::byte>(buffer.size() + overflowed);
+        }
+        overflow.allocated = 0;
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+
+private:
+    /**
+     * Przydziela pamięć ze sterty, gdy zabraknie miejsca w buforze areny,
+     * i zlicza, ile jej przydzielono.
+     */
+    struct OverflowResource : std::pmr::memory_resource {
+        size_t allocated = 0;
+
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            allocated += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        [[nodiscard]] bool do_is_equal(const memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer;
+    OverflowResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
+
+#endif //ROBOTS_SERVER_TURN_ARENA_H
@@ -0,0 +1,88 @@
+#ifndef ROBOTS_SERVER_TURN_SCHEDULER_H
+#define ROBOTS_SERVER_TURN_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "stats.h"
+
+/* Zachowanie zegara, gdy obliczenie tury nie zmieściło się w jej czasie. */
+enum class OverrunPolicy {
+    // Spóźnione tury są rozgrywane od razu, aż zegar nadrobi opóźnienie.
+    CATCH_UP,
+    // Pominięte terminy przepadają, a kolejna tura czeka na najbliższy termin.
+    SKIP
+};
+
+/**
+ * Wyznacza momenty rozpoczęcia kolejnych tur.
+ *
+ * Terminy są liczone względem bezwzględnego czasu rozpoczęcia gry
+ * (`start + n * turn_duration`) na zegarze monotonicznym,
+ * więc czas liczenia tur ani opóźnienia wybudzeń nie kumulują się
+ * w trakcie rozgrywki.
+ */
+class TurnScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    TurnScheduler(uint64_t turn_duration_ms, OverrunPolicy policy)
+            : turn_duration(toDuration(turn_duration_ms)), policy(policy) {}
+
+    /**
+     * Ustawia początek odliczania na bieżącą chwilę.
+     */
+    void start() {
+        deadline = clock::now();
+    }
+
+    /**
+     * Wyznacza termin rozpoczęcia kolejnej tury zgodnie z `policy`.
+     * Termin spóźnionej tury w trybie CATCH_UP jest już w przeszłości.
+     */
+    clock::time_point nextDeadline() {
+        deadline += turn_duration;
+
+        auto now = clock::now();
+        overrun = now > deadline;
+        if (overrun && policy == OverrunPolicy::SKIP) {
+            // Przesuń termin na najbliższą wielokrotność długości tury.
+            auto missed = (now - deadline) / turn_duration + 1;
+            deadline += missed * turn_duration;
+        }
+        return deadline;
+    }
+
+    /**
+     * Zapisuje, o ile rozpoczynana właśnie tura się spóźniła.
+     */
+    void markTurnStarted() {
+        auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(
+                clock::now() - deadline);
+        turn_stats.record((uint64_t) std::max<long>(lateness.count(), 0), overrun);
+    }
+
+    /**
+     * Usypia wołający wątek do terminu kolejnej tury.
+     */
+    void waitForNextTurn() {
+        std::this_thread::sleep_until(nextDeadline());
+        markTurnStarted();
+    }
+
+private:
+    const clock::duration turn_duration;
+    const OverrunPolicy policy;
+    clock::time_point deadline{};
+    bool overrun = false;
+
+    static clock::duration toDuration(uint64_t turn_duration_ms) {
+        // Absurdalnie długie tury obcinamy, żeby zegar się nie przepełnił.
+        auto max_ms = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+                clock::duration::max()).count() / 4;
+        return std::chrono::milliseconds(std::min(turn_duration_ms, max_ms));
+    }
+};
+
+#endif //ROBOTS_SERVER_TURN_SCHEDULER_H
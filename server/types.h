@@ -2,6 +2,7 @@
 #define ROBOTS_SERVER_TYPES_H
 
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <map>
@@ -13,6 +14,7 @@
 
 #include <boost/asio.hpp>
 
+#include "../common/protocol.h"
 #include "tcp-connection.h"
 
 const int DIRECTIONS = 4;
@@ -49,14 +51,8 @@ struct Position {
     uint16_t x;
     uint16_t y;
 
-    static Position read(TcpConnection &c) {
-        return {c.readU16(), c.readU16()};
-    }
-
-    void write(TcpConnection &s) const {
-        s.write(x);
-        s.write(y);
-    }
+    using wire_layout = layout::Position;
+    static constexpr auto wire_fields = std::tuple{&Position::x, &Position::y};
 
     auto operator<=>(const Position &other) const {
         return std::tie(x, y) <=> std::tie(other.x, other.y);
@@ -66,6 +62,7 @@ struct Position {
 /**
  * Definicje struktur występujących w komunikatach
  * przesyłanych między serwerem i klientem.
+ * Ich układ na łączu opisuje protocol.h.
  */
 
 using client_id_t = size_t;
@@ -73,13 +70,8 @@ using client_id_t = size_t;
 struct PlayerId {
     uint8_t value;
 
-    static PlayerId read(TcpConnection &c) {
-        return {c.readU8()};
-    }
-
-    void write(TcpConnection &s) const {
-        s.write(value);
-    }
+    using wire_layout = layout::PlayerId;
+    static constexpr auto wire_fields = std::tuple{&PlayerId::value};
 
     auto operator<=>(const PlayerId &other) const {
         return value <=> other.value;
@@ -90,25 +82,15 @@ struct PlayerId {
 struct Score {
     uint32_t value;
 
-    static Score read(TcpConnection &c) {
-        return {c.readU32()};
-    }
-
-    void write(TcpConnection &s) const {
-        s.write(value);
-    }
+    using wire_layout = layout::Score;
+    static constexpr auto wire_fields = std::tuple{&Score::value};
 };
 
 struct BombId {
     uint32_t value;
 
-    static BombId read(TcpConnection &c) {
-        return {c.readU32()};
-    }
-
-    void write(TcpConnection &s) const {
-        s.write(value);
-    }
+    using wire_layout = layout::BombId;
+    static constexpr auto wire_fields = std::tuple{&BombId::value};
 
     auto operator<=>(const BombId &other) const {
         return value <=> other.value;
@@ -119,24 +101,13 @@ struct Player {
     string name;
     string address;
 
-    static Player read(TcpConnection &c) {
-        return {c.readString(), c.readString()};
-    }
-
-    void write(TcpConnection &s) const {
-        s.write(name);
-        s.write(address);
-    }
+    using wire_layout = layout::Player;
+    static constexpr auto wire_fields = std::tuple{&Player::name, &Player::address};
 };
 
 struct Bomb {
     Position position;
     uint16_t timer;
-
-    void write(TcpConnection &s) const {
-        position.write(s);
-        s.write(timer);
-    }
 };
 
 #endif //ROBOTS_SERVER_TYPES_H